@@ -48,7 +48,7 @@ void DeviceInit(void)
    //------------------------------------------------
    SysCtrlRegs.PCLKCR0.bit.SPIAENCLK = 1;	// SPI-A
    //------------------------------------------------
-   SysCtrlRegs.PCLKCR0.bit.SCIAENCLK = 0;  	// SCI-A
+   SysCtrlRegs.PCLKCR0.bit.SCIAENCLK = 1;  	// SCI-A
    //------------------------------------------------
    SysCtrlRegs.PCLKCR1.bit.ECAP1ENCLK = 0;	//eCAP1
    //------------------------------------------------
@@ -162,15 +162,15 @@ void DeviceInit(void)
 //--------------------------------------------------------------------------------------
 //  GPIO-20 - GPIO-27 Do Not Exist
 //--------------------------------------------------------------------------------------
-//  GPIO-28 - PIN FUNCTION = --Spare--
-	GpioCtrlRegs.GPAMUX2.bit.GPIO28 = 0;	// 0=GPIO,  1=SCIRX-A,  2=I2C-SDA,  3=TZ2
-	GpioCtrlRegs.GPADIR.bit.GPIO28 = 0;		// 1=OUTput,  0=INput
+//  GPIO-28 - PIN FUNCTION = SCIRX-A, G-code stream in
+	GpioCtrlRegs.GPAMUX2.bit.GPIO28 = 1;	// 0=GPIO,  1=SCIRX-A,  2=I2C-SDA,  3=TZ2
+	GpioCtrlRegs.GPAPUD.bit.GPIO28 = 0;		// pull up so the line idles high
+	GpioCtrlRegs.GPAQSEL2.bit.GPIO28 = 3;	// asynchronous input for the SCI
 //	GpioDataRegs.GPACLEAR.bit.GPIO28 = 1;	// uncomment if --> Set Low initially
 //	GpioDataRegs.GPASET.bit.GPIO28 = 1;		// uncomment if --> Set High initially
 //--------------------------------------------------------------------------------------
-//  GPIO-29 - PIN FUNCTION = --Spare--
-	GpioCtrlRegs.GPAMUX2.bit.GPIO29 = 0;	// 0=GPIO,  1=SCITXD-A,  2=I2C-SCL,  3=TZ3
-	GpioCtrlRegs.GPADIR.bit.GPIO29 = 0;		// 1=OUTput,  0=INput
+//  GPIO-29 - PIN FUNCTION = SCITX-A, flow control out
+	GpioCtrlRegs.GPAMUX2.bit.GPIO29 = 1;	// 0=GPIO,  1=SCITXD-A,  2=I2C-SCL,  3=TZ3
 //	GpioDataRegs.GPACLEAR.bit.GPIO29 = 1;	// uncomment if --> Set Low initially
 //	GpioDataRegs.GPASET.bit.GPIO29 = 1;		// uncomment if --> Set High initially
 //--------------------------------------------------------------------------------------
@@ -244,6 +244,14 @@ void DeviceInit(void)
 
     SpiaRegs.SPICCR.bit.SPISWRESET = 1;
 
+    // SCI-A for the G-code stream, 38400 8N1 with a receive interrupt
+    SciaRegs.SCICCR.all = 0x0007;           // 1 stop bit, no parity, 8 bits
+    SciaRegs.SCICTL1.all = 0x0003;          // enable TX and RX, held in reset
+    SciaRegs.SCICTL2.bit.RXBKINTENA = 1;
+    SciaRegs.SCIHBAUD = 0;
+    SciaRegs.SCILBAUD = 48;                 // LSPCLK / ((48 + 1) * 8) = 38265 baud
+    SciaRegs.SCICTL1.bit.SWRESET = 1;
+
     PieCtrlRegs.PIEIER1.bit.INTx4 = 1;
     PieCtrlRegs.PIECTRL.bit.ENPIE = 1;
 
@@ -101,6 +101,12 @@ SECTIONS
                           LOAD_END(_RamfuncsLoadEnd),
                           RUN_START(_RamfuncsRunStart)
 
+    /* the two control law builds of __P2AMC_MODE_BENCH, sizes for bench.c */
+    ctrlShift           : > FLASH       PAGE = 0,
+                          SIZE(_CtrlShiftSize)
+    ctrlIQ              : > FLASH       PAGE = 0,
+                          SIZE(_CtrlIQSize)
+
     csmpasswds          : > CSM_PWL     PAGE = 0
     csm_rsvd            : > CSM_RSVD    PAGE = 0
 
@@ -0,0 +1,92 @@
+/*
+ *  autotune.c
+ *
+ *  Relay feedback auto-tuner, see autotune.h.
+ */
+
+#include "autotune.h"
+#include "control.h"
+#include "trajectory.h"
+
+#define FOUR_OVER_PI 83443L    // Q16
+
+// kp as a fraction of Ku in Q16, and Td as a divisor of Tu, per rule
+static const int32_t ruleKp[TUNE_RULES] = { 52429L, 21627L, 13107L };
+static const uint16_t ruleTd[TUNE_RULES] = { 8, 3, 3 };
+
+// centre in Q16 degrees, normally where the axis is standing
+void Tune_start(AutoTune *t, int32_t centre, uint16_t rule)
+{
+    t->centre = centre;
+    t->hi = centre;
+    t->lo = centre;
+    t->ampSum = 0;
+    t->periodSum = 0;
+    t->ticks = 0;
+    t->rise = 0;
+    t->cycles = 0;
+    t->out = 1;
+    t->rule = rule < TUNE_RULES ? rule : TUNE_ZN_PD;
+    t->state = TUNE_RUNNING;
+}
+
+static void finish(AutoTune *t)
+{
+    int32_t amp = t->ampSum / (2 * TUNE_CYCLES);
+
+    if (amp <= 0) {
+        t->state = TUNE_FAILED;
+        return;
+    }
+    t->ku = (int32_t)(((int64_t)TUNE_RELAY * FOUR_OVER_PI << 16) / amp);
+    t->tu = (int32_t)(((int32_t)t->periodSum << 16) / (CONTROL_RATE_HZ * TUNE_CYCLES));
+    t->kp = (int32_t)(((int64_t)t->ku * ruleKp[t->rule]) >> 16);
+    t->kd = (int32_t)(((int64_t)t->kp * t->tu) >> 16) / ruleTd[t->rule];
+    t->state = TUNE_DONE;
+}
+
+/*
+ * Relay output in DAC counts for the axis at pos, Q16 degrees. Call every
+ * control tick while Tune_running, the results are ready once the state
+ * moves on to TUNE_DONE.
+ */
+int32_t Tune_step(AutoTune *t, int32_t pos)
+{
+    int32_t err = t->centre - pos;
+
+    if (t->state != TUNE_RUNNING)
+        return DAC_MID;
+
+    t->ticks += 1;
+    if (pos > t->hi)
+        t->hi = pos;
+    if (pos < t->lo)
+        t->lo = pos;
+    if (t->hi - t->centre > TUNE_MAX_AMP || t->centre - t->lo > TUNE_MAX_AMP
+            || t->ticks > TUNE_TIMEOUT) {
+        t->state = TUNE_FAILED;
+        return DAC_MID;
+    }
+
+    if (t->out < 0 && err > TUNE_HYST) {
+        // a period is from one upward switch to the next
+        t->out = 1;
+        if (t->rise) {
+            t->cycles += 1;
+            if (t->cycles > TUNE_SETTLE) {
+                t->ampSum += t->hi - t->lo;
+                t->periodSum += t->ticks - t->rise;
+            }
+        }
+        t->rise = t->ticks;
+        t->hi = pos;
+        t->lo = pos;
+        if (t->cycles == TUNE_SETTLE + TUNE_CYCLES) {
+            finish(t);
+            return DAC_MID;
+        }
+    } else if (t->out > 0 && err < -TUNE_HYST) {
+        t->out = -1;
+    }
+    return DAC_MID + t->out * TUNE_RELAY;
+}
@@ -0,0 +1,85 @@
+/*
+ *  autotune.h
+ *
+ *  Relay feedback auto-tuner for the Piccollo2AMC project.
+ *
+ *  In place of the control law the axis is driven with a relay, +relay
+ *  DAC counts while it is short of the centre and -relay past it, with a
+ *  little hysteresis against encoder chatter. The motor lag and the tick
+ *  of delay turn that into a steady oscillation about the centre at the
+ *  loop's ultimate period Tu, and the describing function of the relay
+ *  gives the ultimate gain from its amplitude a:
+ *
+ *      Ku = 4 * relay / (pi * a)       DAC counts per degree
+ *
+ *  Once TUNE_CYCLES periods have been averaged, after TUNE_SETTLE to let
+ *  the start up transient die, the chosen rule turns Ku and Tu into a
+ *  proportional gain and a derivative time, kd = kp * Td. The control law
+ *  has no integrator, so only the P and D parts of each rule are used:
+ *
+ *      TUNE_ZN_PD          Ziegler-Nichols PD, kp = 0.8 Ku, Td = Tu / 8
+ *      TUNE_SOME_OVERSHOOT kp = 0.33 Ku, Td = Tu / 3
+ *      TUNE_NO_OVERSHOOT   kp = 0.2 Ku, Td = Tu / 3
+ *
+ *  The run fails if the swing grows past TUNE_MAX_AMP or the cycles do not
+ *  come within TUNE_TIMEOUT ticks. Results are Q16 DAC counts per degree
+ *  and per deg/s, ready for Ctrl_setGains.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdint.h>
+
+// relay output either side of the DAC mid point, counts
+#define TUNE_RELAY 400
+
+// switching hysteresis, Q16 degrees, two encoder counts
+#define TUNE_HYST 23040L
+
+// swing that aborts the run, Q16 degrees
+#define TUNE_MAX_AMP (20L << 16)
+
+// periods ignored, then averaged
+#define TUNE_SETTLE 2
+#define TUNE_CYCLES 4
+
+// give up after this many control ticks
+#define TUNE_TIMEOUT 2000
+
+// tuning rules
+#define TUNE_ZN_PD          0
+#define TUNE_SOME_OVERSHOOT 1
+#define TUNE_NO_OVERSHOOT   2
+#define TUNE_RULES          3
+
+// run state
+#define TUNE_IDLE       0
+#define TUNE_RUNNING    1
+#define TUNE_DONE       2
+#define TUNE_FAILED     3
+
+typedef struct {
+    int32_t centre;     // position the relay switches about, Q16
+    int32_t hi;         // extremes over the current period, Q16
+    int32_t lo;
+    int32_t ampSum;     // peak to peak over the averaged periods
+    uint16_t periodSum; // ticks over the averaged periods
+    uint16_t ticks;     // since the start of the run
+    uint16_t rise;      // tick of the last upward switch
+    uint16_t cycles;    // periods completed
+    int16_t out;        // relay sign, +1 or -1
+    uint16_t rule;
+    uint16_t state;
+    int32_t ku;         // ultimate gain, Q16 counts per degree
+    int32_t tu;         // ultimate period, Q16 seconds
+    int32_t kp;         // Q16 counts per degree
+    int32_t kd;         // Q16 counts per deg/s
+} AutoTune;
+
+void Tune_start(AutoTune *t, int32_t centre, uint16_t rule);
+int32_t Tune_step(AutoTune *t, int32_t pos);
+
+#define Tune_running(t) ((t)->state == TUNE_RUNNING)
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ *  backlash.c
+ *
+ *  Gear backlash identification and compensation, see backlash.h.
+ */
+
+#include "backlash.h"
+#include "control.h"
+#include "trajectory.h"
+
+// pos in Q16 degrees, normally where the axis is standing
+void Lash_idStart(LashId *id, int32_t pos)
+{
+    id->start = pos;
+    id->travel = 0;
+    id->peak = 0;
+    id->sum = 0;
+    id->drive = 0;
+    id->dir = 1;
+    id->phase = LASH_RAMP;
+    id->runs = 0;
+    id->rest = 0;
+    id->ticks = 0;
+    id->state = LASH_RUNNING;
+}
+
+/*
+ * Output in DAC counts for the axis at pos, Q16 degrees, moving at vel,
+ * Q16 deg/s. Call every control tick while Lash_idRunning, the width is
+ * ready once the state moves on to LASH_DONE.
+ */
+int32_t Lash_idStep(LashId *id, int32_t pos, int32_t vel)
+{
+    int32_t moved = pos - id->start;
+
+    if (id->state != LASH_RUNNING)
+        return DAC_MID;
+
+    if (id->dir < 0) {
+        moved = -moved;
+        vel = -vel;
+    }
+    id->travel += vel;
+    if (++id->ticks > LASH_ID_TIMEOUT || moved > LASH_ID_MAX_GAP) {
+        id->state = LASH_FAILED;
+        return DAC_MID;
+    }
+
+    switch (id->phase) {
+    case LASH_RAMP:
+        if (vel >= LASH_ID_VMOVE) {
+            // broken away, just enough push for the motor on its own
+            id->drive += id->dir * LASH_ID_PUSH;
+            id->peak = vel;
+            id->phase = LASH_CROSS;
+        } else if (id->drive >= LASH_ID_MAX_DRIVE || id->drive <= -LASH_ID_MAX_DRIVE) {
+            id->state = LASH_FAILED;
+            return DAC_MID;
+        } else {
+            id->drive += id->dir * LASH_ID_RAMP;
+        }
+        break;
+    case LASH_CROSS:
+        if (vel > id->peak)
+            id->peak = vel;
+        if (vel < id->peak >> 1) {
+            // stalled against the load on the far side of the gap
+            id->drive = 0;
+            id->rest = 0;
+            id->phase = LASH_REST;
+        }
+        break;
+    case LASH_REST:
+        if (++id->rest < LASH_ID_REST)
+            break;
+        if (id->runs)
+            id->sum += id->travel / CONTROL_RATE_HZ;
+        if (++id->runs > LASH_ID_RUNS) {
+            id->width = id->sum / LASH_ID_RUNS;
+            id->state = LASH_DONE;
+            return DAC_MID;
+        }
+        id->dir = -id->dir;
+        id->start = pos;
+        id->travel = 0;
+        id->phase = LASH_RAMP;
+        break;
+    }
+    return DAC_MID + id->drive;
+}
+
+// width of the gap in Q16 degrees
+void Lash_init(Backlash *l, int32_t width)
+{
+    Lash_setWidth(l, width);
+    l->dir = 0;
+}
+
+// a new width from identification, the side the motor is on is kept
+void Lash_setWidth(Backlash *l, int32_t width)
+{
+    l->half = width > 0 ? width >> 1 : 0;
+}
+
+/*
+ * Shift in Q16 degrees to add to the reference of an axis following
+ * velRef in Q16 deg/s and accRef in Q8 deg/s^2. Call once a control tick.
+ * At rest the motor is left on the side the last move took it to.
+ */
+int32_t Lash_offset(Backlash *l, int32_t velRef, int32_t accRef)
+{
+    int32_t v = velRef + (int32_t)(((int64_t)accRef << 8) * LASH_LEAD_TICKS / CONTROL_RATE_HZ);
+
+    if (v > LASH_VMIN)
+        l->dir = 1;
+    else if (v < -LASH_VMIN)
+        l->dir = -1;
+    return l->dir > 0 ? l->half : l->dir < 0 ? -l->half : 0;
+}
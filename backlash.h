@@ -0,0 +1,118 @@
+/*
+ *  backlash.h
+ *
+ *  Gear backlash identification and compensation for the Piccollo2AMC
+ *  project.
+ *
+ *  The encoder and the tachometer both read the motor side of the 14:1
+ *  gear train, so when an axis reverses the motor crosses the gap between
+ *  the teeth before the load follows. The load stands still for the
+ *  width of the gap and then lurches after the motor, a notch in the
+ *  drawing at every turn, and on every raster line of the sidewind plot.
+ *
+ *  Identification, in place of the control law like the relay tuner:
+ *  from rest the drive is ramped by LASH_ID_RAMP counts a tick until the
+ *  motor breaks away, then held LASH_ID_PUSH above that. The motor on its
+ *  own crosses the gap with that, the motor and load together cannot, so
+ *  it stalls as soon as the teeth take the load up on the far side, seen
+ *  as the tachometer falling to half the speed the crossing reached. The
+ *  drive is dropped, and once the tachometer average has run out the
+ *  travel is read off its integral, which unlike the encoder is not cut
+ *  into 0.18 degree counts, a good part of a gap. The same is done the
+ *  other way, and so on for LASH_ID_RUNS crossings. The first is not
+ *  counted, the axis may have started anywhere in the gap. The run fails
+ *  if the motor will not break away below LASH_ID_MAX_DRIVE, or runs on
+ *  past LASH_ID_MAX_GAP, which is what a load with too little friction to
+ *  stop it looks like.
+ *
+ *  Compensation: the reference each axis is held to is shifted half the
+ *  gap the way it is going, so the motor leads the load by just the gap
+ *  and the load sits on the reference. At a reversal the shift flips,
+ *  a step of the full width that carries the motor across the gap while
+ *  the reference is still turning. The flip is taken from the reference
+ *  velocity LASH_LEAD_TICKS ahead, so the step goes in before the turn
+ *  by about the loop's delay rather than after it.
+ *
+ *  Positions are Q16 degrees, velocities Q16 deg/s, outputs DAC counts.
+ */
+
+#ifndef BACKLASH_H
+#define BACKLASH_H
+
+#include <stdint.h>
+
+// gap width until an axis is identified, degrees
+#define X_BACKLASH_WIDTH 0.0
+#define Y_BACKLASH_WIDTH 0.0
+
+// control ticks the reversal step is put in ahead of the turn
+#define LASH_LEAD_TICKS 1
+
+// slowest reference velocity that picks a side of the gap, Q16 deg/s
+#define LASH_VMIN 32768L
+
+// identification drive ramp and margin over breakaway, counts
+#define LASH_ID_RAMP 1
+#define LASH_ID_PUSH 4
+#define LASH_ID_MAX_DRIVE 300
+
+// speed that counts as broken away, Q16 deg/s
+#define LASH_ID_VMOVE 65536L
+
+// travel that gives up on a stall, Q16 degrees
+#define LASH_ID_MAX_GAP (4L << 16)
+
+// ticks at rest after a crossing, long enough for the tachometer average
+// to run out
+#define LASH_ID_REST 40
+
+// crossings averaged, after the first
+#define LASH_ID_RUNS 4
+
+// give up after this many control ticks
+#define LASH_ID_TIMEOUT 2000
+
+// identification phases
+#define LASH_RAMP   0
+#define LASH_CROSS  1
+#define LASH_REST   2
+
+// run state
+#define LASH_IDLE       0
+#define LASH_RUNNING    1
+#define LASH_DONE       2
+#define LASH_FAILED     3
+
+typedef struct {
+    int32_t start;      // rest position the crossing started from, Q16
+    int32_t travel;     // tachometer summed over the crossing, Q16 deg/s
+    int32_t peak;       // fastest the crossing went, Q16 deg/s
+    int32_t sum;        // gap over the counted crossings, Q16
+    int16_t drive;      // counts from mid scale
+    int16_t dir;        // +1 or -1
+    uint16_t phase;
+    uint16_t runs;      // crossings completed
+    uint16_t rest;      // ticks at rest
+    uint16_t ticks;     // since the start of the run
+    uint16_t state;
+    int32_t width;      // Q16 degrees
+} LashId;
+
+typedef struct {
+    int32_t half;       // half the gap, Q16 degrees
+    int16_t dir;        // side the reference last drove the motor to
+} Backlash;
+
+void Lash_idStart(LashId *id, int32_t pos);
+int32_t Lash_idStep(LashId *id, int32_t pos, int32_t vel);
+
+void Lash_init(Backlash *l, int32_t width);
+void Lash_setWidth(Backlash *l, int32_t width);
+int32_t Lash_offset(Backlash *l, int32_t velRef, int32_t accRef);
+
+#define Lash_idRunning(id) ((id)->state == LASH_RUNNING)
+
+// widths as Q16 degrees
+#define LASH_Q16(w) ((int32_t)((w) * 65536.0 + 0.5))
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ *  bench.c
+ *
+ *  On target benchmark of the qmath kernels, see bench.h.
+ *
+ *  Each kernel and its IQmath equivalent run over the same inputs, timed
+ *  with the Timestamp counter, and their results are compared. The input
+ *  conversions for IQmath, degrees to radians and back, are done outside
+ *  the timed loops.
+ */
+
+#ifdef __P2AMC_MODE_BENCH
+
+#include <xdc/std.h>
+#include <xdc/runtime/Timestamp.h>
+#define GLOBAL_Q 16
+#include "IQmathLib.h"
+#include "bench.h"
+#include "qmath.h"
+#include "control.h"
+#include "trajectory.h"
+
+BenchResult benchResults[BENCH_KERNELS];
+
+// defined by SIZE() in TMS320F28027.cmd, the address is the size in words
+extern uint16_t CtrlShiftSize;
+extern uint16_t CtrlIQSize;
+
+static int32_t in1[BENCH_RUNS];
+static int32_t in2[BENCH_RUNS];
+static int32_t out[BENCH_RUNS];
+static int32_t ref[BENCH_RUNS];
+// keeps results the benchmark does not compare from being optimised away
+static volatile int32_t sink;
+
+// pi / 180 in Q30, and 180 / pi in Q16
+#define DEG_TO_RAD 18740330L
+#define RAD_TO_DEG 3754936L
+
+static uint32_t perCall(uint32_t start)
+{
+    return (Timestamp_get32() - start) / BENCH_RUNS;
+}
+
+static void compare(BenchResult *r, int16_t shift)
+{
+    int32_t d;
+    uint16_t i;
+
+    r->maxDiff = 0;
+    for (i = 0; i < BENCH_RUNS; i++) {
+        d = (out[i] >> shift) - ref[i];
+        if (d < 0)
+            d = -d;
+        if (d > r->maxDiff)
+            r->maxDiff = d;
+    }
+}
+
+static void benchTrig(void)
+{
+    int32_t s, c;
+    uint32_t t;
+    uint16_t i;
+
+    // -180 to 180 degrees
+    for (i = 0; i < BENCH_RUNS; i++)
+        in1[i] = ((int32_t)i * 360 - (int32_t)180 * BENCH_RUNS) * (65536L / BENCH_RUNS);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++) {
+        qsincos(in1[i], &s, &c);
+        out[i] = s;
+        sink = c;
+    }
+    benchResults[BENCH_SINCOS].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = qsin_lut(in1[i]);
+    benchResults[BENCH_SIN_LUT].ours = perCall(t);
+
+    // the same angles in IQ24 radians
+    for (i = 0; i < BENCH_RUNS; i++)
+        in2[i] = QMPY(in1[i], DEG_TO_RAD, 22);
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++) {
+        s = _IQ24sin(in2[i]);
+        c = _IQ24cos(in2[i]);
+        ref[i] = s;
+        sink = c;
+    }
+    benchResults[BENCH_SINCOS].iq = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = _IQ24sin(in2[i]);
+    benchResults[BENCH_SIN_LUT].iq = perCall(t);
+    compare(&benchResults[BENCH_SIN_LUT], 6);
+
+    for (i = 0; i < BENCH_RUNS; i++) {
+        qsincos(in1[i], &s, &c);
+        out[i] = s;
+    }
+    compare(&benchResults[BENCH_SINCOS], 6);
+}
+
+static void benchAtan(void)
+{
+    uint32_t t;
+    uint16_t i;
+
+    // vectors most of the way round, lengths from 1 to 256 degrees
+    for (i = 0; i < BENCH_RUNS; i++) {
+        qsincos((int32_t)i * (23040000L / BENCH_RUNS), &in1[i], &in2[i]);
+        in1[i] = QMPY(in1[i], (int32_t)(i + 1) << 10, 30 - 6);
+        in2[i] = QMPY(in2[i], (int32_t)(i + 1) << 10, 30 - 6);
+    }
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = qatan2(in1[i], in2[i]);
+    benchResults[BENCH_ATAN2].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = _IQ16atan2(in1[i], in2[i]);
+    benchResults[BENCH_ATAN2].iq = perCall(t);
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = QMPY(ref[i], RAD_TO_DEG, 16);
+    compare(&benchResults[BENCH_ATAN2], 0);
+
+    // the table only covers the right half plane
+    for (i = 0; i < BENCH_RUNS; i++)
+        if (in2[i] <= 0)
+            in2[i] = 1 - in2[i];
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = qatan_lut(in1[i], in2[i]);
+    benchResults[BENCH_ATAN_LUT].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = _IQ16atan2(in1[i], in2[i]);
+    benchResults[BENCH_ATAN_LUT].iq = perCall(t);
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = QMPY(ref[i], RAD_TO_DEG, 16);
+    compare(&benchResults[BENCH_ATAN_LUT], 0);
+}
+
+static void benchDivSqrt(void)
+{
+    uint32_t t;
+    uint16_t i;
+
+    // 1/256 up to about 600, spread over the octaves
+    for (i = 0; i < BENCH_RUNS; i++)
+        in1[i] = ((int32_t)256 + (i & 15) * 61) << (i >> 4);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = qrecip(in1[i]);
+    benchResults[BENCH_RECIP].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = _IQ16div(_IQ16(1), in1[i]);
+    benchResults[BENCH_RECIP].iq = perCall(t);
+    compare(&benchResults[BENCH_RECIP], 0);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = qsqrt(in1[i]);
+    benchResults[BENCH_SQRT].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = _IQ16sqrt(in1[i]);
+    benchResults[BENCH_SQRT].iq = perCall(t);
+    compare(&benchResults[BENCH_SQRT], 0);
+}
+
+static void benchControl(void)
+{
+    CtrlGains shift, iq;
+    uint32_t t;
+    uint16_t i;
+
+    // tachometer sums over the whole ADC range
+    for (i = 0; i < BENCH_RUNS; i++)
+        in1[i] = ((int32_t)i - BENCH_RUNS / 2) * (16384 / (BENCH_RUNS / 2));
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = Ctrl_velocityShift(in1[i]);
+    benchResults[BENCH_CTRL_VEL].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = Ctrl_velocityIQ(in1[i]);
+    benchResults[BENCH_CTRL_VEL].iq = perCall(t);
+    compare(&benchResults[BENCH_CTRL_VEL], 0);
+
+    // errors up to 64 degrees against velocities up to 700 deg/s, and
+    // accelerations up to 16000 deg/s^2, out past saturation both ways
+    for (i = 0; i < BENCH_RUNS; i++) {
+        in2[i] = out[(i * 37) & (BENCH_RUNS - 1)];
+        in1[i] = ((int32_t)i - BENCH_RUNS / 2) << 15;
+    }
+    Ctrl_setGainsShift(&shift, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setGainsIQ(&iq, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&shift, X_KV_DAC, X_KA_DAC);
+    Ctrl_setFeedforward(&iq, X_KV_DAC, X_KA_DAC);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        out[i] = Ctrl_outputShift(&shift, in1[i], in2[i], in2[i], in1[i] >> 2);
+    benchResults[BENCH_CTRL_LAW].ours = perCall(t);
+
+    t = Timestamp_get32();
+    for (i = 0; i < BENCH_RUNS; i++)
+        ref[i] = Ctrl_outputIQ(&iq, in1[i], in2[i], in2[i], in1[i] >> 2);
+    benchResults[BENCH_CTRL_LAW].iq = perCall(t);
+    compare(&benchResults[BENCH_CTRL_LAW], 0);
+    benchResults[BENCH_CTRL_LAW].oursSize = (uint16_t)(unsigned long)&CtrlShiftSize;
+    benchResults[BENCH_CTRL_LAW].iqSize = (uint16_t)(unsigned long)&CtrlIQSize;
+}
+
+void Bench_run(void)
+{
+    benchTrig();
+    benchAtan();
+    benchDivSqrt();
+    benchControl();
+}
+
+#endif
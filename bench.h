@@ -0,0 +1,43 @@
+/*
+ *  bench.h
+ *
+ *  On target benchmark of the qmath kernels against the boot ROM IQmath
+ *  routines, built with __P2AMC_MODE_BENCH. Needs IQmathLib.h and
+ *  IQmath.lib from controlSUITE on the include and library paths.
+ *
+ *  Bench_run fills benchResults, read them from the debugger. The two
+ *  control law builds are linked into sections of their own, ctrlShift
+ *  and ctrlIQ, and their sizes go in with the BENCH_CTRL_LAW cycles.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// calls timed per kernel
+#define BENCH_RUNS 256
+
+#define BENCH_SINCOS    0   // qsincos against _IQ24sin + _IQ24cos, Q24
+#define BENCH_SIN_LUT   1   // qsin_lut against _IQ24sin, Q24
+#define BENCH_ATAN2     2   // qatan2 against _IQ16atan2, Q16 degrees
+#define BENCH_ATAN_LUT  3   // qatan_lut against _IQ16atan2, Q16 degrees
+#define BENCH_RECIP     4   // qrecip against _IQ16div, Q16
+#define BENCH_SQRT      5   // qsqrt against _IQ16sqrt, Q16
+#define BENCH_CTRL_VEL  6   // Ctrl_velocityShift against Ctrl_velocityIQ, Q16
+#define BENCH_CTRL_LAW  7   // Ctrl_outputShift against Ctrl_outputIQ, DAC counts
+#define BENCH_KERNELS   8
+
+typedef struct {
+    uint32_t ours;      // mean cycles per call
+    uint32_t iq;        // mean cycles per call of the IQmath equivalent
+    int32_t maxDiff;    // largest difference between the two, units above
+    uint16_t oursSize;  // code words of each, BENCH_CTRL_LAW only
+    uint16_t iqSize;
+} BenchResult;
+
+extern BenchResult benchResults[BENCH_KERNELS];
+
+void Bench_run(void);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ *  cascade.c
+ *
+ *  Cascaded position and velocity loops, see cascade.h.
+ */
+
+#include "cascade.h"
+#include "control.h"
+#include "qmath.h"
+
+#define I_MAX ((int32_t)CASCADE_I_LIMIT << 16)
+#define U_MAX ((int32_t)(DAC_MAX - DAC_MID) << 16)
+#define U_MIN (-((int32_t)DAC_MID << 16))
+
+void Cascade_init(Cascade *c, int32_t kpos, int32_t kvel, int32_t ki, int32_t kv, int32_t ka)
+{
+    c->kpos = kpos;
+    c->kvel = kvel;
+    c->ki = ki;
+    c->kv = kv;
+    c->ka = ka;
+    c->integ = 0;
+    c->ref.slot[0].vel = c->ref.slot[0].drive = 0;
+    c->ref.slot[1].vel = c->ref.slot[1].drive = 0;
+    c->ref.live = 0;
+}
+
+/*
+ * Outer loop, err the position error in Q16 degrees, following velRef in
+ * Q16 deg/s and accRef in Q8 deg/s^2.
+ */
+void Cascade_outer(Cascade *c, int32_t err, int32_t velRef, int32_t accRef)
+{
+    uint16_t next = c->ref.live ^ 1;
+    int32_t vel = velRef + QMPY(err, c->kpos, 16);
+
+    c->ref.slot[next].vel = vel;
+    c->ref.slot[next].drive = QMPY(vel, c->kv, 16) + QMPY(accRef, c->ka, 8);
+    c->ref.live = next;
+}
+
+/*
+ * Inner loop, DAC output for the axis at vel, Q16 deg/s. The integral is
+ * held while the output is saturated.
+ */
+int32_t Cascade_inner(Cascade *c, int32_t vel)
+{
+    const CascadeRef *r = &c->ref.slot[c->ref.live];
+    int32_t err = r->vel - vel;
+    int32_t u = r->drive + QMPY(err, c->kvel, 16) + c->integ;
+
+    if (u > U_MAX) {
+        u = U_MAX;
+    } else if (u < U_MIN) {
+        u = U_MIN;
+    } else {
+        c->integ += QMPY(err, c->ki, 16);
+        if (c->integ > I_MAX)
+            c->integ = I_MAX;
+        else if (c->integ < -I_MAX)
+            c->integ = -I_MAX;
+    }
+    return DAC_MID + ((u + 0x8000L) >> 16);
+}
@@ -0,0 +1,82 @@
+/*
+ *  cascade.h
+ *
+ *  Cascaded position and velocity loops for the Piccollo2AMC project.
+ *
+ *  The PD law closes position and rate in one place at the control tick,
+ *  so the rate feedback is no faster than the position loop. Split in two:
+ *
+ *      outer   every CONTROL_PERIOD_US in the stepper Swi, turns the
+ *              position error into a velocity command, plus the drive
+ *              the motor model needs for it
+ *
+ *                  vCmd = velRef + kpos err
+ *                  drive = kv vCmd + ka accRef
+ *
+ *      inner   every CASCADE_INNER_US in the tachometer ADC interrupt,
+ *              drives the motor onto the velocity command
+ *
+ *                  u = drive + kvel (vCmd - vel) + ki sum(vCmd - vel)
+ *
+ *  The outer loop hands over through a two slot cell. It fills the slot
+ *  the inner loop is not reading and then flips live, a single word
+ *  write, and as the interrupt always runs to completion over the Swi it
+ *  never sees half a command. No locks, no interrupts disabled.
+ *
+ *  The inner period is independent of the stepper, the timer runs at it
+ *  and the stepper is posted every CASCADE_OUTER_DIV ticks.
+ */
+
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include <stdint.h>
+#include "trajectory.h"
+
+// inner loop period, must divide CONTROL_PERIOD_US
+#define CASCADE_INNER_US 1000
+#define CASCADE_OUTER_DIV (CONTROL_PERIOD_US / CASCADE_INNER_US)
+
+// outer loop, deg/s per degree of error
+#define X_CASCADE_KPOS 60.0
+#define Y_CASCADE_KPOS 60.0
+
+// inner loop, DAC counts per deg/s of velocity error, and the same per
+// second of it integrated
+#define X_CASCADE_KVEL 10.0
+#define X_CASCADE_KI 100.0
+#define Y_CASCADE_KVEL 10.0
+#define Y_CASCADE_KI 100.0
+
+// largest integral term, DAC counts
+#define CASCADE_I_LIMIT 400
+
+typedef struct {
+    int32_t vel;        // velocity command, Q16 deg/s
+    int32_t drive;      // model drive for it, Q16 DAC counts
+} CascadeRef;
+
+typedef struct {
+    CascadeRef slot[2];
+    volatile uint16_t live;
+} CascadeCell;
+
+typedef struct {
+    int32_t kpos;       // Q16 (deg/s) per degree
+    int32_t kvel;       // Q16 counts per deg/s
+    int32_t ki;         // Q16 counts per deg/s per inner tick
+    int32_t kv;         // model, Q16 counts per deg/s
+    int32_t ka;         // Q16 counts per deg/s^2
+    int32_t integ;      // Q16 counts
+    CascadeCell ref;
+} Cascade;
+
+void Cascade_init(Cascade *c, int32_t kpos, int32_t kvel, int32_t ki, int32_t kv, int32_t ka);
+void Cascade_outer(Cascade *c, int32_t err, int32_t velRef, int32_t accRef);
+int32_t Cascade_inner(Cascade *c, int32_t vel);
+
+// gains in the units above to Q16, ki per second to per inner tick
+#define CASCADE_Q16(g) ((int32_t)((g) * 65536.0 + 0.5))
+#define CASCADE_KI_Q16(g) ((int32_t)((g) * 65536.0 * CASCADE_INNER_US / 1e6 + 0.5))
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ *  cogging.c
+ *
+ *  Cogging and torque ripple compensation, see cogging.h.
+ */
+
+#include "cogging.h"
+#include "control.h"
+#include "qmath.h"
+
+#define BIN_MASK (COG_BINS - 1)
+
+static void clearSums(Cogging *c)
+{
+    uint16_t b;
+
+    for (b = 0; b < COG_BINS; b++) {
+        c->sum[0][b] = c->sum[1][b] = 0;
+        c->count[0][b] = c->count[1][b] = 0;
+    }
+    c->dir = 0;
+}
+
+void Cog_init(Cogging *c)
+{
+    uint16_t b;
+
+    for (b = 0; b < COG_BINS; b++)
+        c->table[b] = 0;
+    clearSums(c);
+    c->steady = 0;
+    c->rest = 0;
+    c->passes = 0;
+    c->state = COG_IDLE;
+}
+
+// start learning, the table in use is kept until the first pass is done
+void Cog_learn(Cogging *c)
+{
+    clearSums(c);
+    c->steady = 0;
+    c->rest = 0;
+    c->passes = 0;
+    c->state = COG_LEARNING;
+}
+
+// average of a bin, Q16 counts
+static int32_t binMean(const Cogging *c, uint16_t d, uint16_t b)
+{
+    return (int32_t)(((int64_t)c->sum[d][b] << 16) / c->count[d][b]);
+}
+
+// the averages each way less their mean become the table
+static void passEnd(Cogging *c)
+{
+    int32_t mean[2];
+    uint16_t d, b;
+
+    for (d = 0; d < 2; d++) {
+        mean[d] = 0;
+        for (b = 0; b < COG_BINS; b++) {
+            if (c->count[d][b] < COG_MIN_SAMPLES) {
+                c->state = COG_FAILED;
+                return;
+            }
+            mean[d] += binMean(c, d, b) / COG_BINS;
+        }
+    }
+    for (b = 0; b < COG_BINS; b++)
+        c->table[b] = (int16_t)((binMean(c, 0, b) - mean[0] + binMean(c, 1, b) - mean[1]
+                + (1L << 12)) >> 13);
+    clearSums(c);
+    if (++c->passes == COG_PASSES)
+        c->state = COG_READY;
+}
+
+static uint16_t bothWays(const Cogging *c)
+{
+    uint16_t b;
+
+    for (b = 0; b < COG_BINS; b++)
+        if (c->count[0][b] && c->count[1][b])
+            return 1;
+    return 0;
+}
+
+// output u in counts from mid scale taking effect at bin position b, Q16 bins
+static void learn(Cogging *c, int32_t b, int32_t velRef, int32_t accRef, int32_t u)
+{
+    int16_t dir;
+    uint16_t d, i;
+
+    if (velRef == 0 && accRef == 0) {
+        // a pass ends where the sweep stops, or where it sets out again
+        c->steady = 0;
+        if (++c->rest == COG_REST && bothWays(c))
+            passEnd(c);
+        return;
+    }
+    c->rest = 0;
+    if ((velRef < COG_VMIN && velRef > -COG_VMIN) || accRef > COG_ACC_MAX || accRef < -COG_ACC_MAX) {
+        c->steady = 0;
+        return;
+    }
+    if (c->steady < COG_SETTLE) {
+        c->steady += 1;
+        return;
+    }
+
+    dir = velRef > 0 ? 1 : -1;
+    if (dir > 0 && c->dir < 0 && bothWays(c)) {
+        passEnd(c);
+        if (!Cog_learning(c))
+            return;
+    }
+    c->dir = dir;
+    d = dir > 0 ? 0 : 1;
+    i = (uint16_t)((b + (1L << 15)) >> 16) & BIN_MASK;
+    c->sum[d][i] += u;
+    c->count[d][i] += 1;
+}
+
+/*
+ * The control law output u in DAC counts with the ripple feedforward for
+ * the axis at pos, Q16 degrees, added. velRef in Q16 deg/s and accRef in
+ * Q8 deg/s^2 tell the learning when the reference is cruising. Call once
+ * a tick.
+ */
+int32_t Cog_compensate(Cogging *c, int32_t pos, int32_t velRef, int32_t accRef, int32_t u)
+{
+    int32_t ahead = QMPY(pos + QMPY(velRef, COG_LEAD, 16), COG_BIN_SCALE, 16);
+    uint16_t i = (uint16_t)(ahead >> 16) & BIN_MASK;
+    int32_t t0 = c->table[i];
+    int32_t t1 = c->table[(i + 1) & BIN_MASK];
+
+    u += ((t0 << 12) + QMPY(t1 - t0, ahead & 0xFFFF, 4) + (1L << 15)) >> 16;
+    if (u < 0)
+        u = 0;
+    else if (u > DAC_MAX)
+        u = DAC_MAX;
+    if (c->state == COG_LEARNING)
+        learn(c, ahead, velRef, accRef, u - DAC_MID);
+    return u;
+}
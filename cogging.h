@@ -0,0 +1,109 @@
+/*
+ *  cogging.h
+ *
+ *  Cogging and torque ripple compensation for the Piccollo2AMC project.
+ *
+ *  The commutator and the magnets pull the rotor a little harder at some
+ *  angles than at others, which shows on the tachometer and in the
+ *  tracking error as a ripple repeating every motor revolution, 360 / 14
+ *  degrees of the axis. A table over one motor revolution holds the drive
+ *  the ripple takes, and every tick the entry for the angle the axis will
+ *  be at when the output takes effect, COG_LEAD_US on at the reference
+ *  speed, is interpolated and added to the control law output as
+ *  feedforward. The table is COG_BINS long so the bin falls out of the
+ *  position with one multiply and a mask, whatever the sign of the angle.
+ *
+ *  The encoder only counts from where the axis was at power up, so the
+ *  table is learned at start up with a calibration sweep centred on
+ *  where the axes are: out half of COG_SWEEP_REVS motor revolutions one
+ *  way, COG_PASSES back and forth moves over all of them, and back to the
+ *  start, each axis at COG_SWEEP_FEED. The sweep waits for a relay tune
+ *  or backlash measurement to finish, as they take over the axes.
+ *  While the reference cruises at a steady speed the output on each tick
+ *  is summed into the bin of the angle it takes effect at, COG_LEAD_US on
+ *  as the table is read, separately each way. At the end of each pass the
+ *  averages less their mean each way, which takes out back EMF and
+ *  friction, become the table. Averaging the two ways cancels what is
+ *  left of the shift the loop's lag gives the ripple. The table is used
+ *  from then on, so the next pass learns what it missed, since the
+ *  feedback only ever takes up part of the ripple.
+ *
+ *  A pass with any bin left without COG_MIN_SAMPLES either way fails the
+ *  learning and keeps the last table.
+ *
+ *  Positions are Q16 degrees, outputs DAC counts.
+ */
+
+#ifndef COGGING_H
+#define COGGING_H
+
+#include <stdint.h>
+
+// motor revolutions per axis revolution
+#define COG_GEAR 14
+
+// bins over one motor revolution, must be a power of 2
+#define COG_BINS 64
+
+// bins per axis degree, Q16
+#define COG_BIN_SCALE ((int32_t)(COG_BINS * COG_GEAR / 360.0 * 65536.0 + 0.5))
+
+// time from the sample to the output taking effect, a tick to the DAC
+// write and half the two ticks the DAC holds it, us and Q16 seconds
+#define COG_LEAD_US 10000
+#define COG_LEAD ((int32_t)(COG_LEAD_US * 65536.0 / 1000000.0 + 0.5))
+
+// calibration sweep, motor revolutions end to end, kept inside the
+// +-30 degree travel, and the speed of each axis in deg/s, back and forth
+// this many times. At 10 deg/s an axis the lag shifts the ripple enough
+// that the second pass learns it worse than the first
+#define COG_SWEEP_REVS 2
+#define COG_SWEEP_FEED 7
+#define COG_PASSES 2
+
+// the sweep on each axis, Q16 degrees, and the path feedrate that moves
+// each axis at COG_SWEEP_FEED along the diagonal, Q16 deg/s
+#define COG_SWEEP ((int32_t)(COG_SWEEP_REVS * 360.0 / COG_GEAR * 65536.0 + 0.5))
+#define COG_FEED ((int32_t)(COG_SWEEP_FEED * 1.41421356 * 65536.0 + 0.5))
+
+// moves of the sweep, out to one end, the passes, and back to the start
+#define COG_LEGS (2 * COG_PASSES + 2)
+
+// slowest reference speed learned from, Q16 deg/s, and largest
+// acceleration that still counts as steady, Q8 deg/s^2
+#define COG_VMIN (2L << 16)
+#define COG_ACC_MAX (1L << 8)
+
+// ticks of steady speed before learning, for the transient to die
+#define COG_SETTLE 20
+
+// ticks at rest that end a pass
+#define COG_REST 40
+
+// fewest ticks learned per bin each way
+#define COG_MIN_SAMPLES 2
+
+// learning state
+#define COG_IDLE        0
+#define COG_LEARNING    1
+#define COG_READY       2
+#define COG_FAILED      3
+
+typedef struct {
+    int16_t table[COG_BINS];        // Q4 DAC counts
+    int32_t sum[2][COG_BINS];       // output each way, positive first
+    uint16_t count[2][COG_BINS];
+    uint16_t steady;    // ticks the reference has cruised
+    uint16_t rest;      // ticks the reference has stood still
+    int16_t dir;        // way the last learned tick went
+    uint16_t passes;
+    uint16_t state;
+} Cogging;
+
+void Cog_init(Cogging *c);
+void Cog_learn(Cogging *c);
+int32_t Cog_compensate(Cogging *c, int32_t pos, int32_t velRef, int32_t accRef, int32_t u);
+
+#define Cog_learning(c) ((c)->state == COG_LEARNING)
+
+#endif
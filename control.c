@@ -0,0 +1,115 @@
+/*
+ *  control.c
+ *
+ *  Feedback control law, see control.h.
+ */
+
+#include "control.h"
+#include "qmath.h"
+
+#if defined(__P2AMC_MODE_IQMATH) || defined(__P2AMC_MODE_BENCH)
+#define GLOBAL_Q 16
+#include "IQmathLib.h"
+#endif
+
+#ifdef __P2AMC_MODE_BENCH
+// each build of the law in a section of its own, the linker command file
+// exports their sizes for bench.c
+#pragma CODE_SECTION(saturate, "ctrlShift")
+#pragma CODE_SECTION(Ctrl_outputShift, "ctrlShift")
+#pragma CODE_SECTION(Ctrl_outputIQ, "ctrlIQ")
+#endif
+
+// hand shifted tachometer scale, 714 in Q9 applied to the sum shifted up
+// by 11, folded into one multiply so fast moves cannot overflow
+#define TACHOCALIB 714
+#define TACHOCALIB_Q 9
+#define TACHO_SCALE ((int32_t)TACHOCALIB << (11 - TACHOCALIB_Q))
+
+static int32_t saturate(int32_t counts)
+{
+    if (counts < 0)
+        return 0;
+    if (counts > DAC_MAX)
+        return DAC_MAX;
+    return counts;
+}
+
+// gains outside the range the law can carry without overflowing
+static uint16_t gainsValid(int32_t kp, int32_t kd)
+{
+    return kp >= 0 && kp <= CTRL_KP_MAX && kd >= 0 && kd <= CTRL_KD_MAX;
+}
+
+// tachometer moving sum to velocity, Q16 deg/s
+int32_t Ctrl_velocityShift(int32_t tachoSum)
+{
+    return tachoSum * TACHO_SCALE;
+}
+
+/*
+ * DAC output for a position error err in Q16 degrees and a velocity vel
+ * in Q16 deg/s, with feedforward of the reference velocity in Q16 deg/s
+ * and acceleration in Q8 deg/s^2. The rate feedback acts on the velocity
+ * error, or it would brake against the feedforward while cruising. The
+ * products are taken in 64 bits, a fast move can push kd * vel past 32.
+ */
+int32_t Ctrl_outputShift(const CtrlGains *g, int32_t err, int32_t vel,
+                         int32_t velRef, int32_t accRef)
+{
+    int32_t cerr;
+
+    cerr = QMPY(err, g->kp, 9) - QMPY(vel - velRef, g->kd, 16);
+    cerr += QMPY(velRef, g->kv, 24) + QMPY(accRef, g->ka, 16);
+    cerr >>= 8; // fix output scale
+    return saturate(cerr + DAC_MID); // fix output offset
+}
+
+/*
+ * kp and kd as Q16 DAC counts per degree and per deg/s. Returns 0 and
+ * leaves the gains alone if they are out of range.
+ */
+uint16_t Ctrl_setGainsShift(CtrlGains *g, int32_t kp, int32_t kd)
+{
+    if (!gainsValid(kp, kd))
+        return 0;
+    g->kp = (kp + (1L << 14)) >> 15;
+    g->kd = (kd + (1 << 7)) >> 8;
+    return 1;
+}
+
+// kv and ka as Q16 DAC counts per deg/s and per deg/s^2, either build
+void Ctrl_setFeedforward(CtrlGains *g, int32_t kv, int32_t ka)
+{
+    g->kv = kv;
+    g->ka = ka;
+}
+
+#if defined(__P2AMC_MODE_IQMATH) || defined(__P2AMC_MODE_BENCH)
+
+int32_t Ctrl_velocityIQ(int32_t tachoSum)
+{
+    return _IQmpyI32(_IQ(TACHO_DEG_PER_COUNT), tachoSum);
+}
+
+int32_t Ctrl_outputIQ(const CtrlGains *g, int32_t err, int32_t vel,
+                      int32_t velRef, int32_t accRef)
+{
+    _iq u = _IQmpy(g->kp, err) - _IQmpy(g->kd, vel - velRef);
+
+    u += _IQmpy(g->kv, velRef) + (_IQmpy(g->ka, accRef) << 8);
+
+    u = _IQsat(u, _IQ(DAC_MAX - DAC_MID), _IQ(-DAC_MID));
+    return _IQint(u) + DAC_MID;
+}
+
+uint16_t Ctrl_setGainsIQ(CtrlGains *g, int32_t kp, int32_t kd)
+{
+    if (!gainsValid(kp, kd))
+        return 0;
+    g->kp = kp;
+    g->kd = kd;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ *  control.h
+ *
+ *  Feedback control law for the Piccollo2AMC project.
+ *
+ *  The PD law with rate feedback from the tachometer, plus feedforward of
+ *  the drive the motor needs to follow the reference on its own: back EMF
+ *  for the reference velocity and inertia for the reference acceleration.
+ *  With the feedforward carrying the motion, the feedback only has to
+ *  correct what the model gets wrong, so there is no steady error while
+ *  cruising. It comes in two builds:
+ *
+ *      default             hand shifted integer arithmetic, gains in the
+ *                          Q9/Q16 formats they were first tuned in
+ *      __P2AMC_MODE_IQMATH IQmath _IQmpy/_IQsat with everything in one
+ *                          global Q16, needs IQmathLib.h and IQmath.lib
+ *
+ *  Both produce the same DAC counts to within a count, saturated to the
+ *  DAC range. __P2AMC_MODE_BENCH builds both and compares them, see
+ *  bench.h.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+
+#define DAC_MID 2048
+#define DAC_MAX 4095
+
+// deg/s per count of the 8 sample tachometer sum, the calibrated
+// TACHOCALIB scale of 2856 / 65536
+#define TACHO_DEG_PER_COUNT 0.0435791015625
+
+// gains in DAC counts per degree and per deg/s, as first tuned in the
+// hand shifted formats
+#define X_KP_COUNTS 38.5    // 77 in Q9
+#define X_KD_COUNTS 0.4805  // 123 in Q16
+#define Y_KP_COUNTS 38.0    // 76 in Q9
+#define Y_KD_COUNTS 0.8711  // 223 in Q16
+
+// largest gains either build accepts, Q16 DAC counts per degree and per
+// deg/s. They keep kp * err and kd * vel inside the IQmath build's Q16 for
+// errors up to 127 degrees and speeds up to 2047 deg/s
+#define CTRL_KP_MAX (256L << 16)
+#define CTRL_KD_MAX (16L << 16)
+
+typedef struct {
+    int32_t kp;     // hand shifted: Q9 with the output scale, IQmath: Q16
+    int32_t kd;     // hand shifted: Q16 with the output scale, IQmath: Q16
+    int32_t kv;     // feedforward DAC counts per deg/s, Q16
+    int32_t ka;     // feedforward DAC counts per deg/s^2, Q16
+} CtrlGains;
+
+void Ctrl_setFeedforward(CtrlGains *g, int32_t kv, int32_t ka);
+
+int32_t Ctrl_velocityShift(int32_t tachoSum);
+int32_t Ctrl_outputShift(const CtrlGains *g, int32_t err, int32_t vel,
+                         int32_t velRef, int32_t accRef);
+uint16_t Ctrl_setGainsShift(CtrlGains *g, int32_t kp, int32_t kd);
+#if defined(__P2AMC_MODE_IQMATH) || defined(__P2AMC_MODE_BENCH)
+int32_t Ctrl_velocityIQ(int32_t tachoSum);
+int32_t Ctrl_outputIQ(const CtrlGains *g, int32_t err, int32_t vel,
+                      int32_t velRef, int32_t accRef);
+uint16_t Ctrl_setGainsIQ(CtrlGains *g, int32_t kp, int32_t kd);
+#endif
+
+#ifdef __P2AMC_MODE_IQMATH
+#define Ctrl_velocity Ctrl_velocityIQ
+#define Ctrl_output Ctrl_outputIQ
+#define Ctrl_setGains Ctrl_setGainsIQ
+#else
+#define Ctrl_velocity Ctrl_velocityShift
+#define Ctrl_output Ctrl_outputShift
+#define Ctrl_setGains Ctrl_setGainsShift
+#endif
+
+// gains as Q16 DAC counts per degree and per deg/s
+#define CTRL_Q16(c) ((int32_t)((c) * 65536.0 + 0.5))
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ *  curve.c
+ *
+ *  Arc and cubic Bezier interpolation, see curve.h.
+ */
+
+#include "curve.h"
+#include "qmath.h"
+
+/*
+ * Start an arc from x0, y0 to x1, y1 around the centre at offset i, j from
+ * the start, a full circle if the two points are the same. Returns 0 if
+ * the arc is degenerate and should just be a straight move.
+ */
+uint16_t Curve_arc(Curve *c, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                   int32_t i, int32_t j, uint16_t cw)
+{
+    int32_t r, re, ex, ey, d, d2, d3;
+    int64_t delta;
+
+    c->kind = CURVE_NONE;
+    c->cx = x0 + i;
+    c->cy = y0 + j;
+    c->rx = -i;
+    c->ry = -j;
+    ex = x1 - c->cx;
+    ey = y1 - c->cy;
+    c->endX = x1;
+    c->endY = y1;
+    c->chords = 0;
+    c->cw = cw;
+    c->full = ex == c->rx && ey == c->ry;
+
+    r = isqrt64((uint64_t)((int64_t)c->rx * c->rx + (int64_t)c->ry * c->ry));
+    re = isqrt64((uint64_t)((int64_t)ex * ex + (int64_t)ey * ey));
+    if (r == 0 || re == 0)
+        return 0;
+
+    // chord angle from the sagitta, r (1 - cos(d / 2)) ~ r d^2 / 8, aimed
+    // at 3/4 of the tolerance to leave room for the radius vector drifting
+    // as it is rotated and the points being rounded
+    delta = isqrt64((uint64_t)((((int64_t)CURVE_TOL * 6) << 32) / r));
+    if (delta > 32768L)                             // 0.5 rad
+        delta = 32768L;
+    if (delta < 411775L / CURVE_ARC_MAX_CHORDS)     // 2 pi / max chords
+        delta = 411775L / CURVE_ARC_MAX_CHORDS;
+
+    // cos and sin of the chord angle from their Taylor series, d < 0.5
+    d = (int32_t)delta << 14;
+    d2 = QMPY(d, d, 30);
+    d3 = QMPY(d2, d, 30);
+    c->cosD = Q30_ONE - (d2 >> 1) + QMPY(d2, d2, 30) / 24;
+    c->sinD = d - d3 / 6 + QMPY(d3, d2, 30) / 120;
+    if (cw)
+        c->sinD = -c->sinD;
+
+    c->kind = CURVE_ARC;
+    return 1;
+}
+
+static void arcNext(Curve *c, int32_t *x, int32_t *y)
+{
+    int32_t rx = c->rx, ry = c->ry;
+    int32_t ex = c->endX - c->cx, ey = c->endY - c->cy;
+    int32_t nx, ny;
+    int64_t cross, crossNext, dot;
+
+    nx = (int32_t)(((int64_t)rx * c->cosD - (int64_t)ry * c->sinD) >> 30);
+    ny = (int32_t)(((int64_t)rx * c->sinD + (int64_t)ry * c->cosD) >> 30);
+
+    // finish once the next chord would carry the radius vector past the
+    // end, whatever its length has drifted to
+    if (!c->full || c->chords) {
+        cross = (int64_t)rx * ey - (int64_t)ry * ex;
+        crossNext = (int64_t)nx * ey - (int64_t)ny * ex;
+        dot = (int64_t)rx * ex + (int64_t)ry * ey;
+        if (c->cw) {
+            cross = -cross;
+            crossNext = -crossNext;
+        }
+        if (cross >= 0 && crossNext <= 0 && dot > 0)
+            c->chords = CURVE_ARC_MAX_CHORDS;
+    }
+    if (c->chords >= CURVE_ARC_MAX_CHORDS) {
+        *x = c->endX;
+        *y = c->endY;
+        c->kind = CURVE_NONE;
+        return;
+    }
+
+    c->rx = nx;
+    c->ry = ny;
+    c->chords += 1;
+    *x = c->cx + c->rx;
+    *y = c->cy + c->ry;
+}
+
+static int32_t absMax(int32_t a, int32_t b)
+{
+    a = a < 0 ? -a : a;
+    b = b < 0 ? -b : b;
+    return a > b ? a : b;
+}
+
+/*
+ * Start a cubic Bezier from p0 through control points p1 and p2 to p3.
+ */
+void Curve_bezier(Curve *c, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                  int32_t x2, int32_t y2, int32_t x3, int32_t y3)
+{
+    int64_t ax, ay, bx, by, cx, cy;
+    int32_t bend;
+    uint16_t k = 0;
+
+    // the chord error is at most max|P''| / 8n^2, and |P''| is at most 6
+    // times the larger second difference of the control points
+    bend = absMax(x0 - 2 * x1 + x2, x1 - 2 * x2 + x3)
+         + absMax(y0 - 2 * y1 + y2, y1 - 2 * y2 + y3);
+    while (k < CURVE_BEZIER_MAX_SHIFT
+            && ((int64_t)CURVE_TOL << (2 * k + 2)) < (int64_t)bend * 3)
+        k += 1;
+
+    // polynomial coefficients, P(t) = a t^3 + b t^2 + c t + p0
+    ax = -(int64_t)x0 + 3 * (int64_t)x1 - 3 * (int64_t)x2 + x3;
+    ay = -(int64_t)y0 + 3 * (int64_t)y1 - 3 * (int64_t)y2 + y3;
+    bx = 3 * ((int64_t)x0 - 2 * (int64_t)x1 + x2);
+    by = 3 * ((int64_t)y0 - 2 * (int64_t)y1 + y2);
+    cx = 3 * ((int64_t)x1 - x0);
+    cy = 3 * ((int64_t)y1 - y0);
+
+    // scaled to a step of 2^-k, a h^3, b h^2 and c h in Q48
+    ax <<= 32 - 3 * k;
+    ay <<= 32 - 3 * k;
+    bx <<= 32 - 2 * k;
+    by <<= 32 - 2 * k;
+    cx <<= 32 - k;
+    cy <<= 32 - k;
+
+    c->px = (int64_t)x0 << 32;
+    c->py = (int64_t)y0 << 32;
+    c->d1x = ax + bx + cx;
+    c->d1y = ay + by + cy;
+    c->d2x = 6 * ax + 2 * bx;
+    c->d2y = 6 * ay + 2 * by;
+    c->d3x = 6 * ax;
+    c->d3y = 6 * ay;
+    c->left = 1 << k;
+    c->endX = x3;
+    c->endY = y3;
+    c->kind = CURVE_BEZIER;
+}
+
+static void bezierNext(Curve *c, int32_t *x, int32_t *y)
+{
+    c->px += c->d1x;
+    c->py += c->d1y;
+    c->d1x += c->d2x;
+    c->d1y += c->d2y;
+    c->d2x += c->d3x;
+    c->d2y += c->d3y;
+    c->left -= 1;
+    if (!c->left) {
+        c->kind = CURVE_NONE;
+        *x = c->endX;
+        *y = c->endY;
+        return;
+    }
+    *x = (int32_t)((c->px + 0x80000000L) >> 32);
+    *y = (int32_t)((c->py + 0x80000000L) >> 32);
+}
+
+/*
+ * Next chord end point of the curve, Q16. Returns 0 once it is finished.
+ */
+uint16_t Curve_next(Curve *c, int32_t *x, int32_t *y)
+{
+    switch (c->kind) {
+    case CURVE_ARC:
+        arcNext(c, x, y);
+        return 1;
+    case CURVE_BEZIER:
+        bezierNext(c, x, y);
+        return 1;
+    default:
+        return 0;
+    }
+}
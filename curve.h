@@ -0,0 +1,70 @@
+/*
+ *  curve.h
+ *
+ *  Arc and cubic Bezier interpolation for the Piccollo2AMC project.
+ *
+ *  A curve is broken into chords that stay within CURVE_TOL of it, and the
+ *  chord end points are handed out one at a time for the planner, so a
+ *  curved drawing needs only its control points in flash or on the wire.
+ *
+ *  Beziers are stepped by forward differencing in Q48, three additions per
+ *  axis per point. The step count is a power of 2 so setting up the
+ *  differences is only shifts, and they are exact, the points never drift.
+ *  Arcs rotate the radius vector through a fixed angle per chord.
+ */
+
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <stdint.h>
+
+// largest distance of a chord from the true curve, degrees in Q16
+#define CURVE_TOL 655 // 0.01 degrees
+
+// most chords a single arc is broken into
+#define CURVE_ARC_MAX_CHORDS 256
+
+// a Bezier is broken into at most 2^CURVE_BEZIER_MAX_SHIFT chords
+#define CURVE_BEZIER_MAX_SHIFT 8
+
+#define CURVE_NONE   0
+#define CURVE_ARC    1
+#define CURVE_BEZIER 2
+
+typedef struct {
+    uint16_t kind;
+    int32_t endX;       // last point, Q16
+    int32_t endY;
+
+    // arc
+    int32_t cx;         // centre, Q16
+    int32_t cy;
+    int32_t rx;         // radius vector of the last chord end, Q16
+    int32_t ry;
+    int32_t cosD;       // rotation per chord, Q30
+    int32_t sinD;
+    uint16_t chords;
+    uint16_t cw;
+    uint16_t full;
+
+    // Bezier, point and its forward differences in Q48
+    uint16_t left;
+    int64_t px;
+    int64_t py;
+    int64_t d1x;
+    int64_t d1y;
+    int64_t d2x;
+    int64_t d2y;
+    int64_t d3x;
+    int64_t d3y;
+} Curve;
+
+uint16_t Curve_arc(Curve *c, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                   int32_t i, int32_t j, uint16_t cw);
+void Curve_bezier(Curve *c, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                  int32_t x2, int32_t y2, int32_t x3, int32_t y3);
+uint16_t Curve_next(Curve *c, int32_t *x, int32_t *y);
+
+#define Curve_busy(c) ((c)->kind != CURVE_NONE)
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ *  filter.c
+ *
+ *  Output filters, see filter.h.
+ */
+
+#include "filter.h"
+#include "control.h"
+#include "qmath.h"
+
+#define COEF_Q 28
+
+// 1 / (2 Q) of the Butterworth low pass, Q16
+#define BUTTERWORTH 46341L
+
+// numerator over a0, both Q30, to Q28
+static int32_t norm(int64_t num, int64_t a0)
+{
+    return (int32_t)((num << COEF_Q) / a0);
+}
+
+static void passThrough(Biquad *q)
+{
+    q->b[0] = 1L << COEF_Q;
+    q->b[1] = q->b[2] = 0;
+    q->a[0] = q->a[1] = 0;
+}
+
+/*
+ * Sets up the stages from spec, FILTER_STAGES of them, for running
+ * rateHz times a second. A stage of an unknown type, or that does not
+ * fit below the Nyquist frequency, is left passing through and 0
+ * returned.
+ */
+uint16_t Filt_init(Filter *f, const FiltSpec *spec, uint16_t rateHz)
+{
+    uint16_t i, ok = 1;
+
+    for (i = 0; i < FILTER_STAGES; i++) {
+        Biquad *q = &f->s[i];
+        const FiltSpec *p = &spec[i];
+        int32_t s, c, alpha;
+        int64_t a0;
+
+        q->x[0] = q->x[1] = q->y[0] = q->y[1] = 0;
+        passThrough(q);
+        if (p->type == FILT_NONE)
+            continue;
+        if ((p->type != FILT_NOTCH && p->type != FILT_LOWPASS)
+                || p->freq <= 0 || p->freq >= ((int32_t)rateHz << 15)
+                || (p->type == FILT_NOTCH && (p->width <= 0 || p->width >= ((int32_t)rateHz << 15)
+                    || p->depth < 0))) {
+            ok = 0;
+            continue;
+        }
+
+        // centre as an angle per sample, Q16 degrees
+        qsincos((int32_t)((int64_t)p->freq * 360 / rateHz), &s, &c);
+        if (p->type == FILT_NOTCH) {
+            int32_t sw, cw;
+
+            // the notch width exactly after the bilinear warp, tan of half
+            // of it as an angle per sample
+            qsincos((int32_t)((int64_t)p->width * 180 / rateHz), &sw, &cw);
+            alpha = (int32_t)(((int64_t)sw << 30) / cw);
+        } else {
+            alpha = QMPY(s, BUTTERWORTH, 16);
+        }
+        a0 = Q30_ONE + (int64_t)alpha;
+
+        if (p->type == FILT_NOTCH) {
+            q->b[0] = norm(Q30_ONE + (int64_t)QMPY(alpha, p->depth, 16), a0);
+            q->b[1] = norm(-2 * (int64_t)c, a0);
+            q->b[2] = norm(Q30_ONE - (int64_t)QMPY(alpha, p->depth, 16), a0);
+        } else {
+            q->b[0] = norm((Q30_ONE - (int64_t)c) / 2, a0);
+            q->b[1] = norm(Q30_ONE - (int64_t)c, a0);
+            q->b[2] = q->b[0];
+        }
+        q->a[0] = norm(-2 * (int64_t)c, a0);
+        q->a[1] = norm(Q30_ONE - (int64_t)alpha, a0);
+    }
+    return ok;
+}
+
+/*
+ * Filters the DAC output u through the stages, back to DAC counts
+ * saturated to the DAC range.
+ */
+int32_t Filt_apply(Filter *f, int32_t u)
+{
+    int32_t x = (u - DAC_MID) << 16, y;
+    uint16_t i;
+
+    for (i = 0; i < FILTER_STAGES; i++) {
+        Biquad *q = &f->s[i];
+        int64_t acc = (int64_t)q->b[0] * x + (int64_t)q->b[1] * q->x[0]
+                + (int64_t)q->b[2] * q->x[1] - (int64_t)q->a[0] * q->y[0]
+                - (int64_t)q->a[1] * q->y[1];
+
+        y = (int32_t)(acc >> COEF_Q);
+        q->x[1] = q->x[0];
+        q->x[0] = x;
+        q->y[1] = q->y[0];
+        q->y[0] = y;
+        x = y;
+    }
+    y = DAC_MID + ((x + 0x8000L) >> 16);
+    if (y < 0)
+        return 0;
+    if (y > DAC_MAX)
+        return DAC_MAX;
+    return y;
+}
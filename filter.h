@@ -0,0 +1,82 @@
+/*
+ *  filter.h
+ *
+ *  Output filters for the Piccollo2AMC project.
+ *
+ *  Past the tuned kd the gear train and load ring, and the control law
+ *  passes that straight back to the motor. Each axis output goes through
+ *  FILTER_STAGES biquads in series before it reaches voltage[], each one
+ *  of
+ *
+ *      notch       takes the output down to depth times at the centre
+ *                  frequency. A full cut is width wide between its -3 dB
+ *                  points, a shallower one a little narrower
+ *
+ *                      H = 1 - (1 - depth) bandpass
+ *
+ *      low pass    second order Butterworth with its corner at the centre
+ *                  frequency, depth and width unused
+ *
+ *      none        passes the output through
+ *
+ *  The coefficients are worked out once from the specs at init, with the
+ *  CORDIC sine and cosine, and kept in Q28. Each stage is direct form I
+ *  with the sums in 64 bits, five multiplies and no branches, and unused
+ *  stages run as pass through, so the filter takes the same time every
+ *  call whatever it is set to. The debug build keeps the longest in
+ *  filterCycles, see task.c.
+ *
+ *  Outputs are DAC counts, frequencies Q16 Hz.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_STAGES 2
+
+// stage types
+#define FILT_NONE       0
+#define FILT_NOTCH      1
+#define FILT_LOWPASS    2
+
+// per axis, a notch on the load resonance and a low pass to take out what
+// is left towards the Nyquist frequency. They run at the rate the axis's
+// DAC is written, CONTROL_RATE_HZ / 2, so all of them must stay below
+// 50 Hz. Move the notch onto the peak a sweep of the output shows on the
+// rig. Each stage costs phase at the loop crossover, with these the
+// overshoot of a step about doubles, see tools/filtersim.cpp
+#define X_NOTCH_HZ 40.0
+#define X_NOTCH_DEPTH 0.1       // -20 dB
+#define X_NOTCH_WIDTH 10.0
+#define X_LOWPASS_HZ 45.0
+#define Y_NOTCH_HZ 40.0
+#define Y_NOTCH_DEPTH 0.1
+#define Y_NOTCH_WIDTH 10.0
+#define Y_LOWPASS_HZ 45.0
+
+typedef struct {
+    uint16_t type;
+    int32_t freq;       // centre or corner, Q16 Hz
+    int32_t depth;      // notch gain at the centre, Q16, 0 cuts right out
+    int32_t width;      // notch width, Q16 Hz
+} FiltSpec;
+
+typedef struct {
+    int32_t b[3];       // Q28, a0 divided out
+    int32_t a[2];
+    int32_t x[2];       // last inputs and outputs, Q16 counts
+    int32_t y[2];
+} Biquad;
+
+typedef struct {
+    Biquad s[FILTER_STAGES];
+} Filter;
+
+uint16_t Filt_init(Filter *f, const FiltSpec *spec, uint16_t rateHz);
+int32_t Filt_apply(Filter *f, int32_t u);
+
+#define FILT_Q16(v) ((int32_t)((v) * 65536.0 + 0.5))
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ *  friction.c
+ *
+ *  Friction compensation and disturbance observer, see friction.h.
+ */
+
+#include "friction.h"
+#include "control.h"
+#include "qmath.h"
+#include "trajectory.h"
+
+#define DOB_MAX ((int32_t)DOB_LIMIT << 16)
+
+// coulomb in DAC counts, viscous, kv and ka in Q16 as in friction.h
+void Fric_init(Friction *f, int32_t coulomb, int32_t viscous, int32_t kv, int32_t ka)
+{
+    uint16_t i;
+
+    f->coulomb = coulomb << 16;
+    f->viscous = viscous;
+    f->kv = kv;
+    f->ka = ka;
+    f->dist = 0;
+    f->velPrev = 0;
+    f->last = 0;
+    for (i = 0; i < FRICTION_TAPS; i++)
+        f->hist[i] = 0;
+    f->sum = 0;
+    f->i = 0;
+}
+
+// friction at vel in Q16 deg/s, Q16 DAC counts
+int32_t Fric_model(const Friction *f, int32_t vel)
+{
+    int32_t c = f->coulomb;
+
+    if (vel < FRICTION_VSTICK && vel > -FRICTION_VSTICK)
+        c = (int32_t)((int64_t)c * vel / FRICTION_VSTICK);
+    else if (vel < 0)
+        c = -c;
+    return c + QMPY(vel, f->viscous, 16);
+}
+
+/*
+ * The control law output u in DAC counts with the friction and the
+ * disturbance estimate added, for the axis err from its reference in Q16
+ * degrees, moving at vel and following velRef in Q16 deg/s. Call once a
+ * tick.
+ */
+int32_t Fric_compensate(Friction *f, int32_t u, int32_t err, int32_t vel, int32_t velRef)
+{
+    int32_t r, model, out;
+
+    // the tachometer averages the velocity over the last FRICTION_TAPS
+    // ticks, so the drive is averaged over the same ticks, the outputs from
+    // two ticks ago back, as the last one reaches the DAC at the next tick
+    r = f->sum / FRICTION_TAPS - QMPY(vel, f->kv, 16)
+        - QMPY(vel - f->velPrev, f->ka, 16) * CONTROL_RATE_HZ;
+    if (vel == 0 && velRef == 0 && err <= FRICTION_DEADBAND && err >= -FRICTION_DEADBAND)
+        r = 0;
+    f->dist += QMPY(r - f->dist, DOB_GAIN, 16);
+    if (f->dist > DOB_MAX)
+        f->dist = DOB_MAX;
+    else if (f->dist < -DOB_MAX)
+        f->dist = -DOB_MAX;
+    f->velPrev = vel;
+
+    model = Fric_model(f, velRef);
+    out = ((u - DAC_MID) << 16) + model + f->dist;
+    if (out > (int32_t)(DAC_MAX - DAC_MID) << 16)
+        out = (int32_t)(DAC_MAX - DAC_MID) << 16;
+    else if (out < -((int32_t)DAC_MID << 16))
+        out = -((int32_t)DAC_MID << 16);
+
+    f->sum += f->last - f->hist[f->i];
+    f->hist[f->i] = f->last;
+    f->i = (f->i + 1) & (FRICTION_TAPS - 1);
+    f->last = out - model;
+    return DAC_MID + ((out + 0x8000L) >> 16);
+}
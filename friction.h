@@ -0,0 +1,88 @@
+/*
+ *  friction.h
+ *
+ *  Friction compensation and disturbance observer for the Piccollo2AMC
+ *  project.
+ *
+ *  The geared SRV02 needs a fair push to get moving, so on a small step
+ *  the PD output falls below it while the error is still a few encoder
+ *  counts and the axis stalls short. Two terms are added to the control
+ *  law output:
+ *
+ *      friction model  Coulomb friction with the sign of the reference
+ *                      velocity, ramped through zero below FRICTION_VSTICK,
+ *                      plus viscous friction beyond the back EMF
+ *
+ *      disturbance     the drive the nominal motor model cannot account
+ *      observer        for, the output the motor had less what its back
+ *                      EMF and inertia took and what the friction model
+ *                      already covered, low pass filtered
+ *
+ *                          d = u - kv vel - ka acc - friction
+ *
+ *                      with the drive averaged over the ticks the
+ *                      tachometer averages the velocity over, so its lag
+ *                      is not taken for a disturbance
+ *
+ *  Stiction, model error and load all end up in the observer, and with
+ *  the axis held up its estimate keeps building until it breaks free. It
+ *  is clamped to DOB_LIMIT so a blocked axis cannot wind it up to full
+ *  drive. Once the axis has stopped within FRICTION_DEADBAND of the
+ *  reference the estimate is let go instead, or it would keep kicking
+ *  the axis from one side of the last encoder count to the other.
+ *
+ *  Built in with __P2AMC_MODE_FRICTION, as the constants below are rough
+ *  and the friction model pushes an axis that has less friction than it
+ *  expects. They can be fitted to a log of the output and the velocity
+ *  with tools/frictionid, see task.c for the log. tools/frictionsim runs
+ *  both terms on a simulated axis.
+ *
+ *  Outputs are DAC counts, velocities Q16 deg/s.
+ */
+
+#ifndef FRICTION_H
+#define FRICTION_H
+
+#include <stdint.h>
+
+// Coulomb friction in DAC counts and viscous friction beyond the back EMF
+// in Q16 counts per deg/s, rough figures until fitted
+#define X_FRICTION_COULOMB 60
+#define X_FRICTION_VISCOUS 0L
+#define Y_FRICTION_COULOMB 60
+#define Y_FRICTION_VISCOUS 0L
+
+// reference speed the Coulomb term reaches full size at, Q16 deg/s
+#define FRICTION_VSTICK (2L << 16)
+
+// position error an axis at rest is left with, Q16 degrees, two encoder
+// counts so reading a count either side of the stop is not a miss
+#define FRICTION_DEADBAND 23040L
+
+// observer filter gain per tick in Q16, 0.2 is a 22 ms time constant
+#define DOB_GAIN 13107L
+
+// largest disturbance the observer compensates, DAC counts
+#define DOB_LIMIT 400
+
+// taps of the tachometer average, the drive is averaged the same
+#define FRICTION_TAPS 8
+
+typedef struct {
+    int32_t coulomb;    // Q16 counts
+    int32_t viscous;    // Q16 counts per deg/s
+    int32_t kv;         // nominal model, Q16 counts per deg/s
+    int32_t ka;         // Q16 counts per deg/s^2
+    int32_t dist;       // estimated disturbance, Q16 counts
+    int32_t velPrev;    // Q16 deg/s
+    int32_t last;       // last output from mid scale less the friction model, Q16
+    int32_t hist[FRICTION_TAPS];    // the ones before it
+    int32_t sum;        // of hist
+    uint16_t i;
+} Friction;
+
+void Fric_init(Friction *f, int32_t coulomb, int32_t viscous, int32_t kv, int32_t ka);
+int32_t Fric_model(const Friction *f, int32_t vel);
+int32_t Fric_compensate(Friction *f, int32_t u, int32_t err, int32_t vel, int32_t velRef);
+
+#endif
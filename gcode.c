@@ -0,0 +1,297 @@
+/*
+ *  gcode.c
+ *
+ *  Character at a time G-code parser.
+ *
+ *  Each word is converted to Q16 as its digits arrive and dropped into the
+ *  line state, the line is executed when its newline arrives. Arcs and
+ *  Beziers are handed to the curve interpolator and their chord end points
+ *  pulled out one at a time.
+ */
+
+#include "gcode.h"
+
+// parser states
+#define GC_WORD         0   // between words
+#define GC_NUMBER       1   // integer part of a word's value
+#define GC_FRACTION     2   // past the decimal point
+#define GC_PAREN        3   // inside ( )
+#define GC_SKIP         4   // rest of the line is a comment
+
+// pending output
+#define GC_NONE         0
+#define GC_LINE         1
+#define GC_CURVE        2
+#define GC_COMMAND      3
+
+// value words kept per line
+#define V_X 0
+#define V_Y 1
+#define V_I 2
+#define V_J 3
+#define V_F 4
+#define V_P 5
+#define V_Q 6
+
+#define HAS(g, v) ((g)->words & (1 << (v)))
+#define VAL(g, v) (HAS(g, v) ? (g)->val[v] : 0)
+
+#define FRACTION_DIGITS 10000   // 4 decimal places, finer than Q16 can hold
+
+static void resetLine(Gcode *g)
+{
+    g->state = GC_WORD;
+    g->letter = 0;
+    g->words = 0;
+    g->error = 0;
+    g->motion = -1;
+    g->relative = -1;
+    g->mcode = -1;
+}
+
+// an M line only carries a command, its words are the arguments
+static void command(Gcode *g)
+{
+    g->cmd.code = g->mcode;
+    g->cmd.has = 0;
+    if (HAS(g, V_I))
+        g->cmd.has |= GCODE_HAS_I;
+    if (HAS(g, V_J))
+        g->cmd.has |= GCODE_HAS_J;
+    if (HAS(g, V_P))
+        g->cmd.has |= GCODE_HAS_P;
+    if (HAS(g, V_Q))
+        g->cmd.has |= GCODE_HAS_Q;
+    g->cmd.i = VAL(g, V_I);
+    g->cmd.j = VAL(g, V_J);
+    g->cmd.p = VAL(g, V_P);
+    g->cmd.q = VAL(g, V_Q);
+    g->pending = GC_COMMAND;
+}
+
+static void execute(Gcode *g)
+{
+    int32_t x = g->x, y = g->y;
+
+    if (g->mcode >= 0) {
+        command(g);
+        return;
+    }
+    if (g->motion >= 0)
+        g->modalMotion = g->motion;
+    if (g->relative >= 0)
+        g->modalRelative = g->relative;
+    if (HAS(g, V_F))
+        g->feed = g->val[V_F] / 60;
+
+    if (g->modalMotion < 2 && !HAS(g, V_X) && !HAS(g, V_Y))
+        return;
+    if (g->modalMotion == 2 || g->modalMotion == 3) {
+        if (!HAS(g, V_I) && !HAS(g, V_J))
+            return;
+    } else if (g->modalMotion == 5 && !HAS(g, V_X) && !HAS(g, V_Y)) {
+        return;
+    }
+
+    if (HAS(g, V_X))
+        x = g->modalRelative ? x + g->val[V_X] : g->val[V_X];
+    if (HAS(g, V_Y))
+        y = g->modalRelative ? y + g->val[V_Y] : g->val[V_Y];
+
+    g->outX = x;
+    g->outY = y;
+    g->outFeed = g->modalMotion == 0 ? GCODE_RAPID : g->feed;
+    g->pending = GC_LINE;
+    if (g->modalMotion == 2 || g->modalMotion == 3) {
+        if (Curve_arc(&g->curve, g->x, g->y, x, y, VAL(g, V_I), VAL(g, V_J),
+                g->modalMotion == 2))
+            g->pending = GC_CURVE;
+    } else if (g->modalMotion == 5) {
+        // control points are offsets from the start and from the end
+        Curve_bezier(&g->curve, g->x, g->y, g->x + VAL(g, V_I), g->y + VAL(g, V_J),
+                x + VAL(g, V_P), y + VAL(g, V_Q), x, y);
+        g->pending = GC_CURVE;
+    }
+    g->x = x;
+    g->y = y;
+}
+
+// store the word that has just ended
+static void endWord(Gcode *g)
+{
+    int32_t v;
+
+    if (g->state != GC_NUMBER && g->state != GC_FRACTION) {
+        if (g->letter)
+            g->error = 1;   // letter with no value
+        g->letter = 0;
+        return;
+    }
+
+    v = (g->ipart << 16) + (int32_t)(((int64_t)g->fnum << 16) / g->fden);
+    v *= g->sign;
+
+    switch (g->letter) {
+    case 'G':
+        switch (g->ipart) {
+        case 0: case 1: case 2: case 3: case 5:
+            if (g->mcode >= 0)
+                g->error = 1;
+            g->motion = (int16_t)g->ipart;
+            break;
+        case 90:
+            g->relative = 0;
+            break;
+        case 91:
+            g->relative = 1;
+            break;
+        case 17: case 21: case 94:
+            break;          // XY plane, millimetres, units per minute
+        default:
+            g->error = 1;
+        }
+        break;
+    case 'M':
+        // one command a line, and no moves with it
+        if (g->mcode >= 0 || g->motion >= 0 || g->ipart > 0x7FFF)
+            g->error = 1;
+        g->mcode = (int16_t)g->ipart;
+        break;
+    case 'X': g->val[V_X] = v; g->words |= 1 << V_X; break;
+    case 'Y': g->val[V_Y] = v; g->words |= 1 << V_Y; break;
+    case 'I': g->val[V_I] = v; g->words |= 1 << V_I; break;
+    case 'J': g->val[V_J] = v; g->words |= 1 << V_J; break;
+    case 'P': g->val[V_P] = v; g->words |= 1 << V_P; break;
+    case 'Q': g->val[V_Q] = v; g->words |= 1 << V_Q; break;
+    case 'F':
+        if (v <= 0)
+            g->error = 1;
+        g->val[V_F] = v;
+        g->words |= 1 << V_F;
+        break;
+    default:
+        break;
+    }
+    g->state = GC_WORD;
+    g->letter = 0;
+}
+
+void Gcode_init(Gcode *g, int32_t x, int32_t y)
+{
+    resetLine(g);
+    g->modalMotion = 0;
+    g->modalRelative = 0;
+    g->feed = ((int32_t)GCODE_DEFAULT_FEED << 16) / 60;
+    g->x = x;
+    g->y = y;
+    g->pending = GC_NONE;
+    g->lines = 0;
+    g->errors = 0;
+}
+
+/*
+ * Feed the next received character. Only call this while Gcode_idle, the
+ * output of the last line has to be pulled before the next one can run.
+ */
+void Gcode_putc(Gcode *g, uint16_t c)
+{
+    c &= 0xFF;
+    if (c == '\n') {
+        if (g->state != GC_PAREN && g->state != GC_SKIP)
+            endWord(g);
+        if (g->error || g->state == GC_PAREN)
+            g->errors += 1;
+        else
+            execute(g);
+        g->lines += 1;
+        resetLine(g);
+        return;
+    }
+
+    if (g->state == GC_SKIP)
+        return;
+    if (g->state == GC_PAREN) {
+        if (c == ')')
+            g->state = GC_WORD;
+        return;
+    }
+    if (c == ' ' || c == '\t' || c == '\r')
+        return;
+    if (c == '(' || c == ';') {
+        endWord(g);
+        g->state = c == '(' ? GC_PAREN : GC_SKIP;
+        return;
+    }
+    if (c >= 'a' && c <= 'z')
+        c -= 'a' - 'A';
+
+    if (c >= 'A' && c <= 'Z') {
+        endWord(g);
+        g->letter = c;
+        g->sign = 1;
+        g->ipart = 0;
+        g->fnum = 0;
+        g->fden = 1;
+        return;
+    }
+
+    if (!g->letter) {
+        g->error = 1;
+        return;
+    }
+    if ((c == '-' || c == '+') && g->state == GC_WORD) {
+        g->sign = c == '-' ? -1 : 1;
+        g->state = GC_NUMBER;
+    } else if (c == '.' && g->state != GC_FRACTION) {
+        g->state = GC_FRACTION;
+    } else if (c >= '0' && c <= '9' && g->state == GC_FRACTION) {
+        if (g->fden < FRACTION_DIGITS) {
+            g->fnum = g->fnum * 10 + (c - '0');
+            g->fden *= 10;
+        }
+    } else if (c >= '0' && c <= '9') {
+        g->ipart = g->ipart * 10 + (c - '0');
+        g->state = GC_NUMBER;
+        if (g->ipart > 32767)
+            g->error = 1;
+    } else {
+        g->error = 1;
+    }
+}
+
+/*
+ * Pull the next target point of the current line, Q16 degrees, with its
+ * path feedrate in Q16 degrees per second. Returns 0 when there is none.
+ */
+uint16_t Gcode_next(Gcode *g, int32_t *x, int32_t *y, int32_t *feed)
+{
+    switch (g->pending) {
+    case GC_LINE:
+        *x = g->outX;
+        *y = g->outY;
+        *feed = g->outFeed;
+        g->pending = GC_NONE;
+        return 1;
+    case GC_CURVE:
+        Curve_next(&g->curve, x, y);
+        if (!Curve_busy(&g->curve))
+            g->pending = GC_NONE;
+        *feed = g->outFeed;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Pull the command of the current line, if it was an M line. Returns 0
+ * when there is none.
+ */
+uint16_t Gcode_command(Gcode *g, GcodeCommand *cmd)
+{
+    if (g->pending != GC_COMMAND)
+        return 0;
+    *cmd = g->cmd;
+    g->pending = GC_NONE;
+    return 1;
+}
@@ -0,0 +1,103 @@
+/*
+ *  gcode.h
+ *
+ *  Streaming G-code interpreter for the Piccollo2AMC project.
+ *
+ *  Characters are fed in one at a time as they arrive on SCI-A and parsed
+ *  on the fly, there is no line buffer and nothing is allocated. A line
+ *  that moves the pen produces target points that are pulled out with
+ *  Gcode_next and queued on the planner. No more characters are accepted
+ *  until every point of the line has been pulled out, the serial flow
+ *  control then holds off the host.
+ *
+ *  Supported:
+ *      G0 G1       straight moves, G0 at the axis limits
+ *      G2 G3       clockwise and counter clockwise arcs with I J centre
+ *                  offsets, broken into chords within CURVE_TOL
+ *      G5          cubic Bezier, I J is the first control point as an
+ *                  offset from the start, P Q the second as an offset
+ *                  from the end
+ *      G90 G91     absolute and relative coordinates
+ *      F           feedrate in degrees per minute
+ *      M           a command for the firmware with its I J P Q words,
+ *                  pulled out with Gcode_command instead of moving
+ *      ( ) ;       comments
+ *  N and any other words are accepted and ignored.
+ *
+ *  Coordinates are plot angles in degrees, the same as plot_sidewind.h.
+ */
+
+#ifndef GCODE_H
+#define GCODE_H
+
+#include <stdint.h>
+#include "curve.h"
+
+// feedrate used until the first F word, degrees per minute
+#define GCODE_DEFAULT_FEED 6000
+
+// feedrate handed out for G0, the planner then runs at the axis limits
+#define GCODE_RAPID 0x7FFFFFFFL
+
+typedef struct {
+    uint16_t code;      // M number
+    uint16_t has;       // GCODE_HAS_ bits of the words given
+    int32_t i;          // Q16
+    int32_t j;
+    int32_t p;
+    int32_t q;
+} GcodeCommand;
+
+#define GCODE_HAS_I 1
+#define GCODE_HAS_J 2
+#define GCODE_HAS_P 4
+#define GCODE_HAS_Q 8
+
+typedef struct {
+    // word being parsed
+    uint16_t state;
+    uint16_t letter;
+    int16_t sign;
+    int32_t ipart;
+    int32_t fnum;
+    int32_t fden;
+
+    // line being parsed
+    uint16_t words;     // bit mask of the value words seen on this line
+    uint16_t error;
+    int16_t motion;     // G0 to G3 given on this line, -1 if none
+    int16_t relative;   // G90 or G91 given on this line, -1 if none
+    int16_t mcode;      // M given on this line, -1 if none
+    int32_t val[7];     // X Y I J F P Q, Q16
+
+    // modal state
+    uint16_t modalMotion;
+    uint16_t modalRelative;
+    int32_t feed;       // path feedrate, Q16 degrees per second
+    int32_t x;          // programmed position, Q16
+    int32_t y;
+
+    // output waiting to be pulled
+    uint16_t pending;
+    int32_t outX;
+    int32_t outY;
+    int32_t outFeed;
+    GcodeCommand cmd;
+
+    // arc or Bezier being broken into chords
+    Curve curve;
+
+    // bookkeeping
+    uint16_t lines;
+    uint16_t errors;
+} Gcode;
+
+void Gcode_init(Gcode *g, int32_t x, int32_t y);
+void Gcode_putc(Gcode *g, uint16_t c);
+uint16_t Gcode_next(Gcode *g, int32_t *x, int32_t *y, int32_t *feed);
+uint16_t Gcode_command(Gcode *g, GcodeCommand *cmd);
+
+// no output pending, ready for more characters
+#define Gcode_idle(g) ((g)->pending == 0)
+
+#endif
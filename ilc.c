@@ -0,0 +1,146 @@
+/*
+ *  ilc.c
+ *
+ *  Iterative learning control, see ilc.h.
+ */
+
+#include "ilc.h"
+#include "qmath.h"
+
+static int16_t get(const IlcAxis *a, uint16_t i)
+{
+    uint16_t w = a->c[i >> 1];
+    int16_t b = (i & 1) ? (w >> 8) : (w & 0xFF);
+
+    return b > 127 ? b - 256 : b;
+}
+
+static void put(IlcAxis *a, uint16_t i, int16_t v)
+{
+    uint16_t *w = &a->c[i >> 1];
+
+    if (v > 127)
+        v = 127;
+    else if (v < -127)
+        v = -127;
+    if (i & 1)
+        *w = (*w & 0x00FF) | ((uint16_t)(v & 0xFF) << 8);
+    else
+        *w = (*w & 0xFF00) | (uint16_t)(v & 0xFF);
+}
+
+// correction at tick into sample i, Q16 degrees
+static int32_t correction(const IlcAxis *a, uint16_t i, uint16_t tick)
+{
+    int32_t c0 = get(a, i), c1 = i + 1 < ILC_SAMPLES ? get(a, i + 1) : 0;
+
+    return (c0 * ILC_DECIMATE + (c1 - c0) * tick) * (1L << ILC_SHIFT) / ILC_DECIMATE;
+}
+
+static void learn(IlcAxis *a, uint16_t i)
+{
+    int32_t e = a->errSum / ILC_DECIMATE;
+
+    a->errSq += (uint64_t)((int64_t)e * e);
+    if (i >= ILC_LEAD) {
+        e = QMPY(e, ILC_GAIN, 16);
+        put(a, i - ILC_LEAD, get(a, i - ILC_LEAD)
+            + (int16_t)((e + (1L << (ILC_SHIFT - 1))) >> ILC_SHIFT));
+    }
+    a->errSum = 0;
+}
+
+static void filter(IlcAxis *a, uint16_t n)
+{
+    int32_t y = 0;
+    uint16_t i;
+
+    for (i = 0; i < n; i++) {
+        y += QMPY(((int32_t)get(a, i) << 8) - y, 65536L - ILC_POLE, 16);
+        put(a, i, (int16_t)((y + 128) >> 8));
+    }
+    y = 0;
+    for (i = n; i-- > 0;) {
+        y += QMPY(((int32_t)get(a, i) << 8) - y, 65536L - ILC_POLE, 16);
+        put(a, i, (int16_t)((y + 128) >> 8));
+    }
+    // nothing was learnt past the end of the run
+    for (i = n; i < ILC_SAMPLES; i++)
+        put(a, i, 0);
+}
+
+static void startAxis(IlcAxis *a)
+{
+    a->errSum = 0;
+    a->errSq = 0;
+}
+
+void Ilc_init(Ilc *l)
+{
+    uint16_t i;
+
+    for (i = 0; i < ILC_SAMPLES / 2; i++) {
+        l->x.c[i] = 0;
+        l->y.c[i] = 0;
+    }
+    l->x.rms = 0;
+    l->y.rms = 0;
+    l->samples = 0;
+    l->runs = 0;
+    l->state = ILC_READY;
+}
+
+// from the stepper as a run starts
+void Ilc_begin(Ilc *l)
+{
+    startAxis(&l->x);
+    startAxis(&l->y);
+    l->tick = 0;
+    l->sample = 0;
+    l->state = ILC_RUNNING;
+}
+
+/*
+ * Every tick of a run, with the axis errors ex, ey, reference less
+ * position in Q16 degrees. Hands back the corrections to add to them.
+ */
+void Ilc_step(Ilc *l, int32_t ex, int32_t ey, int32_t *cx, int32_t *cy)
+{
+    if (l->sample >= ILC_SAMPLES) {
+        *cx = 0;
+        *cy = 0;
+        return;
+    }
+    *cx = correction(&l->x, l->sample, l->tick);
+    *cy = correction(&l->y, l->sample, l->tick);
+    l->x.errSum += ex;
+    l->y.errSum += ey;
+    if (++l->tick == ILC_DECIMATE) {
+        learn(&l->x, l->sample);
+        learn(&l->y, l->sample);
+        l->tick = 0;
+        l->sample += 1;
+    }
+}
+
+// from the stepper as the run comes to rest
+void Ilc_end(Ilc *l)
+{
+    l->samples = l->sample;
+    l->state = ILC_ENDED;
+}
+
+// between runs, below the control loop
+void Ilc_filter(Ilc *l)
+{
+    if (l->state != ILC_ENDED)
+        return;
+    if (l->samples) {
+        l->x.rms = isqrt64(l->x.errSq / l->samples);
+        l->y.rms = isqrt64(l->y.errSq / l->samples);
+    }
+    filter(&l->x, l->samples);
+    filter(&l->y, l->samples);
+    l->runs += 1;
+    l->state = ILC_READY;
+}
@@ -0,0 +1,83 @@
+/*
+ *  ilc.h
+ *
+ *  Iterative learning control for the Piccollo2AMC project.
+ *
+ *  A stored plot is drawn the same way every time, so the loops make the
+ *  same tracking errors every time too. While a plotting run is drawn the
+ *  error of each axis is averaged over ILC_DECIMATE ticks into one sample,
+ *  and the correction ILC_LEAD samples earlier, which is already behind
+ *  the stepper, is moved by ILC_GAIN of it:
+ *
+ *      c[i - lead] += gain * e[i]
+ *
+ *  The lead makes up for the loop taking a while to respond to the
+ *  correction. Between runs the corrections are low pass filtered forward
+ *  and then backward, so without a phase shift, which keeps the learning
+ *  from chasing encoder noise and the high frequencies the loops cannot
+ *  follow. On the next run the correction is interpolated between samples
+ *  and added to the axis errors, and the error left shrinks run over run.
+ *
+ *  Corrections are kept as one signed byte a sample in steps of
+ *  2^ILC_SHIFT Q16, 1/64 degree up to 2 degrees, two to a word, so
+ *  ILC_SAMPLES at 50 Hz covers a 10 s run in 256 words an axis. A longer
+ *  run is drawn without correction past the end. tools/ilcsim checks
+ *  plot_sidewind.h fits at TRAJ_FEEDRATE and that the error comes down
+ *  run over run.
+ *
+ *  Only the stepper touches a run in progress, Ilc_filter runs in the path
+ *  feed task once the run has ended.
+ */
+
+#ifndef ILC_H
+#define ILC_H
+
+#include <stdint.h>
+
+// samples an axis, must be even
+#define ILC_SAMPLES 512
+
+// control ticks a sample, 50 Hz
+#define ILC_DECIMATE 4
+
+// correction step, 2^ILC_SHIFT Q16 degrees
+#define ILC_SHIFT 10
+
+// samples the correction is moved ahead of the error it learns from
+#define ILC_LEAD 2
+
+// learning gain and filter pole, Q16
+#define ILC_GAIN 49152L
+#define ILC_POLE 26214L
+
+// run state
+#define ILC_READY       0   // waiting for a run
+#define ILC_RUNNING     1
+#define ILC_ENDED       2   // waiting for Ilc_filter
+
+typedef struct {
+    uint16_t c[ILC_SAMPLES / 2];    // corrections, byte pairs low first
+    int32_t errSum;                 // error over the current sample, Q16
+    uint64_t errSq;                 // over the run, for the rms
+    int32_t rms;                    // last run, Q16 degrees
+} IlcAxis;
+
+typedef struct {
+    IlcAxis x;
+    IlcAxis y;
+    uint16_t tick;      // into the current sample
+    uint16_t sample;
+    uint16_t samples;   // length of the last run
+    uint16_t runs;
+    volatile uint16_t state;
+} Ilc;
+
+void Ilc_init(Ilc *l);
+void Ilc_begin(Ilc *l);
+void Ilc_step(Ilc *l, int32_t ex, int32_t ey, int32_t *cx, int32_t *cy);
+void Ilc_end(Ilc *l);
+void Ilc_filter(Ilc *l);
+
+#define Ilc_running(l) ((l)->state == ILC_RUNNING)
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ *  kinematics.c
+ *
+ *  Plane to axis angle transform, see kinematics.h.
+ *
+ *  The arctangents come from the table in qmath, good to 7 ULP of Q16
+ *  degrees, well under an encoder count.
+ */
+
+#include "kinematics.h"
+#include "qmath.h"
+
+// dist in Q16 screen units, gain is the optical angle per axis angle
+void Kin_init(Kinematics *k, int32_t dist, uint16_t gain)
+{
+    k->dist = dist;
+    k->gain = gain;
+}
+
+/*
+ * Axis angles in Q16 degrees that put the beam on screen point x, y.
+ */
+void Kin_toAxes(const Kinematics *k, int32_t x, int32_t y, int32_t *ax, int32_t *ay)
+{
+    int32_t slant = isqrt64((uint64_t)((int64_t)k->dist * k->dist + (int64_t)x * x));
+
+    *ax = qatan_lut(x, k->dist) / k->gain;
+    *ay = qatan_lut(y, slant) / k->gain;
+}
@@ -0,0 +1,42 @@
+/*
+ *  kinematics.h
+ *
+ *  Plane to axis angle transform for the Piccollo2AMC project.
+ *
+ *  The two axes steer a beam onto a flat screen KIN_DISTANCE away, the x
+ *  axis first and the y axis riding on its output. Equal steps in axis
+ *  angle are not equal steps on the screen, the tangent stretches them
+ *  towards the edges and the y deflection depends on how far out x is,
+ *  so a path that is straight in axis angles bows on the screen. When
+ *  plotting in screen coordinates the trajectory runs in the plane and
+ *  every reference is converted to axis angles here:
+ *
+ *      optical x = atan(x / D)
+ *      optical y = atan(y / sqrt(D^2 + x^2))
+ *
+ *  and the axis turns through the optical angle over KIN_OPTICAL_GAIN, 2
+ *  for a mirror, which doubles the angle it reflects through.
+ *
+ *  Screen coordinates are in the units of the distance, Q16.
+ */
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <stdint.h>
+
+// distance from the axes to the screen, screen units
+#define KIN_DISTANCE 500
+
+// optical angle per axis angle, 2 for a mirror and 1 for a pan/tilt head
+#define KIN_OPTICAL_GAIN 2
+
+typedef struct {
+    int32_t dist;       // distance to the screen, Q16
+    uint16_t gain;
+} Kinematics;
+
+void Kin_init(Kinematics *k, int32_t dist, uint16_t gain);
+void Kin_toAxes(const Kinematics *k, int32_t x, int32_t y, int32_t *ax, int32_t *ay);
+
+#endif
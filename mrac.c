@@ -0,0 +1,124 @@
+/*
+ *  mrac.c
+ *
+ *  Model reference adaptive control, see mrac.h.
+ */
+
+#include "mrac.h"
+#include "control.h"
+#include "qmath.h"
+#include "trajectory.h"
+
+#define Q16(v) ((int32_t)((v) * 65536.0 + 0.5))
+
+// model gains, Q16 per second and per second squared
+#define TWO_ZETA_OMEGA Q16(2.0 * MRAC_ZETA * MRAC_OMEGA)
+#define OMEGA_SQ Q16(MRAC_OMEGA * MRAC_OMEGA)
+#define LAMBDA Q16(MRAC_LAMBDA)
+#define KD Q16(MRAC_KD)
+
+// control tick in Q24 seconds
+#define DT_Q24 ((int32_t)((1L << 24) / CONTROL_RATE_HZ))
+
+// adaptation gains with the tick folded in, Q40 for ka as its regressor
+// is Q8, Q32 for kv
+#define GAMMA_A ((int32_t)(MRAC_GAMMA_A * 1099511627776.0 / CONTROL_RATE_HZ + 0.5))
+#define GAMMA_V ((int32_t)(MRAC_GAMMA_V * 4294967296.0 / CONTROL_RATE_HZ + 0.5))
+
+#define DEADZONE Q16(MRAC_DEADZONE)
+#define VMIN Q16(MRAC_VMIN)
+
+void Mrac_init(Mrac *m, int32_t pos, int32_t kv, int32_t ka)
+{
+    m->ka = ka;
+    m->kv = kv;
+    m->kaMin = QMPY(ka, Q16(MRAC_KA_MIN), 16);
+    m->kaMax = QMPY(ka, Q16(MRAC_KA_MAX), 16);
+    m->kaStep = QMPY(ka, Q16(MRAC_STEP_MAX), 16) + 1;
+    m->kvMin = QMPY(kv, Q16(MRAC_KV_MIN), 16);
+    m->kvMax = QMPY(kv, Q16(MRAC_KV_MAX), 16);
+    m->kvStep = QMPY(kv, Q16(MRAC_STEP_MAX), 16) + 1;
+    m->pm = pos;
+    m->vm = 0;
+    m->s = 0;
+    m->clampA = 0;
+    m->clampV = 0;
+    m->frozen = 0;
+}
+
+/*
+ * Moves the estimate k by the product of the regressor r and s in 64
+ * bits, limited to step, and projects it back into min..max.
+ */
+static int32_t adapt(int32_t k, int64_t rs, int32_t gamma,
+                     int32_t step, int32_t min, int32_t max, uint16_t *clamp)
+{
+    int32_t d = (int32_t)((rs >> 16) * gamma >> 32);
+
+    if (d > step)
+        d = step;
+    else if (d < -step)
+        d = -step;
+    k += d;
+    if (k > max) {
+        k = max;
+        (*clamp)++;
+    } else if (k < min) {
+        k = min;
+        (*clamp)++;
+    }
+    return k;
+}
+
+/*
+ * DAC output to take the axis at pos and vel along the reference model
+ * following posRef, velRef and accRef, adapting the estimates as it goes.
+ */
+int32_t Mrac_output(Mrac *m, int32_t pos, int32_t vel,
+                    int32_t posRef, int32_t velRef, int32_t accRef)
+{
+    int32_t am, e, de, ar, vr, u;
+
+    // the model's acceleration, then one tick on
+    am = accRef + QMPY(velRef - m->vm, TWO_ZETA_OMEGA, 24)
+            + QMPY(posRef - m->pm, OMEGA_SQ, 24);
+
+    e = m->pm - pos;
+    de = m->vm - vel;
+    ar = am + (QMPY(de, LAMBDA, 16) >> 8);
+    vr = m->vm + QMPY(e, LAMBDA, 16);
+    m->s = de + QMPY(e, LAMBDA, 16);
+
+    u = QMPY(ar, m->ka, 8) + QMPY(vr, m->kv, 16) + QMPY(m->s, KD, 16);
+
+    if (!m->frozen && (m->s > DEADZONE || m->s < -DEADZONE)
+            && (m->vm > VMIN || m->vm < -VMIN)) {
+        m->ka = adapt(m->ka, (int64_t)ar * m->s, GAMMA_A,
+                      m->kaStep, m->kaMin, m->kaMax, &m->clampA);
+        m->kv = adapt(m->kv, (int64_t)vr * m->s, GAMMA_V,
+                      m->kvStep, m->kvMin, m->kvMax, &m->clampV);
+    }
+
+    m->pm += QMPY(m->vm, DT_Q24, 24);
+    m->vm += QMPY(am, DT_Q24, 16);
+
+    u = DAC_MID + ((u + 0x8000L) >> 16);
+    if (u < 0)
+        return 0;
+    if (u > DAC_MAX)
+        return DAC_MAX;
+    return u;
+}
+
+// copies the adaptation state for an axis at pos out to t
+void Mrac_snapshot(const Mrac *m, int32_t pos, volatile MracTelemetry *t)
+{
+    t->seq++;
+    t->ka = m->ka;
+    t->kv = m->kv;
+    t->s = m->s;
+    t->err = m->pm - pos;
+    t->clampA = m->clampA;
+    t->clampV = m->clampV;
+    t->seq++;
+}
@@ -0,0 +1,103 @@
+/*
+ *  mrac.h
+ *
+ *  Model reference adaptive control for the Piccollo2AMC project.
+ *
+ *  The PD gains and feedforward are tuned for one load, and the inertia
+ *  and drag of the pen or mirror on the axis change what they should be.
+ *  Each axis runs a reference model of how it should respond, a second
+ *  order loop of MRAC_OMEGA and MRAC_ZETA around the reference:
+ *
+ *      am = accRef + 2 zeta omega (velRef - vm) + omega^2 (posRef - pm)
+ *
+ *  which follows a planned move exactly and rounds off a jump in it. The
+ *  axis is driven onto the model with its inertia and drag estimated as
+ *  ka and kv, and the error left combined into one rate
+ *
+ *      s = (vm - vel) + lambda (pm - pos)
+ *      u = ka (am + lambda (vm - vel)) + kv (vm + lambda (pm - pos)) + kd s
+ *
+ *  so the feedforward and both feedback gains, ka lambda on the velocity
+ *  error and kv lambda on the position error, scale with the estimates.
+ *  The estimates move along each term times s, which by Lyapunov drives s
+ *  and so the model error to zero,
+ *
+ *      ka += gammaA (am + lambda (vm - vel)) s dt
+ *      kv += gammaV (vm + lambda (pm - pos)) s dt
+ *
+ *  with guards against drift: no adaptation while s is inside
+ *  MRAC_DEADZONE or the model is all but stopped, as an axis holding a
+ *  point only hunts across an encoder count and says nothing about the
+ *  load, a step of at most MRAC_STEP_MAX of the nominal a tick, and
+ *  projection onto MRAC_KA_MIN..MRAC_KA_MAX and MRAC_KV_MIN..MRAC_KV_MAX
+ *  times nominal. Hits on the bounds are counted.
+ *
+ *  Mrac_snapshot copies what the adaptation is doing to a telemetry
+ *  record under a sequence count, odd while it is being written, so a
+ *  reader polling it can tell a torn copy, see task.c. The record is
+ *  written through a volatile pointer so the compiler keeps the count
+ *  around the fields in program order.
+ *
+ *  Positions are Q16 degrees, velocities Q16 deg/s, accelerations Q8
+ *  deg/s^2, gains Q16.
+ */
+
+#ifndef MRAC_H
+#define MRAC_H
+
+#include <stdint.h>
+
+// reference model, rad/s
+#define MRAC_OMEGA 25.0
+#define MRAC_ZETA 1.0
+
+// error rate weighting, 1/s, and DAC counts per deg/s of it
+#define MRAC_LAMBDA 30.0
+#define MRAC_KD 0.5
+
+// adaptation gains, per second
+#define MRAC_GAMMA_A 6.0e-7
+#define MRAC_GAMMA_V 1.5e-4
+
+// no adaptation below this error rate, deg/s, or while the model is
+// slower than MRAC_VMIN deg/s
+#define MRAC_DEADZONE 2.0
+#define MRAC_VMIN 1.0
+
+// largest change a tick and the range the estimates are kept in, as
+// fractions of the nominal
+#define MRAC_STEP_MAX 0.002
+#define MRAC_KA_MIN 0.5
+#define MRAC_KA_MAX 4.0
+#define MRAC_KV_MIN 0.5
+#define MRAC_KV_MAX 2.0
+
+typedef struct {
+    uint16_t seq;           // odd while being written
+    int32_t ka;             // estimates, Q16 counts per deg/s^2 and per deg/s
+    int32_t kv;
+    int32_t s;              // error rate, Q16 deg/s
+    int32_t err;            // model less axis position, Q16 degrees
+    uint16_t clampA;        // ticks held at a bound
+    uint16_t clampV;
+} MracTelemetry;
+
+typedef struct {
+    int32_t ka;
+    int32_t kv;
+    int32_t kaMin, kaMax, kaStep;
+    int32_t kvMin, kvMax, kvStep;
+    int32_t pm;             // model position and velocity
+    int32_t vm;
+    int32_t s;
+    uint16_t clampA;
+    uint16_t clampV;
+    uint16_t frozen;        // set to stop adapting and hold the estimates
+} Mrac;
+
+void Mrac_init(Mrac *m, int32_t pos, int32_t kv, int32_t ka);
+int32_t Mrac_output(Mrac *m, int32_t pos, int32_t vel,
+                    int32_t posRef, int32_t velRef, int32_t accRef);
+void Mrac_snapshot(const Mrac *m, int32_t pos, volatile MracTelemetry *t);
+
+#endif
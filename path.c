@@ -0,0 +1,81 @@
+/*
+ *  path.c
+ *
+ *  Streaming decoder for the compact plot path format, see path.h.
+ *
+ *  Every point costs at most one record, at most two varints of at most
+ *  five bytes each, so a point decodes in bounded time from the stepper.
+ */
+
+#include "path.h"
+
+// bytes are packed two to a word since a char is 16 bits on the C28x
+static uint16_t nextByte(PathDecoder *d)
+{
+    uint16_t w = d->data[PATH_HEADER_WORDS + (d->byte >> 1)];
+    uint16_t b = d->byte & 1 ? w >> 8 : w;
+    d->byte += 1;
+    return b & 0xFF;
+}
+
+static uint32_t varint(PathDecoder *d)
+{
+    uint32_t v = 0;
+    uint16_t b, n;
+
+    for (n = 0; n < 35; n += 7) {
+        b = nextByte(d);
+        v |= (uint32_t)(b & 0x7F) << n;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+void Path_open(PathDecoder *d, const uint16_t *path)
+{
+    d->data = path;
+    d->byte = 0;
+    d->left = path[0];
+    d->shift = PATH_MAX_SHIFT - path[1];
+    d->repeat = 0;
+    d->x = 0;
+    d->y = 0;
+    d->dx = 0;
+    d->dy = 0;
+}
+
+/*
+ * Decode the next point into Q16 degrees. Returns 0 once the path is done.
+ */
+uint16_t Path_next(PathDecoder *d, int32_t *x, int32_t *y)
+{
+    uint32_t t;
+
+    if (!d->left)
+        return 0;
+
+    if (d->repeat) {
+        d->repeat -= 1;
+    } else {
+        t = varint(d);
+        if (t & 1) {
+            d->repeat = (uint16_t)(t >> 1);
+        } else {
+            d->dx = unzigzag(t >> 1) << d->shift;
+            d->dy = unzigzag(varint(d)) << d->shift;
+        }
+    }
+
+    d->x += d->dx;
+    d->y += d->dy;
+    d->left -= 1;
+    *x = d->x;
+    *y = d->y;
+    return 1;
+}
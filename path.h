@@ -0,0 +1,53 @@
+/*
+ *  path.h
+ *
+ *  Compact plot path format for the Piccollo2AMC project.
+ *
+ *  A drawing is stored in flash as a stream of bytes, two to a 16 bit word
+ *  with the low byte first, behind a two word header:
+ *
+ *      word 0      number of points
+ *      word 1      resolution, coordinates are whole 2^-n degrees
+ *      word 2..    records
+ *
+ *  Each record starts with an unsigned LEB128 varint token t:
+ *
+ *      t even      new delta, dx = zigzag(t >> 1) and the next varint is
+ *                  zigzag(dy). Produces one point.
+ *      t odd       the last delta is repeated (t >> 1) + 1 times, one
+ *                  point per repeat.
+ *
+ *  Points start from 0, 0 so the first record holds the absolute start.
+ *  Straight runs of evenly spaced points, like the columns of a raster,
+ *  collapse into a single delta and a repeat count.
+ *
+ *  The files are written by tools/pathenc.
+ */
+
+#ifndef PATH_H
+#define PATH_H
+
+#include <stdint.h>
+
+#define PATH_HEADER_WORDS 2
+#define PATH_MAX_SHIFT 16
+
+typedef struct {
+    const uint16_t *data;
+    uint32_t byte;      // next byte of the record stream
+    uint16_t left;      // points still to come
+    uint16_t repeat;    // points left in the current run
+    uint16_t shift;     // 16 - resolution, converts to Q16
+    int32_t x;          // last point, Q16 degrees
+    int32_t y;
+    int32_t dx;         // delta being repeated, Q16 degrees
+    int32_t dy;
+} PathDecoder;
+
+void Path_open(PathDecoder *d, const uint16_t *path);
+uint16_t Path_next(PathDecoder *d, int32_t *x, int32_t *y);
+
+#define Path_more(d) ((d)->left != 0)
+#define Path_points(path) ((path)[0])
+
+#endif
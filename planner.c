@@ -0,0 +1,146 @@
+/*
+ *  planner.c
+ *
+ *  Look ahead planning of the entry velocity of each queued segment.
+ *
+ *  Each segment is limited on entry by the corner it makes with the segment
+ *  before it. The corner speed comes from the junction deviation model: the
+ *  pen is allowed to cut the corner by PLANNER_JUNCTION_DEV on a circle
+ *  tangent to both segments, and the speed around that circle is limited by
+ *  the path acceleration. Colinear points impose no limit at all and a full
+ *  reversal has to stop.
+ *
+ *  Every push then does a backward pass from the newest segment, which must
+ *  always be able to stop, limiting each entry so the segment can slow down
+ *  to the entry of the one after it. A forward pass follows, limiting each
+ *  entry to what can be reached by accelerating from the one before it.
+ *  The backward pass stops as soon as it stops changing anything, and the
+ *  forward pass only revisits what the backward pass touched, so most
+ *  pushes plan only a couple of segments and none plan more than the window.
+ */
+
+#include "planner.h"
+#include "qmath.h"
+
+#define PLANNER_MASK (PLANNER_SEGMENTS - 1)
+
+static PlanBlock *block(Planner *p, int16_t i)
+{
+    return &p->blk[(p->head + i) & PLANNER_MASK];
+}
+
+// highest velocity at which the corner from a into b can be taken
+static int32_t junctionVelocity(const TrajSegment *a, const TrajSegment *b)
+{
+    int32_t cosTheta, sinHalf, ratio, acc, vCap;
+    int64_t v2;
+
+    vCap = a->vMax < b->vMax ? a->vMax : b->vMax;
+    acc = a->acc < b->acc ? a->acc : b->acc;
+
+    // theta is the angle between the reversed incoming and the outgoing
+    // direction, so straight through is -1 and a full reversal is +1
+    cosTheta = -(QMPY(a->dirX, b->dirX, 30) + QMPY(a->dirY, b->dirY, 30));
+    if (cosTheta >= Q30_ONE)
+        return 0;
+    if (cosTheta <= -Q30_ONE)
+        return vCap;
+
+    // sin(theta / 2) = sqrt((1 - cos(theta)) / 2)
+    sinHalf = isqrt64((uint64_t)((Q30_ONE - cosTheta) >> 1) << 30);
+    if (sinHalf >= Q30_ONE - (Q30_ONE >> 10))
+        return vCap;
+
+    // v^2 = acc * dev * sin(theta / 2) / (1 - sin(theta / 2))
+    ratio = (int32_t)(((int64_t)sinHalf << 16) / (Q30_ONE - sinHalf));
+    v2 = ((int64_t)acc * PLANNER_JUNCTION_DEV * ratio) >> 8;
+    v2 = isqrt64((uint64_t)v2);
+    return v2 < vCap ? (int32_t)v2 : vCap;
+}
+
+/*
+ * The oldest segment is never replanned: its entry is already committed,
+ * either to the exit of the segment running before it or to a standing
+ * start.
+ */
+static void replan(Planner *p)
+{
+    PlanBlock *b, *prev;
+    int32_t exitV = 0, v;
+    int16_t i;
+
+    // backward pass, newest first
+    for (i = p->count - 1; i >= 1; i--) {
+        b = block(p, i);
+        v = Traj_reachable(exitV, b->vJunction, b->seg.len, b->seg.acc, b->seg.jerk);
+        if (v == b->vBackward && i < p->count - 1)
+            break;
+        b->vBackward = v;
+        exitV = v;
+    }
+
+    // forward pass over everything the backward pass changed
+    for (i += 1; i < (int16_t)p->count; i++) {
+        prev = block(p, i - 1);
+        b = block(p, i);
+        b->seg.vEntry = Traj_reachable(prev->seg.vEntry, b->vBackward, prev->seg.len,
+                                       prev->seg.acc, prev->seg.jerk);
+    }
+}
+
+void Planner_init(Planner *p, int32_t x, int32_t y)
+{
+    p->head = 0;
+    p->count = 0;
+    p->lastX = x;
+    p->lastY = y;
+}
+
+/*
+ * Queue a straight move from the last queued point to (x, y), both in Q16,
+ * at no more than feed, Q16 degrees per second, and within the axis limits
+ * of t. Returns 0 when the window is full.
+ */
+uint16_t Planner_push(Planner *p, const Trajectory *t, int32_t x, int32_t y, int32_t feed)
+{
+    PlanBlock *b;
+
+    if (Planner_full(p))
+        return 0;
+
+    b = block(p, p->count);
+    Traj_segment(t, &b->seg, p->lastX, p->lastY, x, y, feed);
+    if (b->seg.len == 0)
+        return 1;
+
+    // with nothing queued, whatever ran before this has already been told
+    // to stop
+    if (p->count == 0)
+        b->vJunction = 0;
+    else
+        b->vJunction = junctionVelocity(&block(p, p->count - 1)->seg, &b->seg);
+    b->vBackward = 0;
+    b->seg.vEntry = 0;
+
+    p->count += 1;
+    p->lastX = x;
+    p->lastY = y;
+    replan(p);
+    return 1;
+}
+
+/*
+ * Take the oldest segment for execution. Its exit velocity is the planned
+ * entry of the one after it, which from now on can no longer change.
+ */
+uint16_t Planner_next(Planner *p, TrajSegment *seg)
+{
+    if (Planner_empty(p))
+        return 0;
+
+    *seg = p->blk[p->head].seg;
+    seg->vExit = p->count > 1 ? block(p, 1)->seg.vEntry : 0;
+    p->head = (p->head + 1) & PLANNER_MASK;
+    p->count -= 1;
+    return 1;
+}
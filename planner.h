@@ -0,0 +1,47 @@
+/*
+ *  planner.h
+ *
+ *  Look ahead path planner for the Piccollo2AMC project.
+ *
+ *  Plot points are queued here as segments before the trajectory generator
+ *  executes them. Every time a segment is queued the entry velocity of each
+ *  segment in the window is re-planned so that colinear and shallow corners
+ *  are driven through at speed instead of stopping at every plot point,
+ *  while the last queued segment can always still stop in time.
+ */
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdint.h>
+#include "trajectory.h"
+
+// number of queued segments, must be a power of 2. Each one is 24 words so
+// the whole window fits in L0SARAM alongside the task stacks
+#define PLANNER_SEGMENTS 16
+
+// allowed deviation from the corner when driving through it, degrees in Q16
+#define PLANNER_JUNCTION_DEV 3277 // 0.05 degrees
+
+typedef struct {
+    TrajSegment seg;
+    int32_t vJunction;  // highest entry velocity the corner allows, Q16
+    int32_t vBackward;  // highest entry velocity that can still stop in time
+} PlanBlock;
+
+typedef struct {
+    PlanBlock blk[PLANNER_SEGMENTS];
+    uint16_t head;      // next block to execute
+    uint16_t count;
+    int32_t lastX;      // end point of the last queued segment, Q16
+    int32_t lastY;
+} Planner;
+
+void Planner_init(Planner *p, int32_t x, int32_t y);
+uint16_t Planner_push(Planner *p, const Trajectory *t, int32_t x, int32_t y, int32_t feed);
+uint16_t Planner_next(Planner *p, TrajSegment *seg);
+
+#define Planner_full(p) ((p)->count == PLANNER_SEGMENTS)
+#define Planner_empty(p) ((p)->count == 0)
+
+#endif
@@ -1,35 +1,8 @@
-// this is generated by Gcode-Plot.py
-// These values are in angles from a minimum of -30
-// to a maximum of +30 degrees plot function will take care of
-// the Q values
-#define NVALS 169
-const int32_t xPlots[NVALS] = { -30, -30, -30, -30, -30, -30, -30, -30, -30, -30,
-                              -30, -30, -30, -25, -25, -25, -25, -25, -25, -25,
-                              -25, -25, -25, -25, -25, -25, -20, -20, -20, -20,
-                              -20, -20, -20, -20, -20, -20, -20, -20, -20, -15,
-                              -15, -15, -15, -15, -15, -15, -15, -15, -15, -15,
-                              -15, -15, -10, -10, -10, -10, -10, -10, -10, -10,
-                              -10, -10, -10, -10, -10, -5, -5, -5, -5, -5, -5,
-                              -5, -5, -5, -5, -5, -5, -5, 0, 0, 0, 0, 0, 0, 0,
-                              0, 0, 0, 0, 0, 0, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-                              5, 5, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-                              10, 10, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-                              15, 15, 15, 20, 20, 20, 20, 20, 20, 20, 20, 20,
-                              20, 20, 20, 20, 25, 25, 25, 25, 25, 25, 25, 25,
-                              25, 25, 25, 25, 25, 30, 30, 30, 30, 30, 30, 30,
-                              30, 30, 30, 30, 30, 30 };
-const int32_t yPlots[NVALS] = { -30, -25, -20, -15, -10, -5, 0, 5, 10, 15, 20, 25,
-                              30, 30, 25, 20, 15, 10, 5, 0, -5, -10, -15, -20,
-                              -25, -30, -30, -25, -20, -15, -10, -5, 0, 5, 10,
-                              15, 20, 25, 30, 30, 25, 20, 15, 10, 5, 0, -5, -10,
-                              -15, -20, -25, -30, -30, -25, -20, -15, -10, -5,
-                              0, 5, 10, 15, 20, 25, 30, 30, 25, 20, 15, 10, 5,
-                              0, -5, -10, -15, -20, -25, -30, -30, -25, -20,
-                              -15, -10, -5, 0, 5, 10, 15, 20, 25, 30, 30, 25,
-                              20, 15, 10, 5, 0, -5, -10, -15, -20, -25, -30,
-                              -30, -25, -20, -15, -10, -5, 0, 5, 10, 15, 20, 25,
-                              30, 30, 25, 20, 15, 10, 5, 0, -5, -10, -15, -20,
-                              -25, -30, -30, -25, -20, -15, -10, -5, 0, 5, 10,
-                              15, 20, 25, 30, 30, 25, 20, 15, 10, 5, 0, -5, -10,
-                              -15, -20, -25, -30, -30, -25, -20, -15, -10, -5,
-                              0, 5, 10, 15, 20, 25, 30 };
+// this is generated by tools/pathenc
+// compact plot path in degrees, see path.h for the format
+#define SIDEWIND_POINTS 169
+const uint16_t sidewindPath[35] = {
+    0x00A9, 0x0000, 0x3B76, 0x0A00, 0x1415, 0x0000, 0x1509, 0x0014, 0x0A00, 0x1415,
+    0x0000, 0x1509, 0x0014, 0x0A00, 0x1415, 0x0000, 0x1509, 0x0014, 0x0A00, 0x1415,
+    0x0000, 0x1509, 0x0014, 0x0A00, 0x1415, 0x0000, 0x1509, 0x0014, 0x0A00, 0x1415,
+    0x0000, 0x1509, 0x0014, 0x0A00, 0x0015 };
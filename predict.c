@@ -0,0 +1,108 @@
+/*
+ *  predict.c
+ *
+ *  State prediction to the actuation instant, see predict.h.
+ */
+
+#include "predict.h"
+#include "control.h"
+#include "qmath.h"
+#include "trajectory.h"
+
+#define ONE (1L << 16)
+
+/*
+ * e^-x for x in Q16, by the series on x / 8 and squaring back up, good
+ * to a few parts in 10^5 for the few tau a horizon can be.
+ */
+static int32_t expNeg(int32_t x)
+{
+    int32_t y = x >> 3, e;
+    uint16_t i;
+
+    e = ONE - y + (QMPY(y, y, 16) >> 1) - QMPY(QMPY(y, y, 16), y, 16) / 6;
+    for (i = 0; i < 3; i++)
+        e = QMPY(e, e, 16);
+    return e;
+}
+
+// coefficients for a horizon of us microseconds
+static void horizon(const Predictor *p, PredStep *s, int32_t us)
+{
+    // h / tau and tau, Q16 and Q24 seconds
+    int32_t x = (int32_t)((((int64_t)us * p->kv) << 16) / ((int64_t)p->ka * 1000000));
+    int32_t tau = (int32_t)(((int64_t)p->ka << 24) / p->kv);
+
+    s->decay = expNeg(x);
+    s->pv = QMPY(tau, ONE - s->decay, 16);
+    s->pu = (int32_t)(((int64_t)us << 24) / 1000000) - s->pv;
+}
+
+void Pred_init(Predictor *p, int32_t kv, int32_t ka)
+{
+    uint16_t i;
+
+    p->kv = kv;
+    p->ka = ka;
+    p->invKv = (int32_t)(((int64_t)1 << 32) / kv);
+    horizon(p, &p->tick, CONTROL_PERIOD_US);
+    p->delay = 0;
+    p->h = 0;
+    p->vm = 0;
+    for (i = 0; i < PREDICT_TAPS; i++)
+        p->hist[i] = 0;
+    p->sum = 0;
+    p->i = 0;
+    p->uHeld = 0;
+}
+
+// sets the delay from the sample to the DAC write, us, and starts predicting
+void Pred_setDelay(Predictor *p, int32_t us)
+{
+    horizon(p, &p->ahead, us);
+    p->h = (int32_t)(((int64_t)us << 24) / 1000000);
+    p->delay = us;
+}
+
+/*
+ * One tick, with the axis sampled at pos and the tachometer at vel, and
+ * dac on the DAC until its next write. Returns the position and velocity
+ * the axis will have when the output worked out now reaches the DAC.
+ */
+void Pred_step(Predictor *p, int32_t pos, int32_t vel, int32_t dac,
+               int32_t *posAt, int32_t *velAt)
+{
+    int32_t uVel, v;
+
+    // the model over the tick just gone, under what was on the DAC
+    uVel = p->uHeld * p->invKv;
+    p->vm = QMPY(p->vm, p->tick.decay, 16) + QMPY(uVel, ONE - p->tick.decay, 16);
+    p->sum += p->vm - p->hist[p->i];
+    p->hist[p->i] = p->vm;
+    p->i = (p->i + 1) & (PREDICT_TAPS - 1);
+    p->uHeld = dac - DAC_MID;
+
+    if (!Pred_ready(p)) {
+        *posAt = pos;
+        *velAt = vel;
+        return;
+    }
+
+    // Smith predictor on the tachometer, then on to the DAC write
+    v = p->vm + vel - p->sum / PREDICT_TAPS;
+    uVel = p->uHeld * p->invKv;
+    *posAt = pos + QMPY(v, p->ahead.pv, 24) + QMPY(uVel, p->ahead.pu, 24);
+    *velAt = QMPY(v, p->ahead.decay, 16) + QMPY(uVel, ONE - p->ahead.decay, 16);
+}
+
+/*
+ * Carries the reference on to the DAC write, posRef and velRef in place
+ * at the acceleration accRef, Q8 deg/s^2.
+ */
+void Pred_reference(const Predictor *p, int32_t *posRef, int32_t *velRef, int32_t accRef)
+{
+    int32_t dv = QMPY(accRef, p->h, 24);    // Q8
+
+    *posRef += QMPY(*velRef, p->h, 24) + QMPY(dv, p->h, 17);
+    *velRef += dv << 8;
+}
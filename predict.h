@@ -0,0 +1,100 @@
+/*
+ *  predict.h
+ *
+ *  State prediction to the actuation instant for the Piccollo2AMC project.
+ *
+ *  The output worked out from a sample is not on the DAC until the
+ *  axis's next turn in timerISR, and the tachometer is the average of
+ *  the last eight samples so it lags the motor by three and a half
+ *  ticks on top. The PD law acts on both as if they were now. Instead the
+ *  axis is run through the motor model
+ *
+ *      ka acc + kv vel = u,    tau = ka / kv
+ *
+ *  in two ways:
+ *
+ *      Smith predictor     the model velocity is kept tick by tick from
+ *                          the outputs that were on the DAC, and averaged
+ *                          the way the tachometer is. The tachometer less
+ *                          that average is what the model misses, delayed
+ *                          the same, so
+ *
+ *                              vel = model vel + (tacho - model average)
+ *
+ *                          has the tachometer's lag taken out of what the
+ *                          model accounts for
+ *
+ *      prediction          pos and vel are carried on over the delay to
+ *                          the DAC write under the output on the DAC until
+ *                          then, exactly for the first order motor
+ *
+ *  The references are carried on over the same delay with Pred_reference.
+ *  With the lag gone the PD law takes much stiffer gains, PRED_KP_COUNTS
+ *  and PRED_KD_COUNTS below, that would set the unpredicted loop hunting.
+ *
+ *  The delay from the sample to the write is measured at boot with the
+ *  cycle counter, see task.c. Until it is set the predictor passes the
+ *  measurements through and the tuned gains of control.h stay in use.
+ *
+ *  Positions are Q16 degrees, velocities Q16 deg/s, outputs DAC counts.
+ */
+
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stdint.h>
+
+// DAC writes an axis is timed over at boot
+#define PREDICT_CAL_WRITES 64
+
+// PD gains on the predicted state, DAC counts per degree and per deg/s.
+// kp is three times the tuned gain of control.h on both axes and kd six
+// times on x. y's tuned kd is already near twice x's and six times it
+// overdamps the predicted loop, so it takes the same 2.88, 3.3 times,
+// see tools/predictsim.cpp
+#define X_PRED_KP_COUNTS 115.5
+#define X_PRED_KD_COUNTS 2.88
+#define Y_PRED_KP_COUNTS 114.0
+#define Y_PRED_KD_COUNTS 2.88
+
+// the same as ratios to the tuned gains, a relay tune of the plain loop
+// is scaled by them onto the predicted one
+#define X_PRED_KP_SCALE (X_PRED_KP_COUNTS / X_KP_COUNTS)
+#define X_PRED_KD_SCALE (X_PRED_KD_COUNTS / X_KD_COUNTS)
+#define Y_PRED_KP_SCALE (Y_PRED_KP_COUNTS / Y_KP_COUNTS)
+#define Y_PRED_KD_SCALE (Y_PRED_KD_COUNTS / Y_KD_COUNTS)
+
+// taps of the tachometer average
+#define PREDICT_TAPS 8
+
+// coefficients of the model over one horizon
+typedef struct {
+    int32_t decay;      // e^(-h / tau), Q16
+    int32_t pv;         // tau (1 - decay), Q24 seconds
+    int32_t pu;         // h - tau (1 - decay), Q24 seconds
+} PredStep;
+
+typedef struct {
+    int32_t kv;         // Q16 counts per deg/s
+    int32_t ka;         // Q16 counts per deg/s^2
+    int32_t invKv;      // deg/s per count, Q16
+    PredStep tick;      // over a control tick
+    PredStep ahead;     // over the delay to the DAC
+    int32_t delay;      // us, 0 until set
+    int32_t h;          // the same, Q24 seconds
+    int32_t vm;         // model velocity
+    int32_t hist[PREDICT_TAPS];
+    int32_t sum;        // of hist
+    uint16_t i;
+    int32_t uHeld;      // counts from mid on the DAC since the last tick
+} Predictor;
+
+void Pred_init(Predictor *p, int32_t kv, int32_t ka);
+void Pred_setDelay(Predictor *p, int32_t us);
+void Pred_step(Predictor *p, int32_t pos, int32_t vel, int32_t dac,
+               int32_t *posAt, int32_t *velAt);
+void Pred_reference(const Predictor *p, int32_t *posRef, int32_t *velRef, int32_t accRef);
+
+#define Pred_ready(p) ((p)->delay != 0)
+
+#endif
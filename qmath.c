@@ -0,0 +1,387 @@
+/*
+ *  qmath.c
+ *
+ *  Fixed point helpers shared by the trajectory and control code.
+ */
+
+#include "qmath.h"
+
+#define DEG90  ((int32_t)90 << 16)
+#define DEG180 ((int32_t)180 << 16)
+#define DEG360 ((int32_t)360 << 16)
+
+#define CORDIC_STEPS 24
+
+// atan(2^-i) in Q24 degrees
+static const int32_t cordicAngle[CORDIC_STEPS] = {
+    754974720L, 445687602L, 235489088L, 119537938L, 60000934L, 30029717L,
+    15018523L, 7509720L, 3754917L, 1877466L, 938734L, 469367L,
+    234684L, 117342L, 58671L, 29335L, 14668L, 7334L,
+    3667L, 1833L, 917L, 458L, 229L, 115L
+};
+
+// 1 / the CORDIC gain after CORDIC_STEPS iterations, Q30
+#define CORDIC_K 652032874L
+
+#define LUT_BITS 8
+#define LUT_STEPS (1 << LUT_BITS)
+
+// sin(90 i / 256 degrees) in Q30
+static const int32_t sinTable[LUT_STEPS + 1] = {
+    0L, 6588356L, 13176464L, 19764076L, 26350943L, 32936819L,
+    39521455L, 46104602L, 52686014L, 59265442L, 65842639L, 72417357L,
+    78989349L, 85558366L, 92124163L, 98686491L, 105245103L, 111799753L,
+    118350194L, 124896179L, 131437462L, 137973796L, 144504935L, 151030634L,
+    157550647L, 164064728L, 170572633L, 177074115L, 183568930L, 190056834L,
+    196537583L, 203010932L, 209476638L, 215934457L, 222384147L, 228825464L,
+    235258165L, 241682010L, 248096755L, 254502159L, 260897982L, 267283981L,
+    273659918L, 280025552L, 286380643L, 292724951L, 299058239L, 305380268L,
+    311690799L, 317989595L, 324276419L, 330551034L, 336813204L, 343062693L,
+    349299266L, 355522689L, 361732726L, 367929144L, 374111709L, 380280190L,
+    386434353L, 392573967L, 398698801L, 404808624L, 410903207L, 416982319L,
+    423045732L, 429093217L, 435124548L, 441139496L, 447137835L, 453119340L,
+    459083786L, 465030947L, 470960600L, 476872522L, 482766489L, 488642281L,
+    494499676L, 500338453L, 506158392L, 511959275L, 517740883L, 523502998L,
+    529245404L, 534967884L, 540670223L, 546352205L, 552013618L, 557654248L,
+    563273883L, 568872310L, 574449320L, 580004702L, 585538248L, 591049748L,
+    596538995L, 602005783L, 607449906L, 612871159L, 618269338L, 623644239L,
+    628995660L, 634323400L, 639627258L, 644907034L, 650162530L, 655393548L,
+    660599890L, 665781362L, 670937767L, 676068911L, 681174602L, 686254647L,
+    691308855L, 696337036L, 701339000L, 706314559L, 711263525L, 716185713L,
+    721080937L, 725949013L, 730789757L, 735602987L, 740388522L, 745146182L,
+    749875788L, 754577161L, 759250125L, 763894504L, 768510122L, 773096806L,
+    777654384L, 782182683L, 786681534L, 791150767L, 795590213L, 799999706L,
+    804379079L, 808728167L, 813046808L, 817334838L, 821592095L, 825818421L,
+    830013654L, 834177638L, 838310216L, 842411232L, 846480531L, 850517961L,
+    854523370L, 858496606L, 862437520L, 866345964L, 870221790L, 874064853L,
+    877875009L, 881652112L, 885396022L, 889106597L, 892783698L, 896427186L,
+    900036924L, 903612776L, 907154608L, 910662286L, 914135678L, 917574653L,
+    920979082L, 924348837L, 927683790L, 930983817L, 934248793L, 937478595L,
+    940673101L, 943832191L, 946955747L, 950043650L, 953095785L, 956112036L,
+    959092290L, 962036435L, 964944360L, 967815955L, 970651112L, 973449725L,
+    976211688L, 978936898L, 981625251L, 984276646L, 986890984L, 989468165L,
+    992008094L, 994510675L, 996975812L, 999403415L, 1001793390L, 1004145648L,
+    1006460100L, 1008736660L, 1010975242L, 1013175761L, 1015338134L, 1017462281L,
+    1019548121L, 1021595575L, 1023604567L, 1025575020L, 1027506862L, 1029400018L,
+    1031254418L, 1033069992L, 1034846671L, 1036584389L, 1038283080L, 1039942680L,
+    1041563127L, 1043144360L, 1044686319L, 1046188946L, 1047652185L, 1049075980L,
+    1050460278L, 1051805027L, 1053110176L, 1054375676L, 1055601479L, 1056787540L,
+    1057933813L, 1059040255L, 1060106826L, 1061133483L, 1062120190L, 1063066909L,
+    1063973603L, 1064840240L, 1065666786L, 1066453210L, 1067199483L, 1067905576L,
+    1068571464L, 1069197120L, 1069782521L, 1070327646L, 1070832474L, 1071296985L,
+    1071721163L, 1072104991L, 1072448455L, 1072751542L, 1073014240L, 1073236540L,
+    1073418433L, 1073559913L, 1073660973L, 1073721611L, 1073741824L
+};
+
+// atan(i / 256) in Q16 degrees
+static const int32_t atanTable[LUT_STEPS + 1] = {
+    0L, 14668L, 29335L, 44001L, 58666L, 73329L, 87990L, 102648L,
+    117304L, 131955L, 146603L, 161246L, 175884L, 190517L, 205144L, 219765L,
+    234379L, 248986L, 263585L, 278177L, 292760L, 307334L, 321899L, 336454L,
+    350999L, 365534L, 380058L, 394570L, 409070L, 423558L, 438034L, 452496L,
+    466945L, 481380L, 495801L, 510207L, 524598L, 538973L, 553333L, 567676L,
+    582003L, 596312L, 610605L, 624879L, 639135L, 653372L, 667591L, 681790L,
+    695970L, 710129L, 724268L, 738387L, 752484L, 766560L, 780613L, 794645L,
+    808654L, 822641L, 836604L, 850544L, 864460L, 878352L, 892219L, 906062L,
+    919879L, 933671L, 947438L, 961178L, 974893L, 988580L, 1002241L, 1015875L,
+    1029481L, 1043060L, 1056611L, 1070133L, 1083627L, 1097092L, 1110529L, 1123936L,
+    1137313L, 1150661L, 1163979L, 1177267L, 1190524L, 1203751L, 1216947L, 1230111L,
+    1243245L, 1256347L, 1269417L, 1282455L, 1295461L, 1308435L, 1321376L, 1334285L,
+    1347161L, 1360004L, 1372813L, 1385590L, 1398332L, 1411041L, 1423717L, 1436358L,
+    1448965L, 1461538L, 1474076L, 1486580L, 1499049L, 1511483L, 1523882L, 1536246L,
+    1548575L, 1560868L, 1573127L, 1585349L, 1597536L, 1609687L, 1621803L, 1633882L,
+    1645926L, 1657933L, 1669904L, 1681839L, 1693738L, 1705600L, 1717426L, 1729215L,
+    1740967L, 1752683L, 1764362L, 1776004L, 1787610L, 1799179L, 1810710L, 1822205L,
+    1833663L, 1845084L, 1856467L, 1867814L, 1879123L, 1890396L, 1901631L, 1912829L,
+    1923990L, 1935113L, 1946200L, 1957249L, 1968261L, 1979236L, 1990173L, 2001074L,
+    2011937L, 2022763L, 2033552L, 2044303L, 2055018L, 2065695L, 2076336L, 2086939L,
+    2097505L, 2108034L, 2118526L, 2128981L, 2139399L, 2149780L, 2160125L, 2170432L,
+    2180703L, 2190937L, 2201134L, 2211295L, 2221419L, 2231507L, 2241558L, 2251572L,
+    2261551L, 2271492L, 2281398L, 2291267L, 2301101L, 2310898L, 2320659L, 2330384L,
+    2340074L, 2349727L, 2359345L, 2368927L, 2378474L, 2387985L, 2397460L, 2406901L,
+    2416306L, 2425675L, 2435010L, 2444310L, 2453574L, 2462804L, 2471999L, 2481159L,
+    2490285L, 2499376L, 2508433L, 2517455L, 2526443L, 2535397L, 2544317L, 2553203L,
+    2562055L, 2570873L, 2579658L, 2588409L, 2597126L, 2605811L, 2614461L, 2623079L,
+    2631664L, 2640215L, 2648734L, 2657220L, 2665673L, 2674093L, 2682482L, 2690837L,
+    2699161L, 2707452L, 2715711L, 2723939L, 2732134L, 2740298L, 2748430L, 2756531L,
+    2764600L, 2772638L, 2780644L, 2788620L, 2796564L, 2804478L, 2812361L, 2820213L,
+    2828035L, 2835826L, 2843587L, 2851318L, 2859019L, 2866690L, 2874330L, 2881941L,
+    2889523L, 2897075L, 2904597L, 2912090L, 2919554L, 2926989L, 2934395L, 2941772L,
+    2949120L
+};
+
+// floor(sqrt(x)), one result bit per iteration
+uint32_t isqrt32(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit = 0x40000000L;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    if (x <= 0xFFFFFFFFL)
+        return isqrt32((uint32_t)x);
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+// angle folded into -180 to 180 degrees
+static int32_t wrap(int32_t angle)
+{
+    angle %= DEG360;
+    if (angle >= DEG180)
+        angle -= DEG360;
+    else if (angle < -DEG180)
+        angle += DEG360;
+    return angle;
+}
+
+/*
+ * Sine and cosine of an angle in Q16 degrees, Q30.
+ */
+void qsincos(int32_t angle, int32_t *s, int32_t *c)
+{
+    int32_t x = CORDIC_K, y = 0, z, t;
+    int16_t sign = 1;
+    uint16_t i;
+
+    // CORDIC converges over +-99 degrees, fold the other half circle over
+    angle = wrap(angle);
+    if (angle > DEG90) {
+        angle -= DEG180;
+        sign = -1;
+    } else if (angle < -DEG90) {
+        angle += DEG180;
+        sign = -1;
+    }
+
+    z = angle << 8;
+    for (i = 0; i < CORDIC_STEPS; i++) {
+        t = x;
+        if (z >= 0) {
+            x -= y >> i;
+            y += t >> i;
+            z -= cordicAngle[i];
+        } else {
+            x += y >> i;
+            y -= t >> i;
+            z += cordicAngle[i];
+        }
+    }
+    *s = sign * y;
+    *c = sign * x;
+}
+
+/*
+ * Sine of an angle in Q16 degrees, Q30, by interpolating a quarter wave.
+ */
+int32_t qsin_lut(int32_t angle)
+{
+    int32_t lo, frac;
+    int16_t sign = 1;
+    uint32_t r;
+    uint16_t i;
+
+    angle = wrap(angle);
+    if (angle < 0) {
+        angle = -angle;
+        sign = -1;
+    }
+    if (angle > DEG90)
+        angle = DEG180 - angle;
+
+    // table index with 16 fraction bits, 90 degrees is LUT_STEPS
+    r = (uint32_t)(((uint64_t)angle << (LUT_BITS + 16)) / DEG90);
+    i = (uint16_t)(r >> 16);
+    frac = r & 0xFFFF;
+    if (i >= LUT_STEPS)
+        return sign * sinTable[LUT_STEPS];
+    lo = sinTable[i];
+    return sign * (lo + QMPY(sinTable[i + 1] - lo, frac, 16));
+}
+
+/*
+ * Angle of the vector x, y in Q16 degrees, -180 to 180. Any Q format for
+ * x and y as long as both are the same.
+ */
+int32_t qatan2(int32_t y, int32_t x)
+{
+    int32_t z = 0, t, half = 0;
+    uint16_t i;
+
+    if (x == 0 && y == 0)
+        return 0;
+    // start in the right half plane
+    if (x < 0) {
+        half = y >= 0 ? DEG180 : -DEG180;
+        x = -x;
+        y = -y;
+    }
+    // as many bits as there is headroom for under the CORDIC gain of 1.65
+    while (x > 0x1FFFFFFFL || y > 0x1FFFFFFFL || y < -0x1FFFFFFFL) {
+        x >>= 1;
+        y >>= 1;
+    }
+    while (x < 0x10000000L && y < 0x10000000L && y > -0x10000000L) {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    for (i = 0; i < CORDIC_STEPS; i++) {
+        t = x;
+        if (y < 0) {
+            x -= y >> i;
+            y += t >> i;
+            z -= cordicAngle[i];
+        } else {
+            x += y >> i;
+            y -= t >> i;
+            z += cordicAngle[i];
+        }
+    }
+    return half + ((z + 128) >> 8);
+}
+
+// atan(num / den) for num / den in 0 to 1, Q16 degrees
+static int32_t atanUnit(uint32_t num, uint32_t den)
+{
+    // ratio with 16 fraction bits below the table index
+    uint32_t r = (uint32_t)(((uint64_t)num << (LUT_BITS + 16)) / den);
+    uint16_t i = (uint16_t)(r >> 16);
+    int32_t lo, frac = r & 0xFFFF;
+
+    if (i >= LUT_STEPS)
+        return atanTable[LUT_STEPS];
+    lo = atanTable[i];
+    return lo + QMPY(atanTable[i + 1] - lo, frac, 16);
+}
+
+/*
+ * Arctangent of num / den in Q16 degrees from the table, for den > 0.
+ * The ratio is taken in 64 bits so any Q format works as long as both are
+ * the same.
+ */
+int32_t qatan_lut(int32_t num, int32_t den)
+{
+    uint32_t n = num < 0 ? -num : num;
+    int32_t a;
+
+    if (n <= (uint32_t)den)
+        a = atanUnit(n, den);
+    else
+        a = DEG90 - atanUnit(den, n);
+    return num < 0 ? -a : a;
+}
+
+// shift that brings the top set bit of x up to bit 31
+static uint16_t normalise(uint32_t x)
+{
+    uint16_t n = 0;
+
+    if (!(x & 0xFFFF0000L)) { x <<= 16; n += 16; }
+    if (!(x & 0xFF000000L)) { x <<= 8; n += 8; }
+    if (!(x & 0xF0000000L)) { x <<= 4; n += 4; }
+    if (!(x & 0xC0000000L)) { x <<= 2; n += 2; }
+    if (!(x & 0x80000000L)) { n += 1; }
+    return n;
+}
+
+/*
+ * 1 / x for x in Q16, Q16, saturated where it does not fit.
+ */
+int32_t qrecip(int32_t x)
+{
+    uint32_t d, y, e;
+    uint64_t r;
+    uint16_t n, i;
+    int16_t sign = 1;
+
+    if (x == 0)
+        return 0x7FFFFFFFL;
+    if (x < 0) {
+        x = -x;
+        sign = -1;
+    }
+
+    // d = x scaled into 0.5 to 1, Q32
+    n = normalise((uint32_t)x);
+    d = (uint32_t)x << n;
+
+    // y = 1 / d in Q30, from 48/17 - 32/17 d to within 1/17, each Newton
+    // step squares the error
+    y = 3031741621UL - (uint32_t)(((uint64_t)2021161081UL * d) >> 32);
+    for (i = 0; i < 3; i++) {
+        e = (2UL << 30) - (uint32_t)(((uint64_t)d * y) >> 32);
+        y = (uint32_t)(((uint64_t)y * e) >> 30);
+    }
+
+    // 1 / x = y 2^(n - 16), Q16 is y 2^n in Q30
+    r = n >= 30 ? (uint64_t)y << (n - 30) : (uint64_t)y >> (30 - n);
+    if (r > 0x7FFFFFFFL)
+        r = 0x7FFFFFFFL;
+    return sign * (int32_t)r;
+}
+
+/*
+ * Square root of x in Q16, Q16, rounded down. Negative x gives 0.
+ */
+int32_t qsqrt(int32_t x)
+{
+    uint32_t d, y, e;
+    uint64_t e64, sq, r;
+    uint16_t n, i;
+
+    if (x <= 0)
+        return 0;
+
+    // d = x scaled into 0.25 to 1 by an even shift, Q32
+    n = normalise((uint32_t)x) & ~1;
+    d = (uint32_t)x << n;
+
+    // y = 1 / sqrt(d) in Q30, seeded from 2.134 - 1.222 d to within 9%,
+    // each step y = y (3 - d y^2) / 2 about squares the error
+    y = 2291340853UL - (uint32_t)(((uint64_t)1312099073UL * d) >> 32);
+    for (i = 0; i < 3; i++) {
+        e64 = ((uint64_t)y * y) >> 30;
+        e = (uint32_t)((d * e64) >> 32);
+        y = (uint32_t)(((uint64_t)y * ((3UL << 30) - e)) >> 31);
+    }
+
+    // sqrt(d) = d y, and sqrt(x) in Q16 is sqrt(d) 2^(24 - n / 2)
+    r = ((uint64_t)d * y) >> (38 + n / 2);
+
+    // the last bit exactly, r^2 <= x 2^16 < (r + 1)^2
+    sq = (uint64_t)x << 16;
+    while (r * r > sq)
+        r -= 1;
+    while ((r + 1) * (r + 1) <= sq)
+        r += 1;
+    return (int32_t)r;
+}
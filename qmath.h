@@ -0,0 +1,50 @@
+/*
+ *  qmath.h
+ *
+ *  Fixed point helpers shared by the trajectory and control code.
+ *
+ *  The F28027 has no FPU so everything is done in Q format integers.
+ *  Angles are degrees in Q16 like the axis positions, sines and cosines
+ *  come back in Q30. Error bounds are the worst case over the whole input
+ *  range against double precision, in units of the last place of the
+ *  result:
+ *
+ *      qsincos     CORDIC, 24 iterations of 3 shifts/adds,    140 ULP Q30
+ *                  limited by the 2^-24 degree angle resolution
+ *      qsin_lut    quarter wave table, 256 intervals,        5100 ULP Q30
+ *                  1 multiply and 1 divide, that is 4.7e-6
+ *      qatan2      CORDIC vectoring, 24 iterations              1 ULP Q16
+ *      qatan_lut   table over 0 to 45 degrees,                  7 ULP Q16
+ *                  1 multiply and 1 divide
+ *      qrecip      Newton, 3 iterations of 2 multiplies         1 ULP Q16
+ *      qsqrt       Newton on 1 / sqrt, 3 iterations of 3        exact floor
+ *                  multiplies and at most one correction step
+ *
+ *  The CORDIC routines take no multiplies at all, the table ones are
+ *  quicker but less exact. See bench.c for cycle counts on the target
+ *  against the boot ROM IQmath routines.
+ */
+
+#ifndef QMATH_H
+#define QMATH_H
+
+#include <stdint.h>
+
+// (a * b) >> q with a 64 bit intermediate, maps onto the C28x IMPYL/QMPYL pair
+#define QMPY(a, b, q) ((int32_t)(((int64_t)(a) * (b)) >> (q)))
+
+#define Q30_ONE 0x40000000L
+
+uint32_t isqrt32(uint32_t x);
+uint32_t isqrt64(uint64_t x);
+
+void qsincos(int32_t angle, int32_t *s, int32_t *c);
+int32_t qsin_lut(int32_t angle);
+int32_t qatan2(int32_t y, int32_t x);
+int32_t qatan_lut(int32_t num, int32_t den);
+int32_t qrecip(int32_t x);
+int32_t qsqrt(int32_t x);
+
+#define qcos_lut(angle) qsin_lut((angle) + ((int32_t)90 << 16))
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ *  sched.c
+ *
+ *  Gain scheduling, see sched.h.
+ */
+
+#include "sched.h"
+#include "qmath.h"
+
+#define ONE (1L << 16)
+#define Q16(v) ((int32_t)((v) * 65536.0 + 0.5))
+
+// the table built in. Stiffer on small errors to push through stiction
+// on raster steps, softer with more damping on large errors at speed so a
+// slew does not slam into the stop
+static const int32_t defaultErr[SCHED_ROWS] = {
+    Q16(0.5), Q16(2.0), Q16(5.0), Q16(20.0)
+};
+static const int32_t defaultVel[SCHED_COLS] = {
+    Q16(5.0), Q16(30.0), Q16(100.0), Q16(300.0)
+};
+static const int32_t defaultKp[SCHED_ROWS][SCHED_COLS] = {
+    { Q16(1.5), Q16(1.3), Q16(1.0), Q16(1.0) },
+    { Q16(1.3), Q16(1.2), Q16(1.0), Q16(1.0) },
+    { Q16(1.0), Q16(1.0), Q16(1.0), Q16(0.9) },
+    { Q16(0.8), Q16(0.8), Q16(0.8), Q16(0.7) }
+};
+static const int32_t defaultKd[SCHED_ROWS][SCHED_COLS] = {
+    { Q16(1.3), Q16(1.3), Q16(1.3), Q16(1.3) },
+    { Q16(1.3), Q16(1.3), Q16(1.3), Q16(1.3) },
+    { Q16(1.2), Q16(1.2), Q16(1.3), Q16(1.4) },
+    { Q16(1.0), Q16(1.2), Q16(1.4), Q16(1.6) }
+};
+
+void Sched_init(Sched *s)
+{
+    uint16_t r, c;
+
+    for (r = 0; r < SCHED_ROWS; r++) {
+        s->t[0].err[r] = defaultErr[r];
+        for (c = 0; c < SCHED_COLS; c++) {
+            s->t[0].kp[r][c] = defaultKp[r][c];
+            s->t[0].kd[r][c] = defaultKd[r][c];
+        }
+    }
+    for (c = 0; c < SCHED_COLS; c++)
+        s->t[0].vel[c] = defaultVel[c];
+    s->live = 1;
+    Sched_commit(s);
+}
+
+// the copy being staged
+#define STAGED(s) (&(s)->t[(s)->live ^ 1])
+
+/*
+ * Stages the scales of one entry. Returns 0 if it is out of the table or
+ * the scales out of range.
+ */
+uint16_t Sched_stage(Sched *s, uint16_t row, uint16_t col, int32_t kp, int32_t kd)
+{
+    if (row >= SCHED_ROWS || col >= SCHED_COLS || kp < 0 || kp > SCHED_SCALE_MAX
+            || kd < 0 || kd > SCHED_SCALE_MAX)
+        return 0;
+    STAGED(s)->kp[row][col] = kp;
+    STAGED(s)->kd[row][col] = kd;
+    return 1;
+}
+
+// stages the i-th error and speed breakpoints, checked on commit
+uint16_t Sched_stageBreak(Sched *s, uint16_t i, int32_t err, int32_t vel)
+{
+    if (i >= SCHED_ROWS && i >= SCHED_COLS)
+        return 0;
+    if (i < SCHED_ROWS)
+        STAGED(s)->err[i] = err;
+    if (i < SCHED_COLS)
+        STAGED(s)->vel[i] = vel;
+    return 1;
+}
+
+/*
+ * Checks the staged table, works out its span reciprocals and makes it
+ * live, then starts the next staged copy from it. Returns 0 and leaves
+ * the live table alone if the breakpoints do not rise by SCHED_MIN_SPAN.
+ * Only one task may stage and commit.
+ */
+uint16_t Sched_commit(Sched *s)
+{
+    SchedTable *t = STAGED(s);
+    uint16_t i;
+
+    if (t->err[0] < 0 || t->vel[0] < 0)
+        return 0;
+    for (i = 0; i < SCHED_ROWS - 1; i++)
+        if (t->err[i + 1] - t->err[i] < SCHED_MIN_SPAN)
+            return 0;
+    for (i = 0; i < SCHED_COLS - 1; i++)
+        if (t->vel[i + 1] - t->vel[i] < SCHED_MIN_SPAN)
+            return 0;
+    for (i = 0; i < SCHED_ROWS - 1; i++)
+        t->errInv[i] = (int32_t)(((int64_t)1 << 32) / (t->err[i + 1] - t->err[i]));
+    for (i = 0; i < SCHED_COLS - 1; i++)
+        t->velInv[i] = (int32_t)(((int64_t)1 << 32) / (t->vel[i + 1] - t->vel[i]));
+
+    s->live ^= 1;
+    *STAGED(s) = s->t[s->live];
+    return 1;
+}
+
+void Sched_axis(SchedAxis *a, int32_t kp, int32_t kd)
+{
+    a->kp = kp;
+    a->kd = kd;
+    a->kpNow = kp;
+    a->kdNow = kd;
+}
+
+/*
+ * Where x falls among the n breakpoints at, as the interval index and the
+ * fraction across it in Q16, held at the ends.
+ */
+static uint16_t locate(const int32_t *at, const int32_t *inv, uint16_t n,
+                       int32_t x, int32_t *frac)
+{
+    uint16_t i = 0;
+
+    while (i < n - 2 && x >= at[i + 1])
+        i++;
+    if (x <= at[i])
+        *frac = 0;
+    else if (x >= at[i + 1])
+        *frac = ONE;
+    else
+        *frac = QMPY(x - at[i], inv[i], 16);
+    return i;
+}
+
+// bilinear between the four entries around r, c
+static int32_t blend(const int32_t m[SCHED_ROWS][SCHED_COLS], uint16_t r, uint16_t c,
+                     int32_t fr, int32_t fc)
+{
+    int32_t lo = m[r][c] + QMPY(m[r][c + 1] - m[r][c], fc, 16);
+    int32_t hi = m[r + 1][c] + QMPY(m[r + 1][c + 1] - m[r + 1][c], fc, 16);
+
+    return lo + QMPY(hi - lo, fr, 16);
+}
+
+// moves now towards target by at most step
+static int32_t slew(int32_t now, int32_t target, int32_t step)
+{
+    if (target > now + step)
+        return now + step;
+    if (target < now - step)
+        return now - step;
+    return target;
+}
+
+/*
+ * Moves the axis gains a->kpNow and a->kdNow towards the table's for an
+ * error err and velocity vel.
+ */
+void Sched_gains(const Sched *s, SchedAxis *a, int32_t err, int32_t vel)
+{
+    const SchedTable *t = &s->t[s->live];
+    int32_t fr, fc;
+    uint16_t r, c;
+
+    r = locate(t->err, t->errInv, SCHED_ROWS, err < 0 ? -err : err, &fr);
+    c = locate(t->vel, t->velInv, SCHED_COLS, vel < 0 ? -vel : vel, &fc);
+    a->kpNow = slew(a->kpNow, QMPY(a->kp, blend(t->kp, r, c, fr, fc), 16),
+                    QMPY(a->kp, SCHED_SLEW, 16));
+    a->kdNow = slew(a->kdNow, QMPY(a->kd, blend(t->kd, r, c, fr, fc), 16),
+                    QMPY(a->kd, SCHED_SLEW, 16));
+}
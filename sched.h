@@ -0,0 +1,79 @@
+/*
+ *  sched.h
+ *
+ *  Gain scheduling for the Piccollo2AMC project.
+ *
+ *  One kp and kd cannot suit both a long slew and the short steps of a
+ *  raster. The PD gains are scaled from a table over the size of the
+ *  position error and the speed of the axis,
+ *
+ *      kp = kp tuned * kpScale(|err|, |vel|)
+ *      kd = kd tuned * kdScale(|err|, |vel|)
+ *
+ *  SCHED_ROWS error breakpoints by SCHED_COLS speed breakpoints, shared by
+ *  the axes as the tuned gains already differ. Between breakpoints the
+ *  scales are interpolated in both directions and beyond the last ones
+ *  held, so the gains move smoothly with the error and speed, and each
+ *  tick they move at most SCHED_SLEW of the tuned gains on top of that.
+ *  A lookup is a fixed few comparisons and multiplies, the reciprocals of
+ *  the breakpoint spans are worked out when a table goes live.
+ *
+ *  The table can be replaced while running. Sched_stage writes entries
+ *  into a second copy, Sched_commit checks it and makes it live with a
+ *  single word write, so the control loop never reads half a table. Over
+ *  the serial link, see task.c:
+ *
+ *      M150 I<row> J<col> P<kp scale> Q<kd scale>
+ *      M151 I<index> P<error, degrees> Q<speed, deg/s>
+ *      M152                                    check and make live
+ *
+ *  Errors are Q16 degrees, speeds Q16 deg/s, gains and scales Q16.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#define SCHED_ROWS 4
+#define SCHED_COLS 4
+
+// largest scale a table may hold, Q16
+#define SCHED_SCALE_MAX (4L << 16)
+
+// narrowest span between breakpoints, Q16, a tenth of a degree or deg/s
+#define SCHED_MIN_SPAN 6554L
+
+// most the gains move a tick, fraction of the tuned gains in Q16
+#define SCHED_SLEW 3277L
+
+typedef struct {
+    int32_t err[SCHED_ROWS];        // breakpoints, rising
+    int32_t vel[SCHED_COLS];
+    int32_t kp[SCHED_ROWS][SCHED_COLS];
+    int32_t kd[SCHED_ROWS][SCHED_COLS];
+    int32_t errInv[SCHED_ROWS - 1]; // 2^32 over each span, set on commit
+    int32_t velInv[SCHED_COLS - 1];
+} SchedTable;
+
+typedef struct {
+    SchedTable t[2];
+    volatile uint16_t live;
+} Sched;
+
+typedef struct {
+    int32_t kp;         // tuned gains
+    int32_t kd;
+    int32_t kpNow;      // gains in use
+    int32_t kdNow;
+} SchedAxis;
+
+void Sched_init(Sched *s);
+uint16_t Sched_stage(Sched *s, uint16_t row, uint16_t col, int32_t kp, int32_t kd);
+uint16_t Sched_stageBreak(Sched *s, uint16_t i, int32_t err, int32_t vel);
+uint16_t Sched_commit(Sched *s);
+
+void Sched_axis(SchedAxis *a, int32_t kp, int32_t kd);
+void Sched_gains(const Sched *s, SchedAxis *a, int32_t err, int32_t vel);
+
+#endif
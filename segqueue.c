@@ -0,0 +1,63 @@
+/*
+ *  segqueue.c
+ *
+ *  Single producer, single consumer segment queue, see segqueue.h.
+ */
+
+#include "segqueue.h"
+
+#define MASK (SEGQUEUE_SIZE - 1)
+
+void SegQueue_init(SegQueue *q, SegQueueFxn lowFxn, SegQueueFxn highFxn)
+{
+    q->head = 0;
+    q->tail = 0;
+    q->idle = 1;
+    q->underruns = 0;
+    q->lowFxn = lowFxn;
+    q->highFxn = highFxn;
+}
+
+/*
+ * Producer side. Returns 0 if the queue is full.
+ */
+uint16_t SegQueue_push(SegQueue *q, int32_t x, int32_t y, int32_t feed)
+{
+    uint16_t head = q->head;
+    volatile SegEntry *e = &q->entry[head];
+
+    if (SegQueue_full(q))
+        return 0;
+    e->x = x;
+    e->y = y;
+    e->feed = feed;
+    // the entry has to be complete before the consumer can see it
+    q->head = (head + 1) & MASK;
+
+    if (SegQueue_level(q) == SEGQUEUE_HIGH && q->highFxn)
+        q->highFxn();
+    return 1;
+}
+
+/*
+ * Consumer side. Returns 0 if the queue is empty.
+ */
+uint16_t SegQueue_pop(SegQueue *q, SegEntry *e)
+{
+    uint16_t tail = q->tail;
+    uint16_t got = 0;
+
+    if (tail != q->head) {
+        e->x = q->entry[tail].x;
+        e->y = q->entry[tail].y;
+        e->feed = q->entry[tail].feed;
+        q->tail = (tail + 1) & MASK;
+        got = 1;
+    } else if (!q->idle) {
+        q->underruns += 1;
+    }
+
+    if (got && SegQueue_level(q) == SEGQUEUE_LOW && q->lowFxn)
+        q->lowFxn();
+    return got;
+}
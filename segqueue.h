@@ -0,0 +1,57 @@
+/*
+ *  segqueue.h
+ *
+ *  Segment queue between the path sources and the stepper.
+ *
+ *  The path feed task decodes the stored plot or parses the G-code stream
+ *  and pushes the end point of every segment here, the stepper Swi pops
+ *  one a tick into the planner. There is exactly one producer and one
+ *  consumer, head is only written by the producer and tail only by the
+ *  consumer, so neither side needs to lock.
+ *
+ *  lowFxn is called by the consumer on the pop that takes the queue down
+ *  to the low mark, and highFxn by the producer on the push that fills it
+ *  to the high mark, so a producer can fill up to the high mark and then
+ *  sleep until the queue drains to the low one. A producer that stops
+ *  short because its source ran dry has to be woken by the source.
+ *  Either may be NULL.
+ */
+
+#ifndef SEGQUEUE_H
+#define SEGQUEUE_H
+
+#include <stdint.h>
+
+// must be a power of 2, each entry is 6 words
+#define SEGQUEUE_SIZE 32
+#define SEGQUEUE_LOW  8
+#define SEGQUEUE_HIGH 24
+
+typedef void (*SegQueueFxn)(void);
+
+typedef struct {
+    int32_t x;          // segment end point, Q16 degrees
+    int32_t y;
+    int32_t feed;       // path feedrate, Q16 degrees per second
+} SegEntry;
+
+typedef struct {
+    volatile SegEntry entry[SEGQUEUE_SIZE];
+    volatile uint16_t head;     // next entry to fill, producer only
+    volatile uint16_t tail;     // next entry to pop, consumer only
+    volatile uint16_t idle;     // producer has nothing more to send, producer only
+    uint16_t underruns;         // pops that found it empty while not idle
+    SegQueueFxn lowFxn;
+    SegQueueFxn highFxn;
+} SegQueue;
+
+void SegQueue_init(SegQueue *q, SegQueueFxn lowFxn, SegQueueFxn highFxn);
+uint16_t SegQueue_push(SegQueue *q, int32_t x, int32_t y, int32_t feed);
+uint16_t SegQueue_pop(SegQueue *q, SegEntry *e);
+
+#define SegQueue_level(q) ((uint16_t)((q)->head - (q)->tail) & (SEGQUEUE_SIZE - 1))
+#define SegQueue_full(q) (SegQueue_level(q) == SEGQUEUE_SIZE - 1)
+#define SegQueue_empty(q) ((q)->head == (q)->tail)
+#define SegQueue_setIdle(q, i) ((q)->idle = (i))
+
+#endif
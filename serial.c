@@ -0,0 +1,94 @@
+/*
+ *  serial.c
+ *
+ *  SCI-A receive buffer with XON/XOFF flow control.
+ *
+ *  The ISR is the only writer of rxHead and Serial_getc the only writer of
+ *  rxTail, so the ring itself needs no locking.
+ */
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include "serial.h"
+#include "Library/DSP2802x_Device.h"
+
+#define RX_MASK (SERIAL_RX_SIZE - 1)
+
+static volatile uint16_t rxBuf[SERIAL_RX_SIZE];
+static volatile uint16_t rxHead = 0;
+static volatile uint16_t rxTail = 0;
+
+// XOFF has been sent, and a flow control character waiting for TXRDY
+static volatile uint16_t paused = 0;
+static volatile uint16_t txPending = 0;
+
+// characters dropped because the ring or the SCI overflowed
+uint16_t serialOverruns = 0;
+
+static void sendFlow(uint16_t c)
+{
+    if (SciaRegs.SCICTL2.bit.TXRDY) {
+        SciaRegs.SCITXBUF = c;
+        txPending = 0;
+    } else {
+        txPending = c;
+    }
+}
+
+Void sciRxISR(Void)
+{
+    uint16_t next;
+
+    if (SciaRegs.SCIRXST.bit.RXERROR) {
+        // overrun or framing error, only a software reset clears it
+        SciaRegs.SCICTL1.bit.SWRESET = 0;
+        SciaRegs.SCICTL1.bit.SWRESET = 1;
+        serialOverruns += 1;
+        return;
+    }
+
+    next = (rxHead + 1) & RX_MASK;
+    if (next != rxTail) {
+        rxBuf[rxHead] = SciaRegs.SCIRXBUF.all & 0xFF;
+        rxHead = next;
+    } else {
+        next = SciaRegs.SCIRXBUF.all;
+        serialOverruns += 1;
+    }
+
+    if (!paused && ((rxHead - rxTail) & RX_MASK) >= SERIAL_RX_HIGH) {
+        paused = 1;
+        sendFlow(XOFF);
+    } else if (txPending) {
+        sendFlow(txPending);
+    }
+}
+
+uint16_t Serial_available(void)
+{
+    return (rxHead - rxTail) & RX_MASK;
+}
+
+// next received character, or -1 if there is none
+int16_t Serial_getc(void)
+{
+    int16_t c;
+    UInt key;
+
+    if (rxTail == rxHead)
+        c = -1;
+    else {
+        c = rxBuf[rxTail];
+        rxTail = (rxTail + 1) & RX_MASK;
+    }
+
+    key = Hwi_disable();
+    if (paused && Serial_available() <= SERIAL_RX_LOW) {
+        paused = 0;
+        sendFlow(XON);
+    } else if (txPending) {
+        sendFlow(txPending);
+    }
+    Hwi_restore(key);
+    return c;
+}
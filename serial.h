@@ -0,0 +1,31 @@
+/*
+ *  serial.h
+ *
+ *  SCI-A receive buffer with XON/XOFF flow control.
+ *
+ *  sciRxISR drops every received character into a ring buffer. Once the
+ *  buffer passes SERIAL_RX_HIGH an XOFF is sent to hold off the host, and
+ *  an XON once Serial_getc has drained it below SERIAL_RX_LOW. The host
+ *  can therefore stream a whole file with software flow control and the
+ *  buffer stays topped up, so the planner never waits on the link.
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+// must be a power of 2
+#define SERIAL_RX_SIZE 64
+#define SERIAL_RX_HIGH 40   // leaves room for what is still on the wire
+#define SERIAL_RX_LOW  16
+
+#define XON  0x11
+#define XOFF 0x13
+
+int16_t Serial_getc(void);
+uint16_t Serial_available(void);
+
+extern uint16_t serialOverruns;
+
+#endif
@@ -0,0 +1,12 @@
+// this is generated by tools/lqrgen
+// state space gains for the axes, see statespace.h
+// kv 1.92, ka 0.0555
+const int32_t xSsG[6] = { 1073741824L, 4930041L, 228473L, 0L, 903189047L, 88829571L };
+const int32_t xSsM[2] = { 25710097L, 1188025027L };
+const int32_t xSsK[3] = { 1483992545L, 35937492L, 3180123L };
+const SsModel xSsModel = { { 2, 3, 30, xSsG }, { 2, 1, 26, xSsM }, { 1, 3, 23, xSsK } };
+// kv 1.92, ka 0.0555
+const int32_t ySsG[6] = { 1073741824L, 4930041L, 228473L, 0L, 903189047L, 88829571L };
+const int32_t ySsM[2] = { 25710097L, 1188025027L };
+const int32_t ySsK[3] = { 1483992545L, 35937492L, 3180123L };
+const SsModel ySsModel = { { 2, 3, 30, ySsG }, { 2, 1, 26, ySsM }, { 1, 3, 23, ySsK } };
@@ -0,0 +1,80 @@
+/*
+ *  statespace.c
+ *
+ *  State space control law, see statespace.h.
+ */
+
+#include "statespace.h"
+#include "control.h"
+#include "qmath.h"
+
+/*
+ * y = a x. Each row is accumulated in 64 bits and rounded back to the
+ * format of x once.
+ */
+void SS_mulvec(const SsMatrix *a, const int32_t *x, int32_t *y)
+{
+    const int32_t *m = a->m;
+    uint16_t i, j;
+
+    for (i = 0; i < a->rows; i++) {
+        int64_t acc = (int64_t)1 << (a->q - 1);
+        for (j = 0; j < a->cols; j++)
+            acc += (int64_t)*m++ * x[j];
+        y[i] = (int32_t)(acc >> a->q);
+    }
+}
+
+// start the estimate at rest at pos, Q16 degrees
+void SS_init(StateSpace *s, const SsModel *model, int32_t pos, int32_t kv, int32_t ka)
+{
+    s->model = model;
+    s->x[0] = pos;
+    s->x[1] = 0;
+    s->x[2] = 0;
+    s->ffPrev = 0;
+    s->kv = kv;
+    s->ka = ka;
+}
+
+/*
+ * DAC output for the axis measured at pos, following posRef and velRef in
+ * Q16 and accRef in Q8. take is set on the ticks whose output the DAC
+ * takes at the next timer tick, on the others the estimate is only moved
+ * on and the output the DAC has is returned.
+ */
+int32_t SS_output(StateSpace *s, int32_t pos, int32_t posRef, int32_t velRef, int32_t accRef,
+                  uint16_t take)
+{
+    const SsModel *model = s->model;
+    int32_t innov = pos - s->x[0];
+    int32_t corr[2], err[3], next[2], u = 0, ff = 0;
+
+    SS_mulvec(&model->m, &innov, corr);
+    s->x[0] += corr[0];
+    s->x[1] += corr[1];
+
+    if (take) {
+        ff = QMPY(velRef, s->kv, 16) + QMPY(accRef, s->ka, 8);
+        err[0] = s->x[0] - posRef;
+        err[1] = s->x[1] - velRef;
+        err[2] = s->x[2] - s->ffPrev;
+        SS_mulvec(&model->k, err, &u);
+        u = ff - u;
+        if (u > (int32_t)(DAC_MAX - DAC_MID) << 16)
+            u = (int32_t)(DAC_MAX - DAC_MID) << 16;
+        else if (u < -((int32_t)DAC_MID << 16))
+            u = -((int32_t)DAC_MID << 16);
+    }
+
+    // the motor runs on what the DAC holds until the next timer tick, and
+    // from then on the new output if it takes it
+    SS_mulvec(&model->g, s->x, next);
+    s->x[0] = next[0];
+    s->x[1] = next[1];
+    if (take) {
+        s->x[2] = u;
+        s->ffPrev = ff;
+    }
+    return DAC_MID + ((s->x[2] + 0x8000L) >> 16);
+}
@@ -0,0 +1,64 @@
+/*
+ *  statespace.h
+ *
+ *  State space control law for the Piccollo2AMC project.
+ *
+ *  Each axis is modelled as the motor and gearbox, position and velocity
+ *  driven through back EMF and inertia by what the DAC holds over the
+ *  coming tick:
+ *
+ *      x = [ pos, vel ]    Q16 degrees, Q16 deg/s
+ *      x' = Ad x + Bd dac
+ *
+ *  The timer writes the two axes' DACs in turn, so each takes an output
+ *  every other tick, a tick after it was worked out, and holds it for
+ *  two. A current estimator corrects the predicted state with the encoder
+ *  every tick. On the ticks whose output the DAC takes next the output is
+ *  the feedforward less LQR state feedback on the estimate, with the DAC
+ *  value it has to wait behind as a third state:
+ *
+ *      xe = x + M (pos measured - pos)
+ *      u = ff - K [ pos - posRef, vel - velRef, dac - ffPrev ]
+ *
+ *  Ad, Bd and M are for the control tick, K for the two tick period of the
+ *  DAC with the held value acting over the first tick of it and u over
+ *  the second. They come from tools/lqrgen, which discretises the model,
+ *  solves the LQR and estimator Riccati equations and writes them out in
+ *  the Q formats that fit them, see ss_gains.h. Each is applied with
+ *  SS_mulvec, so one tick costs at most a fixed 11 multiply accumulates.
+ *
+ *  The state and output vectors are all Q16.
+ */
+
+#ifndef STATESPACE_H
+#define STATESPACE_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint16_t rows;
+    uint16_t cols;
+    uint16_t q;             // fraction bits of the entries
+    const int32_t *m;       // row major
+} SsMatrix;
+
+typedef struct {
+    SsMatrix g;             // [ Ad | Bd ], 2 x 3
+    SsMatrix m;             // estimator correction, 2 x 1
+    SsMatrix k;             // state feedback, 1 x 3
+} SsModel;
+
+typedef struct {
+    const SsModel *model;
+    int32_t x[3];           // estimate, then what the DAC holds over the tick
+    int32_t ffPrev;         // feedforward that went with it, Q16 counts
+    int32_t kv;             // feedforward, Q16 counts per deg/s
+    int32_t ka;             // Q16 counts per deg/s^2
+} StateSpace;
+
+void SS_mulvec(const SsMatrix *a, const int32_t *x, int32_t *y);
+void SS_init(StateSpace *s, const SsModel *model, int32_t pos, int32_t kv, int32_t ka);
+int32_t SS_output(StateSpace *s, int32_t pos, int32_t posRef, int32_t velRef, int32_t accRef,
+                  uint16_t take);
+
+#endif
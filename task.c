@@ -49,12 +49,59 @@
 #define xdc__strict
 #include <xdc/std.h>
 #include <xdc/runtime/Log.h>
+#if defined(__P2AMC_MODE_DEBUG) || defined(__P2AMC_MODE_PREDICT)
+#include <xdc/runtime/Timestamp.h>
+#endif
 #include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/knl/Task.h>
 #include <ti/sysbios/knl/Semaphore.h>
 #include <ti/sysbios/knl/Swi.h>
 #include "Library/Devinit.h"
 #include "plot_sidewind.h"
+#include "trajectory.h"
+#include "planner.h"
+#include "gcode.h"
+#include "path.h"
+#include "segqueue.h"
+#include "kinematics.h"
+#include "control.h"
+#include "autotune.h"
+#ifdef __P2AMC_MODE_FRICTION
+#include "friction.h"
+#endif
+#ifdef __P2AMC_MODE_FILTER
+#include "filter.h"
+#endif
+#ifdef __P2AMC_MODE_ILC
+#include "ilc.h"
+#endif
+#ifdef __P2AMC_MODE_STATESPACE
+#include "statespace.h"
+#include "ss_gains.h"
+#endif
+#ifdef __P2AMC_MODE_MRAC
+#include "mrac.h"
+#endif
+#ifdef __P2AMC_MODE_SCHED
+#include "sched.h"
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+#include "predict.h"
+#endif
+#ifdef __P2AMC_MODE_BACKLASH
+#include "backlash.h"
+#endif
+#ifdef __P2AMC_MODE_COGGING
+#include "cogging.h"
+#endif
+#ifdef __P2AMC_MODE_CASCADE
+#include <ti/sysbios/hal/Timer.h>
+#include "cascade.h"
+#endif
+#ifdef __P2AMC_MODE_BENCH
+#include "bench.h"
+#endif
+#include "serial.h"
 #include "Library/DSP2802x_Device.h"
 
 
@@ -64,8 +111,13 @@
 
 extern const Semaphore_Handle xDataAvailable;
 extern const Semaphore_Handle yDataAvailable;
+extern const Semaphore_Handle pathSpace;
 extern const Swi_Handle xVelProcSwi;
 extern const Swi_Handle yVelProcSwi;
+extern const Swi_Handle StepNextPointSwi;
+#ifdef __P2AMC_MODE_CASCADE
+extern const Timer_Handle triggerADC;
+#endif
 
 // Updated by encoderISR triggers at any time on rising and falling edge
 // Highest priority
@@ -86,17 +138,101 @@ static volatile int32_t yVel = 0;
 
 #define ENCODERCALIB 90 // 360/2048 ticks per rotation represented in q9
 #define ENCODERCALIB_Q 9
-#define TACHOCALIB 714 // = .6975 Q9
-#define TACHOCALIB_Q 9 // = .6975 Q9
 #define VOLTAGECALIB_Q
 #define VOLTAGEOFFSET_Q
 
 static volatile int32_t voltage[2] = {2048, 2048};
+#if defined(__P2AMC_MODE_STATESPACE) || defined(__P2AMC_MODE_FILTER)
+// axis timerISR last wrote, the other one's output is taken next
+static volatile uint16_t dacWritten = Y_OUTPUT;
+#endif
 
 // Updated whenever the draw task needs to
 static volatile int32_t xPosRef = 0;
 static volatile int32_t yPosRef = 0;
+// reference velocity in Q16 deg/s and acceleration in Q8 deg/s^2 that go
+// with it, for the feedforward
+static volatile int32_t xVelRef = 0;
+static volatile int32_t yVelRef = 0;
+static volatile int32_t xAccRef = 0;
+static volatile int32_t yAccRef = 0;
+// corrections added to each axis error while drawing, the backlash lead
+// and what has been learnt, Q16
+static volatile int32_t xTrim = 0;
+static volatile int32_t yTrim = 0;
 static uint16_t plotting = 1;
+// decodes the stored plots a point at a time while plotting
+static PathDecoder plot;
+// plots drawn back to back each time plotting is set
+static const uint16_t *const plotJobs[] = { sidewindPath };
+#define PLOT_JOBS (sizeof(plotJobs) / sizeof(plotJobs[0]))
+static uint16_t plotJob = 0;
+// time the current plot job will take, worked out before it is started,
+// Q16 seconds
+static volatile int32_t jobTime = 0;
+static uint16_t jobTimed = 0;
+// last point handed to the segment queue, Q16
+static int32_t feedX, feedY;
+// the path feed filled the segment queue to its high mark, or stopped
+// short with nothing to send
+static volatile uint16_t feedHigh = 0;
+static volatile uint16_t feedDry = 1;
+
+// walks xPosRef/yPosRef between plot points every control tick
+static Trajectory traj;
+// plot points waiting to be drawn, planned so corners are taken at speed
+static Planner planner;
+// G-code streamed in over SCI-A whenever the plots are not being drawn
+static Gcode gcode;
+// segment end points from the path feed task to the stepper
+static SegQueue segments;
+#ifdef __P2AMC_MODE_BACKLASH
+// gear backlash of each axis, the motors are kept leading across it
+static Backlash xLash;
+static Backlash yLash;
+#endif
+#ifdef __P2AMC_MODE_COGGING
+// torque ripple over a motor revolution of each axis, learned from the
+// calibration sweep the path feed sends first
+static Cogging xCog;
+static Cogging yCog;
+static uint16_t cogLeg = 0;
+static int32_t cogX, cogY;
+#endif
+#ifdef __P2AMC_MODE_ILC
+// learns the errors a plotting run makes to take them out of the next
+static Ilc ilc;
+#endif
+#ifdef __P2AMC_MODE_SCHED
+// PD gain scales over error and speed, loaded over the serial link
+static Sched sched;
+#endif
+#ifdef __P2AMC_MODE_CASCADE
+// position loops in the stepper, velocity loops in the ADC interrupts
+static Cascade xCas;
+static Cascade yCas;
+#endif
+#ifdef __P2AMC_MODE_FILTER
+// notch and low pass between the control law and the DAC
+static Filter xFilt;
+static Filter yFilt;
+static const FiltSpec xFiltSpec[FILTER_STAGES] = {
+    { FILT_NOTCH, FILT_Q16(X_NOTCH_HZ), FILT_Q16(X_NOTCH_DEPTH), FILT_Q16(X_NOTCH_WIDTH) },
+    { FILT_LOWPASS, FILT_Q16(X_LOWPASS_HZ), 0, 0 }
+};
+static const FiltSpec yFiltSpec[FILTER_STAGES] = {
+    { FILT_NOTCH, FILT_Q16(Y_NOTCH_HZ), FILT_Q16(Y_NOTCH_DEPTH), FILT_Q16(Y_NOTCH_WIDTH) },
+    { FILT_LOWPASS, FILT_Q16(Y_LOWPASS_HZ), 0, 0 }
+};
+#endif
+#ifdef __P2AMC_MODE_CARTESIAN
+// paths are in screen coordinates, the references are turned into axis
+// angles every tick
+static Kinematics kin;
+#endif
+static Void segmentsLow(Void);
+static Void segmentsHigh(Void);
+static uint16_t feedReady(void);
 
 // Initial values
 #define XPOSINIT -30
@@ -122,6 +258,45 @@ Int main()
     yPos = YPOSINIT;
     yPos = YPOSREFINIT;
     plotting = PLOTINIT;
+    Traj_init(&traj, xPosRef, yPosRef);
+    Planner_init(&planner, xPosRef, yPosRef);
+    Gcode_init(&gcode, xPosRef, yPosRef);
+    Path_open(&plot, plotJobs[0]);
+    SegQueue_init(&segments, segmentsLow, segmentsHigh);
+    feedX = xPosRef;
+    feedY = yPosRef;
+#ifdef __P2AMC_MODE_BACKLASH
+    Lash_init(&xLash, LASH_Q16(X_BACKLASH_WIDTH));
+    Lash_init(&yLash, LASH_Q16(Y_BACKLASH_WIDTH));
+#endif
+#ifdef __P2AMC_MODE_COGGING
+    Cog_init(&xCog);
+    Cog_init(&yCog);
+    Cog_learn(&xCog);
+    Cog_learn(&yCog);
+#endif
+#ifdef __P2AMC_MODE_SCHED
+    Sched_init(&sched);
+#endif
+#ifdef __P2AMC_MODE_ILC
+    Ilc_init(&ilc);
+#endif
+#ifdef __P2AMC_MODE_CASCADE
+    Cascade_init(&xCas, CASCADE_Q16(X_CASCADE_KPOS), CASCADE_Q16(X_CASCADE_KVEL),
+            CASCADE_KI_Q16(X_CASCADE_KI), X_KV_DAC, X_KA_DAC);
+    Cascade_init(&yCas, CASCADE_Q16(Y_CASCADE_KPOS), CASCADE_Q16(Y_CASCADE_KVEL),
+            CASCADE_KI_Q16(Y_CASCADE_KI), Y_KV_DAC, Y_KA_DAC);
+    // the timer runs the inner loops, it is not started until BIOS_start
+    Timer_setPeriodMicroSecs(triggerADC, CASCADE_INNER_US);
+#endif
+#ifdef __P2AMC_MODE_FILTER
+    // each axis's DAC takes an output every other tick
+    Filt_init(&xFilt, xFiltSpec, CONTROL_RATE_HZ / 2);
+    Filt_init(&yFilt, yFiltSpec, CONTROL_RATE_HZ / 2);
+#endif
+#ifdef __P2AMC_MODE_CARTESIAN
+    Kin_init(&kin, (int32_t)KIN_DISTANCE << 16, KIN_OPTICAL_GAIN);
+#endif
 
     BIOS_start(); /* does not return */
     return (0);
@@ -152,21 +327,114 @@ Void yEncISR(Void)
     yPos += directions[yMask];
 }
 
+#ifdef __P2AMC_MODE_PREDICT
+// cycle count of the last sample, of the sample each axis's output was
+// worked out from, and the output on each DAC, for the predictors
+static volatile uint32_t sampleStamp = 0;
+static volatile uint32_t outputStamp[2] = {0, 0};
+static volatile int32_t dacHeld[2] = {2048, 2048};
+// sample to DAC write, summed over the first PREDICT_CAL_WRITES writes
+static volatile uint32_t delaySum[2] = {0, 0};
+static volatile uint16_t delayWrites[2] = {0, 0};
+
+// delay of an axis once timed, us
+static int32_t measuredDelay(uint16_t axis){
+    Types_FreqHz f;
+
+    Timestamp_getFreq(&f);
+    return (int32_t)((uint64_t)(delaySum[axis] / PREDICT_CAL_WRITES) * 1000000 / f.lo);
+}
+#endif
+
 uint16_t timeElapsedms_5 = 0;
 Void timerISR(Void){
     // Every step, output to the encoder
     static uint16_t xOrY = X_OUTPUT;
+#ifdef __P2AMC_MODE_CASCADE
+    static uint16_t inner = 0;
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+    uint32_t now = Timestamp_get32();
+#endif
     AdcRegs.ADCSOCFRC1.all = 0x3;
     GpioDataRegs.GPATOGGLE.all = 0xC;
     xOrY ^= 1;
     SpiaRegs.SPITXBUF = voltage[xOrY];
+#if defined(__P2AMC_MODE_STATESPACE) || defined(__P2AMC_MODE_FILTER)
+    dacWritten = xOrY;
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+    dacHeld[xOrY] = voltage[xOrY];
+    if(outputStamp[xOrY] && delayWrites[xOrY] < PREDICT_CAL_WRITES){
+        delaySum[xOrY] += now - outputStamp[xOrY];
+        delayWrites[xOrY] += 1;
+    }
+    sampleStamp = now;
+#endif
+#ifdef __P2AMC_MODE_CASCADE
+    // ticks at the inner rate, the stepper keeps to the control tick
+    if(++inner < CASCADE_OUTER_DIV)
+        return;
+    inner = 0;
+#endif
     timeElapsedms_5 += 1;
+    Swi_post(StepNextPointSwi);
 
 }
+#ifdef __P2AMC_MODE_FILTER
+#ifdef __P2AMC_MODE_DEBUG
+// longest Filt_apply call seen, CPU cycles
+static volatile uint32_t filterCycles = 0;
+#endif
+
+static int32_t filterOutput(Filter *f, int32_t u){
+#ifdef __P2AMC_MODE_DEBUG
+    uint32_t cycles = Timestamp_get32();
+#endif
+    u = Filt_apply(f, u);
+#ifdef __P2AMC_MODE_DEBUG
+    cycles = Timestamp_get32() - cycles;
+    if(cycles > filterCycles)
+        filterCycles = cycles;
+#endif
+    return u;
+}
+#endif
+
 #define F_TAPS 8
 int16_t xVelRaw[F_TAPS] = {0};
 int16_t yVelRaw[F_TAPS] = {0};
 // these are moving average filters
+#ifdef __P2AMC_MODE_CASCADE
+// the velocity loops close here at the inner rate, on a running sum so the
+// interrupt does not walk the taps. The feedback tasks are left idle
+static int32_t xVelSum = 0;
+static int32_t yVelSum = 0;
+
+Void xVelISR (Void){
+    static uint16_t i = 0;
+    int16_t raw;
+    AdcRegs.ADCINTFLGCLR.bit.ADCINT1 = 1;
+    raw = AdcResult.ADCRESULT0 - 2048 + XVELOFFSET;
+    xVelSum += raw - xVelRaw[i];
+    xVelRaw[i] = raw;
+    i = (i + 1) & 7;
+    xVel = Ctrl_velocity(xVelSum);
+    voltage[X_OUTPUT] = Cascade_inner(&xCas, xVel);
+}
+
+Void yVelISR(Void){
+    static uint16_t i = 0;
+    int16_t raw;
+    AdcRegs.ADCINTFLGCLR.bit.ADCINT2 = 1;
+    raw = AdcResult.ADCRESULT1 - 2048 + YVELOFFSET;
+    yVelSum += raw - yVelRaw[i];
+    yVelRaw[i] = raw;
+    i = (i + 1) & 7;
+    yVel = Ctrl_velocity(yVelSum);
+    voltage[Y_OUTPUT] = Cascade_inner(&yCas, yVel);
+}
+#else
 Void xVelISR (Void){
     static uint16_t i = 0;
     AdcRegs.ADCINTFLGCLR.bit.ADCINT1 = 1;
@@ -175,17 +443,18 @@ Void xVelISR (Void){
     xVelRaw[i] = AdcResult.ADCRESULT0 - 2048 + XVELOFFSET;
     i = (i + 1) & 7;
 }
+#endif
 
 Void xVelProcFxn(Void){
     int i;
     int32_t cVel = 0;
     for (i = 0; i < F_TAPS; i++)
         cVel += xVelRaw[i];
-    xVel = ((cVel <<11) * TACHOCALIB);
-    xVel >>= TACHOCALIB_Q;
+    xVel = Ctrl_velocity(cVel);
     Semaphore_post(xDataAvailable);
 }
 
+#ifndef __P2AMC_MODE_CASCADE
 Void yVelISR(Void){
     static uint16_t i = 0;
     AdcRegs.ADCINTFLGCLR.bit.ADCINT2 = 1;
@@ -194,14 +463,14 @@ Void yVelISR(Void){
     yVelRaw[i] = AdcResult.ADCRESULT1 - 2048 + YVELOFFSET;
     i = (i + 1) & 7;
 }
+#endif
 
 Void yVelProcFxn(Void){
     int i;
     int32_t cVel = 0;
     for (i = 0; i < F_TAPS; i++)
         cVel += yVelRaw[i];
-    yVel = ((cVel <<11) * TACHOCALIB);
-    yVel >>= TACHOCALIB_Q;
+    yVel = Ctrl_velocity(cVel);
     Semaphore_post(yDataAvailable);
 }
 /*
@@ -209,55 +478,604 @@ Void yVelProcFxn(Void){
  * Process the implemented PID control loop SWI
  * triggers once every 0.001s
  */
-#define X_KD 123 // 0.00188 in q16
-#define X_KP 77 // 0.15 in q9
+// set TUNE_X and/or TUNE_Y from the debugger to relay tune an axis, with
+// the plotter idle. The new gains go live when the run is done, the
+// results stay in xTune/yTune for inspection
+#define TUNE_X 1
+#define TUNE_Y 2
+static volatile uint16_t tuneRequest = 0;
+static volatile uint16_t tuneRule = TUNE_ZN_PD;
+static AutoTune xTune;
+static AutoTune yTune;
+#ifdef __P2AMC_MODE_BACKLASH
+// set LASH_X and/or LASH_Y from the debugger to measure an axis's gear
+// backlash again, with the plotter idle. Both are measured at start up
+#define LASH_X 1
+#define LASH_Y 2
+static volatile uint16_t lashRequest = LASH_X | LASH_Y;
+static LashId xLashId;
+static LashId yLashId;
+#endif
+
+#ifdef __P2AMC_MODE_DEBUG
+// set frictionLogging to X_OUTPUT + 1 or Y_OUTPUT + 1 to record that axis's
+// output, counts from mid scale, and velocity, deg/s in Q4, every tick
+// until the log is full. Save it from the debugger for tools/frictionid
+#define FRICTION_LOG 128
+static int16_t frictionLog[FRICTION_LOG][2];
+static volatile uint16_t frictionLogging = 0;
+static uint16_t frictionLogged = 0;
+
+static void logFriction(uint16_t axis, int32_t out, int32_t vel){
+    if(frictionLogging != axis + 1)
+        return;
+    frictionLog[frictionLogged][0] = (int16_t)(out - DAC_MID);
+    frictionLog[frictionLogged][1] = (int16_t)(vel >> 12);
+    if(++frictionLogged == FRICTION_LOG){
+        frictionLogged = 0;
+        frictionLogging = 0;
+    }
+}
+#endif
+
+static CtrlGains xGains;
+#ifdef __P2AMC_MODE_SCHED
+static SchedAxis xSched;
+#endif
+#ifdef __P2AMC_MODE_FRICTION
+// breaks the axes free of stiction and takes up load, PD law only
+static Friction xFric;
+#endif
+#ifdef __P2AMC_MODE_STATESPACE
+static StateSpace xSs;
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+static Predictor xPred;
+#endif
+#ifdef __P2AMC_MODE_MRAC
+static Mrac xMrac;
+// what the adaptation is doing, for the debugger or a telemetry link.
+// Set xMrac.frozen to hold the estimates
+static volatile MracTelemetry xMracTelemetry;
+#endif
 
 Void xFeedbackControlFxn(Void)
 {
-    int32_t cerr;
+    Ctrl_setGains(&xGains, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+#ifdef __P2AMC_MODE_SCHED
+    Sched_axis(&xSched, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+#endif
+    Ctrl_setFeedforward(&xGains, X_KV_DAC, X_KA_DAC);
+#ifdef __P2AMC_MODE_FRICTION
+    Fric_init(&xFric, X_FRICTION_COULOMB, X_FRICTION_VISCOUS, X_KV_DAC, X_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_STATESPACE
+    SS_init(&xSs, &xSsModel, xPos, X_KV_DAC, X_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_MRAC
+    Mrac_init(&xMrac, xPos, X_KV_DAC, X_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+    Pred_init(&xPred, X_KV_DAC, X_KA_DAC);
+#endif
     while (1)
     {
+#ifdef __P2AMC_MODE_PREDICT
+        // state and reference as they will be when the output reaches the DAC
+        uint32_t stamp;
+        int32_t pos, vel, posRef, velRef;
+#endif
         Semaphore_pend(xDataAvailable, BIOS_WAIT_FOREVER);
-        cerr = xPosRef - xPos;
-        cerr = ((cerr * X_KP)>>9) - ((X_KD * xVel)>>16);
-        cerr = (cerr * 256); // fix output scale
-        cerr = (cerr >> 16) + 2048; // fix output offset
-        voltage[X_OUTPUT] = cerr;//(err >> Q_VALUE);
+#ifdef __P2AMC_MODE_PREDICT
+        stamp = sampleStamp;
+        if(!Pred_ready(&xPred) && delayWrites[X_OUTPUT] == PREDICT_CAL_WRITES){
+            Pred_setDelay(&xPred, measuredDelay(X_OUTPUT));
+            Ctrl_setGains(&xGains, CTRL_Q16(X_PRED_KP_COUNTS), CTRL_Q16(X_PRED_KD_COUNTS));
+        }
+        Pred_step(&xPred, xPos, xVel, dacHeld[X_OUTPUT], &pos, &vel);
+        posRef = xPosRef;
+        velRef = xVelRef;
+        if(Pred_ready(&xPred))
+            Pred_reference(&xPred, &posRef, &velRef, xAccRef);
+#endif
+        // under prediction a tune waits for the delay, or the gains the
+        // calibration sets would overwrite it
+        if((tuneRequest & TUNE_X) && !plotting && !Traj_busy(&traj)
+#ifdef __P2AMC_MODE_PREDICT
+                && Pred_ready(&xPred)
+#endif
+                ){
+            tuneRequest &= ~TUNE_X;
+            Tune_start(&xTune, xPosRef, tuneRule);
+        }
+#ifdef __P2AMC_MODE_BACKLASH
+        if((lashRequest & LASH_X) && !plotting && !Traj_busy(&traj) && !Tune_running(&xTune)){
+            lashRequest &= ~LASH_X;
+            Lash_idStart(&xLashId, xPos);
+        }
+        if(Lash_idRunning(&xLashId)){
+            voltage[X_OUTPUT] = Lash_idStep(&xLashId, xPos, xVel);
+            if(xLashId.state == LASH_DONE)
+                Lash_setWidth(&xLash, xLashId.width);
+        }else
+#endif
+        if(Tune_running(&xTune)){
+            voltage[X_OUTPUT] = Tune_step(&xTune, xPos);
+#ifdef __P2AMC_MODE_PREDICT
+            // the relay tunes the plain loop, scaled up for the predicted one
+            if(xTune.state == TUNE_DONE && !Ctrl_setGains(&xGains,
+                    (int32_t)((int64_t)xTune.kp * CTRL_Q16(X_PRED_KP_SCALE) >> 16),
+                    (int32_t)((int64_t)xTune.kd * CTRL_Q16(X_PRED_KD_SCALE) >> 16)))
+                xTune.state = TUNE_FAILED;
+#else
+            if(xTune.state == TUNE_DONE && !Ctrl_setGains(&xGains, xTune.kp, xTune.kd))
+                xTune.state = TUNE_FAILED;
+#endif
+#ifdef __P2AMC_MODE_SCHED
+            if(xTune.state == TUNE_DONE)
+                Sched_axis(&xSched, xTune.kp, xTune.kd);
+#endif
+        }else{
+            int32_t out;
+#ifdef __P2AMC_MODE_STATESPACE
+            out = SS_output(&xSs, xPos, xPosRef + xTrim, xVelRef, xAccRef,
+                    dacWritten != X_OUTPUT);
+#elif defined(__P2AMC_MODE_MRAC)
+            out = Mrac_output(&xMrac, xPos, xVel, xPosRef + xTrim, xVelRef, xAccRef);
+            Mrac_snapshot(&xMrac, xPos, &xMracTelemetry);
+#elif defined(__P2AMC_MODE_PREDICT)
+            int32_t err = posRef - pos + xTrim;
+            out = Ctrl_output(&xGains, err, vel, velRef, xAccRef);
+#ifdef __P2AMC_MODE_FRICTION
+            out = Fric_compensate(&xFric, out, err, vel, velRef);
+#endif
+#else
+            int32_t err = xPosRef - xPos + xTrim;
+#ifdef __P2AMC_MODE_SCHED
+            Sched_gains(&sched, &xSched, err, xVel);
+            Ctrl_setGains(&xGains, xSched.kpNow, xSched.kdNow);
+#endif
+            out = Ctrl_output(&xGains, err, xVel, xVelRef, xAccRef);
+#ifdef __P2AMC_MODE_FRICTION
+            out = Fric_compensate(&xFric, out, err, xVel, xVelRef);
+#endif
+#endif
+#ifdef __P2AMC_MODE_COGGING
+            out = Cog_compensate(&xCog, xPos, xVelRef, xAccRef, out);
+#endif
+#ifdef __P2AMC_MODE_FILTER
+            // at the DAC rate, on the outputs that are written
+            out = dacWritten != X_OUTPUT ? filterOutput(&xFilt, out) : voltage[X_OUTPUT];
+#endif
+            voltage[X_OUTPUT] = out;
+        }
+#ifdef __P2AMC_MODE_PREDICT
+        outputStamp[X_OUTPUT] = stamp;
+#endif
+#ifdef __P2AMC_MODE_DEBUG
+        logFriction(X_OUTPUT, voltage[X_OUTPUT], xVel);
+#endif
     }
 }
 
-#define Y_KD 223 // 0.003412 in q16
-#define Y_KP 76 // 0.148 in q9
+static CtrlGains yGains;
+#ifdef __P2AMC_MODE_SCHED
+static SchedAxis ySched;
+#endif
+#ifdef __P2AMC_MODE_FRICTION
+static Friction yFric;
+#endif
+#ifdef __P2AMC_MODE_STATESPACE
+static StateSpace ySs;
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+static Predictor yPred;
+#endif
+#ifdef __P2AMC_MODE_MRAC
+static Mrac yMrac;
+static volatile MracTelemetry yMracTelemetry;
+#endif
 
 Void yFeedbackControlFxn(Void)
 {
-    int32_t cerr;
+    Ctrl_setGains(&yGains, CTRL_Q16(Y_KP_COUNTS), CTRL_Q16(Y_KD_COUNTS));
+#ifdef __P2AMC_MODE_SCHED
+    Sched_axis(&ySched, CTRL_Q16(Y_KP_COUNTS), CTRL_Q16(Y_KD_COUNTS));
+#endif
+    Ctrl_setFeedforward(&yGains, Y_KV_DAC, Y_KA_DAC);
+#ifdef __P2AMC_MODE_FRICTION
+    Fric_init(&yFric, Y_FRICTION_COULOMB, Y_FRICTION_VISCOUS, Y_KV_DAC, Y_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_STATESPACE
+    SS_init(&ySs, &ySsModel, yPos, Y_KV_DAC, Y_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_MRAC
+    Mrac_init(&yMrac, yPos, Y_KV_DAC, Y_KA_DAC);
+#endif
+#ifdef __P2AMC_MODE_PREDICT
+    Pred_init(&yPred, Y_KV_DAC, Y_KA_DAC);
+#endif
     while (1)
     {
+#ifdef __P2AMC_MODE_PREDICT
+        // state and reference as they will be when the output reaches the DAC
+        uint32_t stamp;
+        int32_t pos, vel, posRef, velRef;
+#endif
         Semaphore_pend(yDataAvailable, BIOS_WAIT_FOREVER);
-        cerr = yPosRef - yPos;
-        cerr = ((cerr * Y_KP)>>9) - ((Y_KD * xVel)>>16);
-        cerr = (cerr * 256); // fix output scale
-        cerr = (cerr >> 16) + 2048; // fix output offset
-        voltage[Y_OUTPUT] = cerr;//(err >> Q_VALUE);
-
+#ifdef __P2AMC_MODE_PREDICT
+        stamp = sampleStamp;
+        if(!Pred_ready(&yPred) && delayWrites[Y_OUTPUT] == PREDICT_CAL_WRITES){
+            Pred_setDelay(&yPred, measuredDelay(Y_OUTPUT));
+            Ctrl_setGains(&yGains, CTRL_Q16(Y_PRED_KP_COUNTS), CTRL_Q16(Y_PRED_KD_COUNTS));
+        }
+        Pred_step(&yPred, yPos, yVel, dacHeld[Y_OUTPUT], &pos, &vel);
+        posRef = yPosRef;
+        velRef = yVelRef;
+        if(Pred_ready(&yPred))
+            Pred_reference(&yPred, &posRef, &velRef, yAccRef);
+#endif
+        if((tuneRequest & TUNE_Y) && !plotting && !Traj_busy(&traj)
+#ifdef __P2AMC_MODE_PREDICT
+                && Pred_ready(&yPred)
+#endif
+                ){
+            tuneRequest &= ~TUNE_Y;
+            Tune_start(&yTune, yPosRef, tuneRule);
+        }
+#ifdef __P2AMC_MODE_BACKLASH
+        if((lashRequest & LASH_Y) && !plotting && !Traj_busy(&traj) && !Tune_running(&yTune)){
+            lashRequest &= ~LASH_Y;
+            Lash_idStart(&yLashId, yPos);
+        }
+        if(Lash_idRunning(&yLashId)){
+            voltage[Y_OUTPUT] = Lash_idStep(&yLashId, yPos, yVel);
+            if(yLashId.state == LASH_DONE)
+                Lash_setWidth(&yLash, yLashId.width);
+        }else
+#endif
+        if(Tune_running(&yTune)){
+            voltage[Y_OUTPUT] = Tune_step(&yTune, yPos);
+#ifdef __P2AMC_MODE_PREDICT
+            // the relay tunes the plain loop, scaled up for the predicted one
+            if(yTune.state == TUNE_DONE && !Ctrl_setGains(&yGains,
+                    (int32_t)((int64_t)yTune.kp * CTRL_Q16(Y_PRED_KP_SCALE) >> 16),
+                    (int32_t)((int64_t)yTune.kd * CTRL_Q16(Y_PRED_KD_SCALE) >> 16)))
+                yTune.state = TUNE_FAILED;
+#else
+            if(yTune.state == TUNE_DONE && !Ctrl_setGains(&yGains, yTune.kp, yTune.kd))
+                yTune.state = TUNE_FAILED;
+#endif
+#ifdef __P2AMC_MODE_SCHED
+            if(yTune.state == TUNE_DONE)
+                Sched_axis(&ySched, yTune.kp, yTune.kd);
+#endif
+        }else{
+            int32_t out;
+#ifdef __P2AMC_MODE_STATESPACE
+            out = SS_output(&ySs, yPos, yPosRef + yTrim, yVelRef, yAccRef,
+                    dacWritten != Y_OUTPUT);
+#elif defined(__P2AMC_MODE_MRAC)
+            out = Mrac_output(&yMrac, yPos, yVel, yPosRef + yTrim, yVelRef, yAccRef);
+            Mrac_snapshot(&yMrac, yPos, &yMracTelemetry);
+#elif defined(__P2AMC_MODE_PREDICT)
+            int32_t err = posRef - pos + yTrim;
+            out = Ctrl_output(&yGains, err, vel, velRef, yAccRef);
+#ifdef __P2AMC_MODE_FRICTION
+            out = Fric_compensate(&yFric, out, err, vel, velRef);
+#endif
+#else
+            int32_t err = yPosRef - yPos + yTrim;
+#ifdef __P2AMC_MODE_SCHED
+            Sched_gains(&sched, &ySched, err, yVel);
+            Ctrl_setGains(&yGains, ySched.kpNow, ySched.kdNow);
+#endif
+            out = Ctrl_output(&yGains, err, yVel, yVelRef, yAccRef);
+#ifdef __P2AMC_MODE_FRICTION
+            out = Fric_compensate(&yFric, out, err, yVel, yVelRef);
+#endif
+#endif
+#ifdef __P2AMC_MODE_COGGING
+            out = Cog_compensate(&yCog, yPos, yVelRef, yAccRef, out);
+#endif
+#ifdef __P2AMC_MODE_FILTER
+            out = dacWritten != Y_OUTPUT ? filterOutput(&yFilt, out) : voltage[Y_OUTPUT];
+#endif
+            voltage[Y_OUTPUT] = out;
+        }
+#ifdef __P2AMC_MODE_PREDICT
+        outputStamp[Y_OUTPUT] = stamp;
+#endif
+#ifdef __P2AMC_MODE_DEBUG
+        logFriction(Y_OUTPUT, voltage[Y_OUTPUT], yVel);
+#endif
     }
 }
 
 #ifdef __P2AMC_MODE_DEBUG
 static volatile uint32_t idleTicks = 0;
+#ifdef __P2AMC_MODE_CARTESIAN
+// longest Kin_toAxes call seen, CPU cycles
+static volatile uint32_t kinCycles = 0;
+#endif
 #endif
 
 
-// triggers once every .10 seconds, steps voltage reference to the next position
+// posted by timerISR every control tick, walks the position reference
+// through the planned segments and queues the next one from the path feed
 Void StepNextPointTriggerFxn(Void){
 
-    static uint16_t currentstep = 0;
-    if(plotting){
-        xPosRef = xPlots[currentstep] << 16;
-        yPosRef = yPlots[currentstep] << 16;
-        currentstep += 1;
-        plotting = currentstep < NVALS ? 1 : 0;
+    TrajSegment seg;
+    SegEntry e;
+    uint16_t moving = Traj_busy(&traj);
+    int32_t cx = 0, cy = 0;
+    // shift the motors lead the reference by, Q16
+    int32_t bx = 0, by = 0;
+#ifdef __P2AMC_MODE_ILC
+    int32_t lx, ly;
+#endif
+#ifdef __P2AMC_MODE_CARTESIAN
+    int32_t x, y;
+#endif
+
+    // chain straight on to the next segment, but when starting from rest
+    // give the look ahead window a chance to fill first
+    Traj_step(&traj);
+    if(!Traj_busy(&traj) && (Planner_full(&planner) || traj.vEnd
+            || (SegQueue_empty(&segments) && segments.idle))
+            && Planner_next(&planner, &seg)){
+        Traj_start(&traj, &seg);
+        moving = 1;
+    }
+    if(moving){
+#ifdef __P2AMC_MODE_CARTESIAN
+#ifdef __P2AMC_MODE_DEBUG
+        uint32_t cycles = Timestamp_get32();
+#endif
+        Kin_toAxes(&kin, traj.x.pos, traj.y.pos, &x, &y);
+        // the trajectory rates are in the plane, difference the axis
+        // angles instead
+        x -= xPosRef;
+        y -= yPosRef;
+        xAccRef = (x * CONTROL_RATE_HZ - xVelRef) * CONTROL_RATE_HZ >> 8;
+        yAccRef = (y * CONTROL_RATE_HZ - yVelRef) * CONTROL_RATE_HZ >> 8;
+        xVelRef = x * CONTROL_RATE_HZ;
+        yVelRef = y * CONTROL_RATE_HZ;
+        xPosRef += x;
+        yPosRef += y;
+#ifdef __P2AMC_MODE_DEBUG
+        cycles = Timestamp_get32() - cycles;
+        if(cycles > kinCycles)
+            kinCycles = cycles;
+#endif
+#else
+        xPosRef = traj.x.pos;
+        yPosRef = traj.y.pos;
+        xVelRef = traj.x.vel;
+        yVelRef = traj.y.vel;
+        xAccRef = traj.x.acc;
+        yAccRef = traj.y.acc;
+#endif
+    }else{
+        // at rest, the feedback holds the point on its own
+        xVelRef = 0;
+        yVelRef = 0;
+        xAccRef = 0;
+        yAccRef = 0;
+    }
+
+#ifdef __P2AMC_MODE_BACKLASH
+    // the motors lead across the gear backlash, the learning sees the
+    // error of the loads trailing them
+    bx = Lash_offset(&xLash, xVelRef, xAccRef);
+    by = Lash_offset(&yLash, yVelRef, yAccRef);
+#endif
+
+#ifdef __P2AMC_MODE_ILC
+    // a run lasts from setting plotting until it is all drawn and at rest
+    if(moving && plotting && ilc.state == ILC_READY)
+        Ilc_begin(&ilc);
+    if(Ilc_running(&ilc)){
+        if(moving || plotting || !Planner_empty(&planner)){
+            Ilc_step(&ilc, xPosRef + bx - xPos, yPosRef + by - yPos, &lx, &ly);
+            cx += lx;
+            cy += ly;
+        }else{
+            // the path feed filters the corrections for the next run
+            Ilc_end(&ilc);
+            Semaphore_post(pathSpace);
+        }
+    }
+#endif
+    cx += bx;
+    cy += by;
+    xTrim = cx;
+    yTrim = cy;
+#ifdef __P2AMC_MODE_CASCADE
+    Cascade_outer(&xCas, xPosRef - xPos + cx, xVelRef, xAccRef);
+    Cascade_outer(&yCas, yPosRef - yPos + cy, yVelRef, yAccRef);
+#endif
+
+    // one segment per tick keeps the planning time bounded
+    if(!Planner_full(&planner) && SegQueue_pop(&segments, &e))
+        Planner_push(&planner, &traj, e.x, e.y, e.feed);
+    // a path feed that ran dry sleeps until it has something to send
+    if(feedDry && feedReady()){
+        feedDry = 0;
+        Semaphore_post(pathSpace);
+    }
+}
+
+// called from the stepper when the segment queue drains to its low mark
+static Void segmentsLow(Void){
+    Semaphore_post(pathSpace);
+}
+
+// called from the path feed when it has filled the queue to its high mark,
+// it sleeps from there until segmentsLow
+static Void segmentsHigh(Void){
+    feedHigh = 1;
+}
+
+#ifdef __P2AMC_MODE_COGGING
+// the calibration sweep waits for the tuner and the backlash measurement
+// to be done with the axes
+static uint16_t cogHeld(void){
+    return tuneRequest || Tune_running(&xTune) || Tune_running(&yTune)
+#ifdef __P2AMC_MODE_BACKLASH
+            || lashRequest || Lash_idRunning(&xLashId) || Lash_idRunning(&yLashId)
+#endif
+            ;
+}
+#endif
+
+// whether nextSegment would have something now, a character has come in,
+// a plot is running or the calibration sweep can go
+static uint16_t feedReady(void){
+#ifdef __P2AMC_MODE_COGGING
+    if(cogLeg < COG_LEGS)
+        return !cogHeld();
+#endif
+    return plotting || Serial_available();
+}
+
+// time a stored plot takes from x, y, found by running it through a
+// planner of its own, Q16 seconds
+static int32_t plotDuration(const uint16_t *path, int32_t x, int32_t y){
+    static Planner dry;
+    PathDecoder d;
+    TrajSegment seg;
+    int32_t total = 0;
+
+    Planner_init(&dry, x, y);
+    Path_open(&d, path);
+    while(Path_next(&d, &x, &y)){
+        if(Planner_full(&dry) && Planner_next(&dry, &seg))
+            total += Traj_duration(&seg);
+        Planner_push(&dry, &traj, x, y, (int32_t)TRAJ_FEEDRATE << 16);
+    }
+    while(Planner_next(&dry, &seg))
+        total += Traj_duration(&seg);
+    return total;
+}
+
+// M lines from the serial link, the ones this build does not know or with
+// words missing or out of range are counted and dropped
+static volatile uint16_t commandErrors = 0;
+
+static Void runCommand(const GcodeCommand *cmd){
+    uint16_t ok = 0;
+
+    switch(cmd->code){
+#ifdef __P2AMC_MODE_SCHED
+    case 150:   // I row J col P kp scale Q kd scale
+        if((cmd->has & 0xF) == 0xF && cmd->i >= 0 && cmd->i < ((int32_t)SCHED_ROWS << 16)
+                && cmd->j >= 0 && cmd->j < ((int32_t)SCHED_COLS << 16))
+            ok = Sched_stage(&sched, cmd->i >> 16, cmd->j >> 16, cmd->p, cmd->q);
+        break;
+    case 151:   // I index P error Q speed
+        if((cmd->has & 0xD) == 0xD && cmd->i >= 0
+                && (cmd->i < ((int32_t)SCHED_ROWS << 16) || cmd->i < ((int32_t)SCHED_COLS << 16)))
+            ok = Sched_stageBreak(&sched, cmd->i >> 16, cmd->p, cmd->q);
+        break;
+    case 152:
+        ok = Sched_commit(&sched);
+        break;
+#endif
+    default:
+        break;
+    }
+    if(!ok)
+        commandErrors += 1;
+}
+
+// next segment end point from whichever job is running. The jobs follow
+// on from each other through the same queue, so the axes only stop
+// between them if the path itself calls for it
+static uint16_t nextSegment(int32_t *x, int32_t *y, int32_t *feed){
+    GcodeCommand cmd;
+    int16_t c;
+
+#ifdef __P2AMC_MODE_COGGING
+    // the calibration sweep goes first, centred on wherever the axes
+    // start, once the tuner and the backlash measurement are done with them
+    if(cogLeg < COG_LEGS){
+        if(cogHeld())
+            return 0;
+        if(cogLeg == 0){
+            cogX = feedX;
+            cogY = feedY;
+        }
+        *x = cogX;
+        *y = cogY;
+        if(cogLeg < COG_LEGS - 1){
+            // down to one end first, then from end to end
+            *x += (cogLeg & 1) ? COG_SWEEP / 2 : -(COG_SWEEP / 2);
+            *y += (cogLeg & 1) ? COG_SWEEP / 2 : -(COG_SWEEP / 2);
+        }
+        *feed = COG_FEED;
+        cogLeg += 1;
+        return 1;
+    }
+#endif
+    while(plotting){
+        if(!jobTimed){
+            jobTime = plotDuration(plotJobs[plotJob], feedX, feedY);
+            jobTimed = 1;
+        }
+        if(Path_next(&plot, x, y)){
+            *feed = (int32_t)TRAJ_FEEDRATE << 16;
+            return 1;
+        }
+        plotJob += 1;
+        if(plotJob == PLOT_JOBS){
+            // all drawn, rewind for the next time plotting is set
+            plotJob = 0;
+            plotting = 0;
+        }
+        Path_open(&plot, plotJobs[plotJob]);
+        jobTimed = 0;
+    }
+    while(!Gcode_next(&gcode, x, y, feed)){
+        if(Gcode_command(&gcode, &cmd)){
+            runCommand(&cmd);
+            continue;
+        }
+        c = Serial_getc();
+        if(c < 0)
+            return 0;
+        Gcode_putc(&gcode, c);
+    }
+    return 1;
+}
+
+// refills the segment queue to its high mark whenever the stepper reports
+// it low. Decoding and parsing happen here, below the control loop,
+// instead of in the Swi
+Void PathFeedFxn(Void){
+    int32_t x, y, feed;
+
+#ifdef __P2AMC_MODE_BENCH
+    // once, before any job can start
+    Bench_run();
+#endif
+    while (1)
+    {
+        Semaphore_pend(pathSpace, BIOS_WAIT_FOREVER);
+#ifdef __P2AMC_MODE_ILC
+        Ilc_filter(&ilc);
+#endif
+        feedHigh = 0;
+        while(!feedHigh && !SegQueue_full(&segments)){
+            if(!nextSegment(&x, &y, &feed)){
+                feedDry = 1;
+                break;
+            }
+            SegQueue_push(&segments, x, y, feed);
+            feedX = x;
+            feedY = y;
+        }
+        SegQueue_setIdle(&segments, !plotting && Gcode_idle(&gcode) && !Serial_available());
     }
 }
 
@@ -0,0 +1,127 @@
+/*
+ *  axissim.h
+ *
+ *  Model of one axis for the host simulations in tools/, which run the
+ *  firmware's control code against it to check what it does on a plant.
+ *
+ *  The motor is the model the feedforward is built on, in DAC counts from
+ *  mid scale
+ *
+ *      u = kv vel + ka acc + friction + ripple
+ *
+ *  with Coulomb friction that holds it still until the drive beats it,
+ *  and the cogging ripple at 7 and 14 cycles a motor revolution, 14 motor
+ *  revolutions to one of the axis. It is integrated in kSubsteps steps a
+ *  control tick. The firmware sees it as it sees the board: the encoder
+ *  in 360 / 2048 degree counts, the tachometer as the running sum of its
+ *  last 8 samples, and the DAC taking the output every other tick, as
+ *  the timer writes the two axes in turn.
+ *
+ *  The tools that use it link ../control.c for Ctrl_velocity.
+ */
+
+#ifndef AXISSIM_H
+#define AXISSIM_H
+
+#include <cmath>
+#include <cstdint>
+
+extern "C" {
+#include "../control.h"
+}
+
+namespace axissim {
+
+const double kTick = 0.005;             // CONTROL_PERIOD_US
+const double kEncoder = 360.0 / 2048;   // degrees per count
+const double kGear = 14;
+const double kPi = 3.14159265358979323846;
+const int kSubsteps = 50;
+
+// speed below which the motor counts as stopped, deg/s
+const double kStuck = 0.05;
+
+inline int32_t q16(double v)
+{
+    return static_cast<int32_t>(std::floor(v * 65536.0 + 0.5));
+}
+
+inline double sign(double v)
+{
+    return v > 0 ? 1 : v < 0 ? -1 : 0;
+}
+
+struct Motor {
+    double kv = 1.92;       // counts per deg/s, X_KV_DAC
+    double ka = 0.0555;     // counts per deg/s^2, X_KA_DAC
+    double coulomb = 0;     // counts
+    double ripple[2] = { 0, 0 };    // counts at 7 and 14 a motor revolution
+    double phase[2] = { 0.7, 1.9 };
+    double pos = 0;         // degrees
+    double vel = 0;         // deg/s
+
+    double cogging(double p) const
+    {
+        double th = p * kGear * kPi / 180;
+        return ripple[0] * std::sin(7 * th + phase[0]) + ripple[1] * std::sin(14 * th + phase[1]);
+    }
+
+    // dac in counts, 0 to 4095
+    void step(double dac, double dt)
+    {
+        double d = dac - DAC_MID - cogging(pos);
+
+        if (std::fabs(vel) < kStuck && std::fabs(d) <= coulomb) {
+            vel = 0;
+            return;
+        }
+        d -= (std::fabs(vel) < kStuck ? sign(d) : sign(vel)) * coulomb;
+        vel += (d - kv * vel) / ka * dt;
+        pos += vel * dt;
+    }
+
+    void run(double dac, double t = kTick)
+    {
+        for (int i = 0; i < kSubsteps; i++)
+            step(dac, t / kSubsteps);
+    }
+};
+
+// an axis as the firmware reads and writes it
+struct Io {
+    int16_t raw[8] = {};
+    int32_t sum = 0;
+    unsigned tap = 0;
+    bool turn = false;      // the DAC takes the output this tick
+    int32_t out = DAC_MID;  // last output of the control law
+    int32_t dac = DAC_MID;  // what the DAC holds
+
+    // Q16 degrees
+    int32_t encoder(double pos) const
+    {
+        return q16(std::floor(pos / kEncoder + 0.5) * kEncoder);
+    }
+
+    // Q16 deg/s, once a tick
+    int32_t tacho(double vel)
+    {
+        int16_t r = static_cast<int16_t>(std::floor(vel / (8 * TACHO_DEG_PER_COUNT) + 0.5));
+
+        sum += r - raw[tap];
+        raw[tap] = r;
+        tap = (tap + 1) & 7;
+        return Ctrl_velocityShift(sum);
+    }
+
+    // the timer interrupt, at the start of every tick
+    void latch()
+    {
+        turn = !turn;
+        if (turn)
+            dac = out < 0 ? 0 : out > DAC_MAX ? DAC_MAX : out;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ *  backlashsim.cpp
+ *
+ *  Host simulation of the gear backlash identification and compensation
+ *  of backlash.h.
+ *
+ *  The motor of axissim.h is split into a motor and a load with a rigid
+ *  gap between them, each with its own share of the inertia and its own
+ *  Coulomb friction. Engaged they move as one, with the back EMF on the
+ *  motor; apart the motor runs on its drive and the load coasts down on
+ *  its friction until the gap closes. The firmware sees the motor side
+ *  only, through the encoder and the tachometer of axissim.h.
+ *
+ *  Lash_idStep measures the gap from three places in it. Then the PD law
+ *  with feedforward and friction compensation follows a 10 degree 1 Hz
+ *  sine and a raster of 20 degree legs, with no compensation, with the
+ *  identified gap and with the true one, and the load's error from the
+ *  reference is printed as rms and largest after the first 2 s. The
+ *  friction compensation is that of the __P2AMC_MODE_FRICTION build.
+ *
+ *      gcc -O2 -c ../backlash.c ../control.c ../friction.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o backlashsim backlashsim.cpp backlash.o control.o \
+ *          friction.o qmath.o
+ *      ./backlashsim [gap [load friction [motor friction]]]
+ *
+ *  The gap is in degrees, 0.5 by default. The friction is in DAC counts,
+ *  split 36 on the load and 24 on the motor by default so that together
+ *  they are X_FRICTION_COULOMB.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../backlash.h"
+#include "../friction.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const double kMotorShare = 0.4;  // of the inertia on the motor side
+static const double kRun = 12;          // seconds
+static const double kSkip = 2;
+
+struct Gear {
+    double kv = 1.92, ka = 0.0555;
+    double gap = 0.5;
+    double motorFriction = 24, loadFriction = 36;
+    double pm = 0, wm = 0;      // motor, degrees and deg/s at the axis
+    double pl = 0, wl = 0;      // load
+    int side = 0;               // side of the gap the motor drives, 0 apart
+
+    void engage(int s)
+    {
+        double kam = kMotorShare * ka, kal = ka - kam;
+
+        side = s;
+        wm = wl = (kam * wm + kal * wl) / ka;
+        pl = pm - s * gap / 2;
+    }
+
+    // dac in counts, 0 to 4095
+    void step(double dac, double dt)
+    {
+        double d = dac - DAC_MID, kam = kMotorShare * ka, kal = ka - kam;
+
+        if (side) {
+            double w = wm, f, a, push;
+
+            if (std::fabs(w) < kStuck && std::fabs(d) < motorFriction + loadFriction) {
+                wm = wl = 0;
+                // the motor may still back away from the load
+                if (sign(d) != -side || std::fabs(d) <= motorFriction)
+                    return;
+                side = 0;
+            } else {
+                f = (std::fabs(w) < kStuck ? sign(d) : sign(w)) * (motorFriction + loadFriction);
+                a = (d - kv * w - f) / ka;
+                // what the motor puts on the load, it lets go if that turns
+                push = kal * a + loadFriction * sign(w ? w : d);
+                if (push * side >= 0) {
+                    wm = wl = w + a * dt;
+                    pm += wm * dt;
+                    pl = pm - side * gap / 2;
+                    return;
+                }
+                side = 0;
+            }
+        }
+
+        if (std::fabs(wm) < kStuck && std::fabs(d) < motorFriction)
+            wm = 0;
+        else
+            wm += (d - kv * wm - (std::fabs(wm) < kStuck ? sign(d) : sign(wm)) * motorFriction)
+                  / kam * dt;
+        pm += wm * dt;
+        if (wl) {
+            double w = wl - sign(wl) * loadFriction / kal * dt;
+
+            wl = sign(w) == sign(wl) ? w : 0;
+        }
+        pl += wl * dt;
+        if (pm - pl >= gap / 2 && wm >= wl)
+            engage(1);
+        else if (pm - pl <= -gap / 2 && wm <= wl)
+            engage(-1);
+    }
+
+    void run(double dac)
+    {
+        for (int i = 0; i < kSubsteps; i++)
+            step(dac, kTick / kSubsteps);
+    }
+};
+
+// the load's reference at t, degrees, deg/s and deg/s^2
+static void sine(double t, double *p, double *v, double *a)
+{
+    double w = 2 * kPi;
+
+    *p = 10 * std::sin(w * t);
+    *v = 10 * w * std::cos(w * t);
+    *a = -10 * w * w * std::sin(w * t);
+}
+
+// 20 degree legs back and forth, a second each on a cosine profile
+static void raster(double t, double *p, double *v, double *a)
+{
+    double u = std::fmod(t, 2.0), s = u < 1 ? 1 : -1;
+
+    u = u < 1 ? u : u - 1;
+    *p = s * (10 - 10 * std::cos(kPi * u) - 10);
+    *v = s * 10 * kPi * std::sin(kPi * u);
+    *a = s * 10 * kPi * kPi * std::cos(kPi * u);
+}
+
+// gap found starting from where in it, fraction of the gap, -1 on failure
+static double identify(const Gear &plant, double from)
+{
+    Gear m = plant;
+    Io io;
+    LashId id;
+
+    m.pm = from * m.gap;
+    Lash_idStart(&id, io.encoder(m.pm));
+    for (long k = 0; k < 2 * LASH_ID_TIMEOUT && Lash_idRunning(&id); k++) {
+        io.latch();
+        io.out = Lash_idStep(&id, io.encoder(m.pm), io.tacho(m.wm));
+        m.run(io.dac);
+    }
+    std::printf("  from %+.1f of the gap: %s, %.3f deg in %u ticks\n", from,
+                id.state == LASH_DONE ? "done" : "failed", id.width / 65536.0, id.ticks);
+    return id.state == LASH_DONE ? id.width / 65536.0 : -1;
+}
+
+template <typename Ref>
+static void follow(const Gear &plant, Ref ref, double width, double *rms, double *max)
+{
+    Gear m = plant;
+    Io io;
+    CtrlGains g;
+    Friction f;
+    Backlash l;
+    double sum = 0, p, v, a;
+    long n = 0;
+
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, X_KV_DAC, X_KA_DAC);
+    Fric_init(&f, X_FRICTION_COULOMB, X_FRICTION_VISCOUS, X_KV_DAC, X_KA_DAC);
+    Lash_init(&l, LASH_Q16(width));
+    ref(0, &p, &v, &a);
+    m.pm = m.pl = p;
+    *max = 0;
+
+    for (long k = 0; k < kRun / kTick; k++) {
+        double t = k * kTick;
+        int32_t vel, velRef, accRef, err;
+
+        ref(t, &p, &v, &a);
+        velRef = q16(v);
+        accRef = static_cast<int32_t>(std::floor(a * 256));
+        io.latch();
+        vel = io.tacho(m.wm);
+        err = q16(p) + Lash_offset(&l, velRef, accRef) - io.encoder(m.pm);
+        io.out = Fric_compensate(&f, Ctrl_outputShift(&g, err, vel, velRef, accRef),
+                                 err, vel, velRef);
+
+        for (int i = 0; i < kSubsteps; i++) {
+            double ts = t + (i + 1) * kTick / kSubsteps, e;
+
+            m.step(io.dac, kTick / kSubsteps);
+            if (ts > kSkip) {
+                ref(ts, &p, &v, &a);
+                e = p - m.pl;
+                sum += e * e;
+                n++;
+                *max = std::fmax(*max, std::fabs(e));
+            }
+        }
+    }
+    *rms = std::sqrt(sum / n);
+}
+
+int main(int argc, char **argv)
+{
+    Gear plant;
+    double width;
+
+    if (argc > 1)
+        plant.gap = std::atof(argv[1]);
+    if (argc > 2)
+        plant.loadFriction = std::atof(argv[2]);
+    if (argc > 3)
+        plant.motorFriction = std::atof(argv[3]);
+    if (argc > 4 || plant.gap <= 0) {
+        std::fprintf(stderr, "usage: backlashsim [gap [load friction [motor friction]]]\n");
+        return 2;
+    }
+
+    std::printf("gap %.2f deg, friction %.0f counts on the load and %.0f on the motor\n",
+                plant.gap, plant.loadFriction, plant.motorFriction);
+    width = identify(plant, 0);
+    identify(plant, 0.2);
+    identify(plant, -0.4);
+    if (width < 0)
+        width = 0;
+
+    std::printf("load error, deg     none rms (max)    identified        exact\n");
+    for (int kind = 0; kind < 2; kind++) {
+        double widths[3] = { 0, width, plant.gap }, rms, max;
+
+        std::printf("  %-12s", kind ? "raster" : "sine 1 Hz");
+        for (double w : widths) {
+            if (kind)
+                follow(plant, raster, w, &rms, &max);
+            else
+                follow(plant, sine, w, &rms, &max);
+            std::printf("   %.3f (%.2f)", rms, max);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ *  cascadesim.cpp
+ *
+ *  Host simulation of the bandwidth of the cascaded loops of cascade.h
+ *  against the PD law.
+ *
+ *  The x axis of axissim.h follows a 2 degree sine, once under the PD law
+ *  at the control tick and once under the cascade, the outer loop every
+ *  CASCADE_OUTER_DIV inner ticks and the velocity loop every
+ *  CASCADE_INNER_US as the ADC interrupt runs it, the timer writing the
+ *  two axes' DACs in turn at either rate. Gain and phase of the axis
+ *  against the reference are taken over whole periods once it has
+ *  settled, for a list of frequencies, with the feedforward off and on,
+ *  and the -3 dB point is interpolated between them.
+ *
+ *      gcc -O2 -c ../cascade.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o cascadesim cascadesim.cpp cascade.o control.o qmath.o
+ *      ./cascadesim [kv ka]
+ *
+ *  kv and ka scale the back EMF and inertia of the plant against the
+ *  feedforward model, 1 and 1 by default.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../cascade.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const double kAmp = 2;           // degrees
+static const double kSettle = 2;        // seconds before measuring
+static const double kHalf = 0.7071;
+static const double kFreqs[] = { 0.5, 1, 1.5, 2, 2.5, 3, 3.5, 4, 5, 6, 7, 8, 10, 12, 15, 20 };
+
+struct Response {
+    double gain, phase;
+};
+
+static Response run(bool cascade, bool ff, double f, double kv, double ka)
+{
+    Motor m;
+    Io io;
+    CtrlGains g;
+    Cascade c;
+    double period = (cascade ? CASCADE_INNER_US : CONTROL_PERIOD_US) * 1e-6;
+    double w = 2 * kPi * f, si = 0, co = 0, t = 0;
+    long n = static_cast<long>((kSettle + 8 / f) / period), samples = 0;
+    int32_t vkv = ff ? X_KV_DAC : 0, vka = ff ? X_KA_DAC : 0;
+
+    m.kv *= kv;
+    m.ka *= ka;
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, vkv, vka);
+    Cascade_init(&c, CASCADE_Q16(X_CASCADE_KPOS), CASCADE_Q16(X_CASCADE_KVEL),
+                 CASCADE_KI_Q16(X_CASCADE_KI), vkv, vka);
+
+    for (long k = 0; k < n; k++) {
+        double ts = k * period;
+        int32_t ref = q16(kAmp * std::sin(w * ts));
+        int32_t velRef = ff ? q16(kAmp * w * std::cos(w * ts)) : 0;
+        int32_t accRef = ff ? static_cast<int32_t>(std::floor(-kAmp * w * w * std::sin(w * ts) * 256)) : 0;
+        int32_t vel, err;
+
+        io.latch();
+        vel = io.tacho(m.vel);
+        err = ref - io.encoder(m.pos);
+        if (!cascade) {
+            io.out = Ctrl_outputShift(&g, err, vel, velRef, accRef);
+        } else {
+            if (k % CASCADE_OUTER_DIV == 0)
+                Cascade_outer(&c, err, velRef, accRef);
+            io.out = Cascade_inner(&c, vel);
+        }
+
+        for (int i = 0; i < kSubsteps; i++) {
+            m.step(io.dac, period / kSubsteps);
+            t += period / kSubsteps;
+            if (t > kSettle) {
+                si += m.pos * std::sin(w * t);
+                co += m.pos * std::cos(w * t);
+                samples++;
+            }
+        }
+    }
+    si = 2 * si / samples;
+    co = 2 * co / samples;
+    return Response{ std::hypot(si, co) / kAmp, std::atan2(co, si) * 180 / kPi };
+}
+
+int main(int argc, char **argv)
+{
+    double kv = argc > 2 ? std::atof(argv[1]) : 1, ka = argc > 2 ? std::atof(argv[2]) : 1;
+    std::size_t freqs = sizeof kFreqs / sizeof kFreqs[0];
+
+    std::printf("plant kv x%.2f ka x%.2f, %.0f deg sine, inner loop %d us\n",
+                kv, ka, kAmp, CASCADE_INNER_US);
+    for (int ff = 0; ff < 2; ff++) {
+        double bw[2] = { 0, 0 }, prev[2] = { 1, 1 };
+
+        std::printf("%s\n   f Hz   PD dB  phase  cascade dB  phase\n",
+                    ff ? "feedforward on" : "feedback only");
+        for (std::size_t i = 0; i < freqs; i++) {
+            Response r[2];
+
+            for (int mode = 0; mode < 2; mode++) {
+                r[mode] = run(mode != 0, ff != 0, kFreqs[i], kv, ka);
+                if (!bw[mode] && i && r[mode].gain < kHalf)
+                    bw[mode] = kFreqs[i - 1] + (kFreqs[i] - kFreqs[i - 1])
+                               * (prev[mode] - kHalf) / (prev[mode] - r[mode].gain);
+                prev[mode] = r[mode].gain;
+            }
+            std::printf("%7.1f %7.2f %6.1f %11.2f %6.1f\n", kFreqs[i],
+                        20 * std::log10(r[0].gain), r[0].phase,
+                        20 * std::log10(r[1].gain), r[1].phase);
+        }
+        for (int mode = 0; mode < 2; mode++) {
+            if (bw[mode])
+                std::printf("  %s -3 dB at %.1f Hz\n", mode ? "cascade" : "PD", bw[mode]);
+            else
+                std::printf("  %s above %.0f Hz\n", mode ? "cascade" : "PD", kFreqs[freqs - 1]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ *  cogsim.cpp
+ *
+ *  Host simulation of the cogging compensation of cogging.h, learned from
+ *  the calibration sweep task.c sends at start up.
+ *
+ *  Both axes of axissim.h carry torque ripple at 7 and 14 cycles a motor
+ *  revolution and Coulomb friction, and power up at an arbitrary angle
+ *  that the encoder counts from. The sweep legs are made as nextSegment
+ *  makes them and run through the planner and the stepper, the PD law
+ *  with feedforward, the friction compensation of the
+ *  __P2AMC_MODE_FRICTION build and Cog_compensate closing the loop. The
+ *  run prints how far the sweep goes from the start and how fast each
+ *  axis cruises, whether the learning finished, and how far the learned
+ *  table is from the ripple. Then the x axis crosses 40 degrees at a list
+ *  of speeds without and with the table, and the tracking error and speed
+ *  ripple while the reference cruises are printed. It fails if the table
+ *  does not bring the speed ripple down at every speed.
+ *
+ *      gcc -O2 -c ../cogging.c ../trajectory.c ../planner.c ../control.c \
+ *          ../friction.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o cogsim cogsim.cpp cogging.o trajectory.o planner.o \
+ *          control.o friction.o qmath.o
+ *      ./cogsim [ripple 7 [ripple 14 [power up angle]]]
+ *
+ *  The ripple is in DAC counts, 15 and 6 by default, and the power up
+ *  angle of the x axis in degrees, -7.3 by default, y's is 3.1 on from it.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../cogging.h"
+#include "../friction.h"
+#include "../planner.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const double kSpeeds[] = { 5, 14, 40 };  // deg/s
+static const double kCross = 40;                // degrees
+static const double kYOffset = 3.1;             // degrees
+static const double kTravel = 30;               // degrees either way
+static const uint16_t kCruise = 3;              // see TRAJ_PHASES
+
+struct Point {
+    int32_t x, y;
+};
+
+struct Axis {
+    Motor m;
+    Io io;
+    CtrlGains g;
+    Friction f;
+    Cogging c;
+    double origin;      // where the encoder counts from
+    int32_t pos, vel;
+
+    void init(double at, const double *ripple)
+    {
+        Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+        Ctrl_setFeedforward(&g, X_KV_DAC, X_KA_DAC);
+        Fric_init(&f, X_FRICTION_COULOMB, X_FRICTION_VISCOUS, X_KV_DAC, X_KA_DAC);
+        m.coulomb = X_FRICTION_COULOMB;
+        m.ripple[0] = ripple[0];
+        m.ripple[1] = ripple[1];
+        m.pos = origin = at;
+    }
+
+    void sample()
+    {
+        io.latch();
+        pos = io.encoder(m.pos - origin);
+        vel = io.tacho(m.vel);
+    }
+
+    void control(int32_t posRef, int32_t velRef, int32_t accRef, bool cog)
+    {
+        int32_t err = posRef - pos;
+        int32_t out = Fric_compensate(&f, Ctrl_outputShift(&g, err, vel, velRef, accRef),
+                                      err, vel, velRef);
+
+        if (cog)
+            out = Cog_compensate(&c, pos, velRef, accRef, out);
+        io.out = out;
+        m.run(io.dac);
+    }
+};
+
+/*
+ * Runs the points through the planner a point a tick, as the stepper
+ * takes them off the segment queue, until the axes have stood still for
+ * longer than a pass takes to end. each is called every tick.
+ */
+template <typename F>
+static void drive(const std::vector<Point> &points, int32_t feed, Axis &ax, Axis &ay,
+                  bool cog, F each)
+{
+    static Trajectory traj;
+    static Planner planner;
+    TrajSegment seg;
+    std::size_t next = 0;
+    long rest = 0;
+
+    Traj_init(&traj, 0, 0);
+    Planner_init(&planner, 0, 0);
+    while (rest < COG_REST + 10) {
+        int moving = Traj_busy(&traj);
+
+        ax.sample();
+        ay.sample();
+        Traj_step(&traj);
+        if (!Traj_busy(&traj) && (Planner_full(&planner) || traj.vEnd || next == points.size())
+                && Planner_next(&planner, &seg)) {
+            Traj_start(&traj, &seg);
+            moving = 1;
+        }
+        if (next < points.size() && !Planner_full(&planner)) {
+            Planner_push(&planner, &traj, points[next].x, points[next].y, feed);
+            next++;
+        }
+        ax.control(traj.x.pos, moving ? traj.x.vel : 0, moving ? traj.x.acc : 0, cog);
+        ay.control(traj.y.pos, moving ? traj.y.vel : 0, moving ? traj.y.acc : 0, cog);
+        each(traj, moving);
+        rest = moving || next < points.size() ? 0 : rest + 1;
+    }
+}
+
+// rms of the learned table against the ripple at the middle of each bin
+static double tableError(const Axis &a)
+{
+    double sum = 0;
+
+    for (int b = 0; b < COG_BINS; b++) {
+        double p = a.origin + b * 65536.0 / COG_BIN_SCALE;
+        double e = a.c.table[b] / 16.0 - a.m.cogging(p);
+
+        sum += e * e;
+    }
+    return std::sqrt(sum / COG_BINS);
+}
+
+int main(int argc, char **argv)
+{
+    double ripple[2] = { 15, 6 }, at = -7.3;
+    std::vector<Point> legs;
+    Axis ax, ay;
+    bool ok = true;
+    double reach = 0, speed = 0;
+    long ticks = 0;
+
+    if (argc > 1)
+        ripple[0] = std::atof(argv[1]);
+    if (argc > 2)
+        ripple[1] = std::atof(argv[2]);
+    if (argc > 3)
+        at = std::atof(argv[3]);
+
+    // the legs of nextSegment from where the axes are at power up
+    for (int leg = 0; leg < COG_LEGS; leg++) {
+        int32_t d = leg == COG_LEGS - 1 ? 0 : (leg & 1) ? COG_SWEEP / 2 : -(COG_SWEEP / 2);
+
+        legs.push_back(Point{ d, d });
+    }
+
+    ax.init(at, ripple);
+    ay.init(at + kYOffset, ripple);
+    ay.io.turn = true;
+    Cog_init(&ax.c);
+    Cog_init(&ay.c);
+    Cog_learn(&ax.c);
+    Cog_learn(&ay.c);
+    drive(legs, COG_FEED, ax, ay, true, [&](const Trajectory &t, int) {
+        reach = std::fmax(reach, std::fabs(t.x.pos / 65536.0));
+        speed = std::fmax(speed, std::fabs(t.x.vel / 65536.0));
+        ticks++;
+    });
+
+    std::printf("ripple %.0f and %.0f counts, %.1f counts rms, Coulomb friction %d counts\n",
+                ripple[0], ripple[1], std::hypot(ripple[0], ripple[1]) / std::sqrt(2.0),
+                X_FRICTION_COULOMB);
+    std::printf("sweep of %d revolutions, %.1f deg either way of the start%s, %.2f deg/s "
+                "an axis, %.1f s\n", COG_SWEEP_REVS, reach, reach > kTravel ? " OVER" : "",
+                speed, ticks * kTick);
+    std::printf("learning %s after %u passes, table error rms x %.2f y %.2f counts\n",
+                ax.c.state == COG_READY && ay.c.state == COG_READY ? "done" : "not done",
+                ax.c.passes, tableError(ax), tableError(ay));
+
+    std::printf("  deg/s     cruise error rms, deg   speed ripple rms, deg/s\n");
+    std::printf("             none    table            none    table\n");
+    for (double v : kSpeeds) {
+        double err[2], ripple2[2];
+
+        for (int cog = 0; cog < 2; cog++) {
+            Axis x = ax, y = ay;
+            double e = 0, r = 0;
+            long n = 0;
+
+            x.m.pos = x.origin;
+            x.m.vel = 0;
+            x.io = Io();
+            y.m.pos = y.origin;
+            y.m.vel = 0;
+            y.io = Io();
+            y.io.turn = true;
+            drive({ Point{ q16(-kCross / 2), 0 }, Point{ q16(kCross / 2), 0 } }, q16(v), x, y,
+                  cog != 0, [&](const Trajectory &t, int moving) {
+                if (moving && t.n == kCruise && t.x.vel > 0) {
+                    double d = t.x.pos / 65536.0 - (x.m.pos - x.origin);
+
+                    e += d * d;
+                    r += (x.m.vel - v) * (x.m.vel - v);
+                    n++;
+                }
+            });
+            err[cog] = std::sqrt(e / n);
+            ripple2[cog] = std::sqrt(r / n);
+        }
+        std::printf("  %5.0f   %8.4f %8.4f         %7.2f %8.2f%s\n", v, err[0], err[1],
+                    ripple2[0], ripple2[1], ripple2[1] < ripple2[0] ? "" : "  FAIL");
+        ok = ok && ripple2[1] < ripple2[0];
+    }
+    return ok ? 0 : 1;
+}
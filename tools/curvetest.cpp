@@ -0,0 +1,259 @@
+/*
+ *  curvetest.cpp
+ *
+ *  Host check of the arc and Bezier interpolation of curve.h against the
+ *  exact curves.
+ *
+ *  Each curve is broken into chords by curve.c and the exact curve, worked
+ *  out in double precision, sampled finely along its length. The chord
+ *  error is the furthest any sample lies from the chords, the point error
+ *  the furthest any chord end lies from the curve. A set of edge cases,
+ *  full circles, both ways round, tiny and envelope sized curves, straight
+ *  and cusped Beziers, is followed by -n random curves of each kind inside
+ *  the +-30 degree envelope. The run fails if either error is over
+ *  CURVE_TOL on any curve, or the last point is not the end of the curve.
+ *
+ *      gcc -O2 -c ../curve.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o curvetest curvetest.cpp curve.o qmath.o
+ *      ./curvetest [-v] [-n count] [-s seed]
+ *
+ *  -v prints every curve rather than the worst of each kind.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "../curve.h"
+}
+
+static const double kQ16 = 65536.0;
+static const double kTol = CURVE_TOL / kQ16;
+static const double kEnvelope = 30.0;
+static const int kSamples = 4096;
+
+struct Point {
+    double x, y;
+};
+
+struct Result {
+    int chords;
+    double chordErr;    // degrees
+    double pointErr;
+    bool ended;
+};
+
+static int32_t q16(double v)
+{
+    return static_cast<int32_t>(std::lround(v * kQ16));
+}
+
+static double segDist(Point p, Point a, Point b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y, l = dx * dx + dy * dy;
+    double t = l > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / l : 0;
+
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+static double polyDist(Point p, const std::vector<Point> &poly)
+{
+    double best = 1e9;
+
+    for (std::size_t i = 1; i < poly.size(); i++) {
+        double d = segDist(p, poly[i - 1], poly[i]);
+        if (d < best)
+            best = d;
+    }
+    return best;
+}
+
+// chord ends from curve.c, starting with the first point of the curve
+static std::vector<Point> chords(Curve *c, Point start)
+{
+    std::vector<Point> poly(1, start);
+    int32_t x, y;
+
+    while (Curve_next(c, &x, &y))
+        poly.push_back(Point{ x / kQ16, y / kQ16 });
+    return poly;
+}
+
+// exact curve sampled along its parameter
+template <typename F>
+static Result measure(const std::vector<Point> &poly, F exact, Point end)
+{
+    Result r = { static_cast<int>(poly.size()) - 1, 0, 0, false };
+    std::vector<Point> fine;
+
+    for (int i = 0; i <= kSamples; i++) {
+        Point p = exact(static_cast<double>(i) / kSamples);
+        r.chordErr = std::fmax(r.chordErr, polyDist(p, poly));
+        fine.push_back(p);
+    }
+    for (std::size_t i = 1; i < poly.size(); i++)
+        r.pointErr = std::fmax(r.pointErr, polyDist(poly[i], fine));
+    r.ended = poly.back().x == end.x && poly.back().y == end.y;
+    return r;
+}
+
+// start point, centre offset and sweep in radians, positive anticlockwise
+static Result arc(double x0, double y0, double i, double j, double sweep)
+{
+    Curve c;
+    double cx = x0 + i, cy = y0 + j, r = std::hypot(i, j);
+    double a0 = std::atan2(-j, -i);
+    int32_t x1 = q16(cx + r * std::cos(a0 + sweep));
+    int32_t y1 = q16(cy + r * std::sin(a0 + sweep));
+    Point start = { q16(x0) / kQ16, q16(y0) / kQ16 };
+    Point end = { x1 / kQ16, y1 / kQ16 };
+
+    if (std::fabs(std::fabs(sweep) - 2 * M_PI) < 1e-12) {
+        x1 = q16(x0);
+        y1 = q16(y0);
+        end = start;
+    }
+    if (!Curve_arc(&c, q16(x0), q16(y0), x1, y1, q16(i), q16(j), sweep < 0))
+        return Result{ 0, 0, 0, false };
+
+    // the centre and radius as curve.c sees them, from the rounded start
+    cx = start.x + q16(i) / kQ16;
+    cy = start.y + q16(j) / kQ16;
+    r = std::hypot(start.x - cx, start.y - cy);
+    a0 = std::atan2(start.y - cy, start.x - cx);
+    return measure(chords(&c, start), [=](double t) {
+        return Point{ cx + r * std::cos(a0 + t * sweep), cy + r * std::sin(a0 + t * sweep) };
+    }, end);
+}
+
+static Result bezier(const double p[8])
+{
+    Curve c;
+    double q[8];
+
+    for (int k = 0; k < 8; k++)
+        q[k] = q16(p[k]) / kQ16;
+    Curve_bezier(&c, q16(p[0]), q16(p[1]), q16(p[2]), q16(p[3]),
+                 q16(p[4]), q16(p[5]), q16(p[6]), q16(p[7]));
+    return measure(chords(&c, Point{ q[0], q[1] }), [&](double t) {
+        double u = 1 - t;
+        double b0 = u * u * u, b1 = 3 * u * u * t, b2 = 3 * u * t * t, b3 = t * t * t;
+        return Point{ b0 * q[0] + b1 * q[2] + b2 * q[4] + b3 * q[6],
+                      b0 * q[1] + b1 * q[3] + b2 * q[5] + b3 * q[7] };
+    }, Point{ q[6], q[7] });
+}
+
+struct Tally {
+    const char *kind;
+    int count = 0, failed = 0, chords = 0;
+    double chordErr = 0, pointErr = 0;
+
+    explicit Tally(const char *k) : kind(k) {}
+
+    void add(const Result &r, bool verbose, const char *what)
+    {
+        bool bad = r.chordErr > kTol || r.pointErr > kTol || !r.ended;
+
+        count++;
+        if (bad)
+            failed++;
+        if (r.chords > chords)
+            chords = r.chords;
+        chordErr = std::fmax(chordErr, r.chordErr);
+        pointErr = std::fmax(pointErr, r.pointErr);
+        if (verbose || bad)
+            std::printf("%-6s %-28s %4d chords, chord error %.5f, point error %.6f%s%s\n",
+                        kind, what, r.chords, r.chordErr, r.pointErr,
+                        r.ended ? "" : ", misses the end", bad ? "  FAIL" : "");
+    }
+
+    void report() const
+    {
+        std::printf("%-6s %5d curves, most chords %3d, chord error %.5f deg, point error "
+                    "%.6f deg, %d over\n", kind, count, chords, chordErr, pointErr, failed);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int count = 200;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!std::strcmp(argv[i], "-n") && i + 1 < argc)
+            count = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = static_cast<unsigned>(std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "usage: curvetest [-v] [-n count] [-s seed]\n");
+            return 2;
+        }
+    }
+
+    Tally arcs("arc"), beziers("bezier");
+
+    arcs.add(arc(10, 0, -10, 0, M_PI), verbose, "half circle r 10");
+    arcs.add(arc(10, 0, -10, 0, -M_PI), verbose, "half circle r 10 cw");
+    arcs.add(arc(30, 0, -30, 0, 2 * M_PI), verbose, "full circle r 30");
+    arcs.add(arc(30, 0, -30, 0, -2 * M_PI), verbose, "full circle r 30 cw");
+    arcs.add(arc(-30, -30, 30, 30, M_PI / 2), verbose, "quarter r 42 corner");
+    arcs.add(arc(0, 0.5, 0, -0.5, 2 * M_PI), verbose, "full circle r 0.5");
+    arcs.add(arc(0, 0, 0.01, 0, 2 * M_PI), verbose, "full circle r 0.01");
+    arcs.add(arc(5, 5, 3, -4, 0.01), verbose, "sliver r 5");
+    arcs.add(arc(5, 5, 3, -4, -1.99 * M_PI), verbose, "almost full r 5 cw");
+
+    static const double edge[][8] = {
+        { -30, -30, -30, 30, 30, 30, 30, -30 },
+        { 0, 0, 1, 2, 2, -1, 3, 0 },
+        { -20, 0, 20, 0, -20, 5, 20, 5 },
+        { 0, 0, 0, 0, 0, 0, 10, 0 },
+        { -30, 0, 30, 0, -30, 0, 30, 0 },
+        { 0, 0, 30, 30, -30, 30, 0, 0 },
+        { 1, 1, 1, 1, 1, 1, 1, 1 },
+    };
+    static const char *edgeName[] = {
+        "envelope hump", "small s", "loop", "straight", "doubling back", "cusp", "point",
+    };
+    for (std::size_t k = 0; k < sizeof edge / sizeof edge[0]; k++)
+        beziers.add(bezier(edge[k]), verbose, edgeName[k]);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(-kEnvelope, kEnvelope);
+    std::uniform_real_distribution<double> turn(-2 * M_PI, 2 * M_PI);
+    for (int n = 0; n < count; n++) {
+        double cx = pos(rng), cy = pos(rng), x0 = pos(rng), y0 = pos(rng);
+        double r = std::hypot(x0 - cx, y0 - cy);
+        double a0 = std::atan2(y0 - cy, x0 - cx), sweep = turn(rng);
+        bool inside = true;
+
+        // only arcs that stay inside the envelope all the way round
+        for (int k = 0; k <= 64 && inside; k++) {
+            double a = a0 + sweep * k / 64;
+            inside = std::fabs(cx + r * std::cos(a)) <= kEnvelope
+                     && std::fabs(cy + r * std::sin(a)) <= kEnvelope;
+        }
+        if (!inside) {
+            n--;
+            continue;
+        }
+        arcs.add(arc(x0, y0, cx - x0, cy - y0, sweep), verbose, "random");
+
+        double p[8];
+        for (double &v : p)
+            v = pos(rng);
+        beziers.add(bezier(p), verbose, "random");
+    }
+
+    arcs.report();
+    beziers.report();
+    std::printf("tolerance %.5f deg\n", kTol);
+    return arcs.failed || beziers.failed;
+}
@@ -0,0 +1,226 @@
+/*
+ *  filtersim.cpp
+ *
+ *  Host check of the output filters of filter.h at the rate each axis's
+ *  DAC is written, and a simulation of a step through them.
+ *
+ *  The timer writes the two axes' DACs in turn, so an axis output reaches
+ *  the motor at half the control rate and task.c runs the filters on the
+ *  outputs that are written. The x axis stages are set up for that rate
+ *  as task.c does, and a sine of a list of frequencies is run through
+ *  them for the gain once it has settled. The notch depth at its centre,
+ *  the width between its -3 dB points and the low pass corner are checked
+ *  against the specs, and Filt_init has to turn down stages at or past
+ *  the Nyquist frequency.
+ *
+ *  Then the motor of axissim.h is split into a motor and a load on a
+ *  compliant gear that resonates at the notch, with the encoder and the
+ *  tachometer on the motor. The PD law makes a 5 degree step with no
+ *  feedforward, unfiltered and filtered, and the time the motor last
+ *  left 0.2 degrees of the target, the load's overshoot and its rms error
+ *  after 1 s are printed.
+ *
+ *      gcc -O2 -c ../filter.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o filtersim filtersim.cpp filter.o control.o qmath.o
+ *      ./filtersim [resonance [damping]]
+ *
+ *  The resonance is in Hz, X_NOTCH_HZ by default, and its damping ratio
+ *  0.02. Exits with failure when a check is out.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../filter.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const int kRate = CONTROL_RATE_HZ / 2;   // DAC writes an axis a second
+static const double kSettle = 5;                // seconds before measuring
+static const double kSeconds = 20;
+static const double kStep = 5;                  // degrees
+static const double kBand = 0.2;
+static const double kMotorShare = 0.6;          // of the inertia on the motor side
+static const double kHalf = 0.7071;
+
+static const FiltSpec kSpec[FILTER_STAGES] = {
+    { FILT_NOTCH, FILT_Q16(X_NOTCH_HZ), FILT_Q16(X_NOTCH_DEPTH), FILT_Q16(X_NOTCH_WIDTH) },
+    { FILT_LOWPASS, FILT_Q16(X_LOWPASS_HZ), 0, 0 }
+};
+
+// gain of one stage of spec at f Hz
+static double gain(const FiltSpec &spec, double f)
+{
+    FiltSpec s[FILTER_STAGES] = { spec, { FILT_NONE, 0, 0, 0 } };
+    Filter fl;
+    double si = 0, co = 0, w = 2 * kPi * f / kRate;
+    long n = 0;
+
+    Filt_init(&fl, s, kRate);
+    for (long k = 0; k < kSeconds * kRate; k++) {
+        double u = 1000 * std::sin(w * k);
+        int32_t y = Filt_apply(&fl, DAC_MID + static_cast<int32_t>(std::floor(u + 0.5)))
+                    - DAC_MID;
+
+        if (k > kSettle * kRate) {
+            si += y * std::sin(w * k);
+            co += y * std::cos(w * k);
+            n++;
+        }
+    }
+    return 2 * std::hypot(si, co) / n / 1000;
+}
+
+// frequency below to where the gain of spec crosses kHalf going up or down
+static double crossing(const FiltSpec &spec, double from, double to)
+{
+    double step = to > from ? 0.05 : -0.05;
+    bool above = gain(spec, from) > kHalf;
+
+    for (double f = from; step > 0 ? f < to : f > to; f += step)
+        if ((gain(spec, f) > kHalf) != above)
+            return f;
+    return to;
+}
+
+static bool accepts(const FiltSpec &spec)
+{
+    FiltSpec s[FILTER_STAGES] = { spec, { FILT_NONE, 0, 0, 0 } };
+    Filter fl;
+
+    return Filt_init(&fl, s, kRate) != 0;
+}
+
+struct Gear {
+    double kv = 1.92, ka = 0.0555;
+    double resonance = X_NOTCH_HZ, damping = 0.02;
+    double pm = 0, wm = 0;      // motor, degrees and deg/s at the axis
+    double pl = 0, wl = 0;      // load
+
+    void step(double dac, double dt)
+    {
+        double jm = kMotorShare * ka, jl = ka - jm, mu = jm * jl / ka;
+        double wr = 2 * kPi * resonance, k = wr * wr * mu, c = 2 * damping * wr * mu;
+        double t = k * (pm - pl) + c * (wm - wl);
+
+        wm += (dac - DAC_MID - kv * wm - t) / jm * dt;
+        wl += t / jl * dt;
+        pm += wm * dt;
+        pl += wl * dt;
+    }
+};
+
+struct Step {
+    double settle, over, ring;
+};
+
+static Step run(const Gear &plant, bool filtered)
+{
+    Gear m = plant;
+    Io io;
+    CtrlGains g;
+    Filter fl;
+    Step r = { 0, 0, 0 };
+    double sum = 0;
+    long n = 0;
+
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, 0, 0);
+    Filt_init(&fl, kSpec, kRate);
+
+    for (long k = 0; k < 3 / kTick; k++) {
+        int32_t out;
+
+        io.latch();
+        out = Ctrl_outputShift(&g, q16(kStep) - io.encoder(m.pm), io.tacho(m.wm), 0, 0);
+        // only the outputs the DAC takes at the next tick are filtered
+        if (!io.turn)
+            io.out = filtered ? Filt_apply(&fl, out) : out;
+
+        for (int i = 0; i < kSubsteps * 10; i++) {
+            double t = k * kTick + (i + 1) * kTick / (kSubsteps * 10);
+
+            m.step(io.dac, kTick / (kSubsteps * 10));
+            if (std::fabs(m.pm - kStep) > kBand)
+                r.settle = t;
+            r.over = std::fmax(r.over, m.pl - kStep);
+            if (t > 1) {
+                sum += (m.pl - kStep) * (m.pl - kStep);
+                n++;
+            }
+        }
+    }
+    r.ring = std::sqrt(sum / n);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    Gear plant;
+    bool ok = true;
+    double depth, lo, hi, corner, pass;
+    FiltSpec nyquist = { FILT_LOWPASS, FILT_Q16(kRate / 2.0), 0, 0 };
+    FiltSpec wide = kSpec[0];
+    FiltSpec below = { FILT_LOWPASS, FILT_Q16(kRate / 2.0) - 1, 0, 0 };
+
+    if (argc > 1)
+        plant.resonance = std::atof(argv[1]);
+    if (argc > 2)
+        plant.damping = std::atof(argv[2]);
+    if (argc > 3 || plant.resonance <= 0) {
+        std::fprintf(stderr, "usage: filtersim [resonance [damping]]\n");
+        return 2;
+    }
+
+    std::printf("filters at %d Hz, the DAC rate of an axis\n", kRate);
+    if (!accepts(kSpec[0]) || !accepts(kSpec[1])) {
+        std::printf("FAIL: Filt_init turns down the x axis stages of filter.h\n");
+        return 1;
+    }
+
+    depth = gain(kSpec[0], X_NOTCH_HZ);
+    lo = crossing(kSpec[0], X_NOTCH_HZ, 0.5);
+    hi = crossing(kSpec[0], X_NOTCH_HZ, kRate / 2.0);
+    pass = gain(kSpec[0], 2);
+    std::printf("notch %.1f Hz: %.1f dB at the centre for %.1f, -3 dB %.1f to %.1f Hz, "
+                "%.1f wide for %.1f, %.3f at 2 Hz\n", X_NOTCH_HZ, 20 * std::log10(depth),
+                20 * std::log10(X_NOTCH_DEPTH), lo, hi, hi - lo, X_NOTCH_WIDTH, pass);
+    if (std::fabs(20 * std::log10(depth / X_NOTCH_DEPTH)) > 0.5
+            || std::fabs(hi - lo - X_NOTCH_WIDTH) > 0.05 * X_NOTCH_WIDTH) {
+        std::printf("FAIL: notch off its spec\n");
+        ok = false;
+    }
+
+    corner = crossing(kSpec[1], 0.5, kRate / 2.0);
+    std::printf("low pass %.1f Hz: -3 dB at %.1f Hz, %.3f at 2 Hz\n", X_LOWPASS_HZ, corner,
+                gain(kSpec[1], 2));
+    if (std::fabs(corner - X_LOWPASS_HZ) > 0.02 * X_LOWPASS_HZ) {
+        std::printf("FAIL: low pass corner off its spec\n");
+        ok = false;
+    }
+
+    wide.width = FILT_Q16(kRate / 2.0);
+    std::printf("Filt_init: low pass at %.0f Hz %s, just under %s, notch %.0f Hz wide %s\n",
+                kRate / 2.0, accepts(nyquist) ? "taken" : "turned down",
+                accepts(below) ? "taken" : "turned down", kRate / 2.0,
+                accepts(wide) ? "taken" : "turned down");
+    if (accepts(nyquist) || accepts(wide) || !accepts(below)) {
+        std::printf("FAIL: Filt_init does not keep to the Nyquist frequency\n");
+        ok = false;
+    }
+
+    std::printf("%.0f deg step, gear resonance %.1f Hz damped %.2f\n", kStep, plant.resonance,
+                plant.damping);
+    for (int f = 0; f < 2; f++) {
+        Step s = run(plant, f != 0);
+
+        std::printf("  %-10s within %.1f deg in %3.0f ms, load overshoot %.3f deg, rms after "
+                    "1 s %.4f\n", f ? "filtered" : "raw", kBand, s.settle * 1000, s.over, s.ring);
+    }
+    return ok ? 0 : 1;
+}
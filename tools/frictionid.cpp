@@ -0,0 +1,140 @@
+/*
+ *  frictionid.cpp
+ *
+ *  Host tool that fits the friction model of friction.h to a log of an
+ *  axis moving under the control law.
+ *
+ *  The input is the frictionLog table saved from the debugger, or any
+ *  other log of one control tick per line as
+ *
+ *      output velocity
+ *
+ *  with the output in DAC counts from mid scale and the velocity in deg/s
+ *  scaled by 2^q (-q, default 4 as the log keeps it). The output logged on
+ *  a tick reaches the motor two ticks later, so each velocity change is
+ *  set against the output from two lines before and the motor fitted by
+ *  least squares as
+ *
+ *      output = kv vel + ka acc + coulomb sign(vel)
+ *
+ *  over the ticks moving faster than -v deg/s (default 5), so the stuck
+ *  ticks where friction can be anything up to breakaway are left out. The
+ *  viscous friction is whatever kv comes out above the nominal back EMF
+ *  (-k, default 1.92 as in trajectory.h). Log a few moves both ways at
+ *  different speeds, the fit needs both signs and a spread of speeds.
+ *
+ *      g++ -std=c++11 -O2 -o frictionid frictionid.cpp
+ *      ./frictionid [-q bits] [-v vmin] [-k kv] X < log.txt
+ */
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const double kTick = 0.005;      // CONTROL_PERIOD_US
+static const int kDelay = 2;            // ticks from the log to the motor
+
+// solves a 3 x 3 system in place by Gaussian elimination with pivoting
+static bool solve(double a[3][3], double b[3], double x[3])
+{
+    for (int c = 0; c < 3; c++) {
+        int p = c;
+        for (int r = c + 1; r < 3; r++)
+            if (std::fabs(a[r][c]) > std::fabs(a[p][c]))
+                p = r;
+        if (std::fabs(a[p][c]) < 1e-12)
+            return false;
+        for (int k = 0; k < 3; k++)
+            std::swap(a[c][k], a[p][k]);
+        std::swap(b[c], b[p]);
+        for (int r = c + 1; r < 3; r++) {
+            double f = a[r][c] / a[c][c];
+            for (int k = c; k < 3; k++)
+                a[r][k] -= f * a[c][k];
+            b[r] -= f * b[c];
+        }
+    }
+    for (int c = 2; c >= 0; c--) {
+        double s = b[c];
+        for (int k = c + 1; k < 3; k++)
+            s -= a[c][k] * x[k];
+        x[c] = s / a[c][c];
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int q = 4;
+    double vmin = 5, kvNominal = 1.92;
+    int i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!std::strcmp(argv[i], "-q"))
+            q = std::atoi(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-v"))
+            vmin = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-k"))
+            kvNominal = std::atof(argv[i + 1]);
+        else
+            break;
+    }
+    if (i != argc - 1 || q < 0 || q > 16) {
+        std::fprintf(stderr, "usage: frictionid [-q bits] [-v vmin] [-k kv] axis < log\n");
+        return 2;
+    }
+    std::string axis = argv[i];
+
+    std::vector<double> out, vel;
+    double u, v;
+    while (std::cin >> u >> v) {
+        out.push_back(u);
+        vel.push_back(std::ldexp(v, -q));
+    }
+
+    double ata[3][3] = { { 0 } }, atb[3] = { 0 }, x[3];
+    std::size_t used = 0, pos = 0, neg = 0;
+    for (std::size_t k = kDelay; k < vel.size(); k++) {
+        if (std::fabs(vel[k]) < vmin)
+            continue;
+        double row[3] = { vel[k], (vel[k] - vel[k - 1]) / kTick, vel[k] > 0 ? 1.0 : -1.0 };
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++)
+                ata[r][c] += row[r] * row[c];
+            atb[r] += row[r] * out[k - kDelay];
+        }
+        used++;
+        (vel[k] > 0 ? pos : neg)++;
+    }
+    if (!pos || !neg || !solve(ata, atb, x)) {
+        std::fprintf(stderr, "frictionid: %u moving ticks, need moves both ways at a "
+                             "spread of speeds\n", static_cast<unsigned>(used));
+        return 1;
+    }
+
+    double resid = 0;
+    for (std::size_t k = kDelay; k < vel.size(); k++) {
+        if (std::fabs(vel[k]) < vmin)
+            continue;
+        double e = out[k - kDelay] - x[0] * vel[k] - x[1] * (vel[k] - vel[k - 1]) / kTick
+                   - x[2] * (vel[k] > 0 ? 1 : -1);
+        resid += e * e;
+    }
+    std::fprintf(stderr, "%u moving ticks: kv %.3f, ka %.4f, coulomb %.1f counts, "
+                         "rms residual %.1f counts\n", static_cast<unsigned>(used),
+                 x[0], x[1], x[2], std::sqrt(resid / used));
+
+    for (char &c : axis)
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    long coulomb = std::lround(std::fmax(x[2], 0.0));
+    long viscous = std::lround(std::ldexp(std::fmax(x[0] - kvNominal, 0.0), 16));
+    std::printf("#define %s_FRICTION_COULOMB %ld\n", axis.c_str(), coulomb);
+    std::printf("#define %s_FRICTION_VISCOUS %ldL\n", axis.c_str(), viscous);
+    return 0;
+}
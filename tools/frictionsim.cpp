@@ -0,0 +1,159 @@
+/*
+ *  frictionsim.cpp
+ *
+ *  Host simulation of the friction compensation and disturbance observer
+ *  of friction.h under the PD law.
+ *
+ *  The x axis of axissim.h gets stiction above its Coulomb friction and
+ *  viscous friction beyond the back EMF. Under the PD law with
+ *  feedforward on the tuned gains of control.h it makes a 5 degree step
+ *  and follows a 10 degree 0.5 Hz sine, with no compensation, with the
+ *  observer alone and with the observer and the friction model. For the
+ *  step it prints where the axis stops and when it last left two encoder
+ *  counts of the target, for the sine the rms error after the first 2 s.
+ *  Then the same runs on the plant without friction show what the
+ *  compensation costs when there is nothing to compensate.
+ *
+ *      gcc -O2 -c ../friction.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o frictionsim frictionsim.cpp friction.o control.o qmath.o
+ *      ./frictionsim [stiction [coulomb [viscous]]]
+ *
+ *  The friction is in DAC counts, and per deg/s for the viscous part, 120,
+ *  80 and 0.2 by default. The model of the compensation takes the
+ *  X_FRICTION_* constants of friction.h.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../friction.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const double kStep = 5;                  // degrees
+static const double kAmp = 10, kFreq = 0.5;     // degrees, Hz
+static const double kSkip = 2;                  // seconds
+static const double kBand = 2 * kEncoder;
+
+enum Law { Plain, Observer, Model };
+
+// the motor of axissim.h held until the drive beats the stiction
+struct Plant : Motor {
+    double stiction = 120;
+    double viscous = 0.2;
+
+    void step(double dac, double dt)
+    {
+        double d = dac - DAC_MID - cogging(pos);
+
+        if (std::fabs(vel) < kStuck && std::fabs(d) <= stiction) {
+            vel = 0;
+            return;
+        }
+        d -= (std::fabs(vel) < kStuck ? sign(d) : sign(vel)) * coulomb;
+        vel += (d - (kv + viscous) * vel) / ka * dt;
+        pos += vel * dt;
+    }
+};
+
+struct Result {
+    double stop, settle;    // step, degrees short and seconds
+    double rms;             // sine, degrees
+};
+
+static void run(Law law, bool sine, const Plant &plant, Result *r)
+{
+    Plant m = plant;
+    Io io;
+    CtrlGains g;
+    Friction f;
+    double seconds = sine ? 12 : 1.5, w = 2 * kPi * kFreq, e = 0;
+    long n = 0;
+
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, X_KV_DAC, X_KA_DAC);
+    Fric_init(&f, law == Model ? X_FRICTION_COULOMB : 0, law == Model ? X_FRICTION_VISCOUS : 0,
+              X_KV_DAC, X_KA_DAC);
+
+    for (long k = 0; k < seconds / kTick; k++) {
+        double t = k * kTick;
+        double ref = sine ? kAmp * std::sin(w * t) : kStep;
+        double vr = sine ? kAmp * w * std::cos(w * t) : 0;
+        double ar = sine ? -kAmp * w * w * std::sin(w * t) : 0;
+        int32_t vel, velRef = q16(vr), accRef = static_cast<int32_t>(std::floor(ar * 256));
+        int32_t err, out;
+
+        io.latch();
+        vel = io.tacho(m.vel);
+        err = q16(ref) - io.encoder(m.pos);
+        out = Ctrl_outputShift(&g, err, vel, velRef, accRef);
+        if (law != Plain)
+            out = Fric_compensate(&f, out, err, vel, velRef);
+        io.out = out;
+
+        for (int i = 0; i < kSubsteps; i++) {
+            double ts = t + (i + 1) * kTick / kSubsteps;
+
+            m.step(io.dac, kTick / kSubsteps);
+            if (sine && ts > kSkip) {
+                double d = kAmp * std::sin(w * ts) - m.pos;
+
+                e += d * d;
+                n++;
+            }
+            if (!sine && std::fabs(m.pos - kStep) > kBand)
+                r->settle = ts;
+        }
+    }
+    if (sine)
+        r->rms = std::sqrt(e / n);
+    else
+        r->stop = kStep - m.pos;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const names[] = { "PD", "+observer", "+model" };
+    Plant plant;
+    Plant none;
+
+    plant.coulomb = 80;
+    if (argc > 1)
+        plant.stiction = std::atof(argv[1]);
+    if (argc > 2)
+        plant.coulomb = std::atof(argv[2]);
+    if (argc > 3)
+        plant.viscous = std::atof(argv[3]);
+    if (argc > 4 || plant.coulomb > plant.stiction) {
+        std::fprintf(stderr, "usage: frictionsim [stiction [coulomb [viscous]]], "
+                     "stiction at least the Coulomb friction\n");
+        return 2;
+    }
+    none.stiction = none.viscous = 0;
+
+    for (int p = 0; p < 2; p++) {
+        const Plant &pl = p ? none : plant;
+
+        std::printf("stiction %.0f counts, Coulomb %.0f, viscous %.2f a deg/s, model Coulomb %d\n",
+                    pl.stiction, pl.coulomb, pl.viscous, X_FRICTION_COULOMB);
+        std::printf("  law          %.0f deg step short    settle   %.0f deg %.1f Hz sine rms\n",
+                    kStep, kAmp, kFreq);
+        for (int law = Plain; law <= Model; law++) {
+            Result r = { 0, 0, 0 };
+
+            run(static_cast<Law>(law), false, pl, &r);
+            run(static_cast<Law>(law), true, pl, &r);
+            if (std::fabs(r.stop) > kBand)
+                std::printf("  %-10s %13.3f deg %12s %15.3f deg\n", names[law], r.stop, "-", r.rms);
+            else
+                std::printf("  %-10s %13.3f deg %9.0f ms %15.3f deg\n", names[law], r.stop,
+                            r.settle * 1000, r.rms);
+        }
+    }
+    return 0;
+}
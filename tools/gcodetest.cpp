@@ -0,0 +1,455 @@
+/*
+ *  gcodetest.cpp
+ *
+ *  Host test of the streaming G-code interpreter of gcode.h over a
+ *  pseudo-terminal standing in for SCI-A.
+ *
+ *  Each file is streamed into the master side of a pty by a sender thread
+ *  that obeys XON/XOFF, the way a terminal program on the PC would. The
+ *  other side plays the target: every character that arrives goes into a
+ *  ring the size of serial.c's, with XOFF sent past SERIAL_RX_HIGH and XON
+ *  once drained below SERIAL_RX_LOW, and is taken out the way nextSegment
+ *  in task.c does, only when the interpreter has nothing left to hand
+ *  out. Each point pulled costs a control tick, so the link runs faster
+ *  than the drawing and the flow control has to hold the sender off. The
+ *  sender is paced to 115200 baud on the same time scale and never has
+ *  more than the SCI's four characters waiting on the target, so what is
+ *  still on the wire when XOFF goes out is what it would be on the board.
+ *
+ *  The points and M commands that come out are checked against the same
+ *  file fed straight into the interpreter, and the ring must never have
+ *  overflowed. With no files a built in program covering every supported
+ *  code, comments and a few bad lines is used, and what it gives is also
+ *  checked against what it should: the end point and feed of every move,
+ *  every arc point on its circle and the arc going the right way round
+ *  by the right angle, the relative moves of G91 and the words of the M
+ *  commands.
+ *
+ *      gcc -O2 -c ../gcode.c ../curve.c ../qmath.c
+ *      g++ -std=c++11 -O2 -pthread -o gcodetest gcodetest.cpp gcode.o curve.o qmath.o
+ *      ./gcodetest [-v] [-t us] [file.gcode ...]
+ *
+ *  -v prints every point, -t is the time a point takes to draw in us
+ *  (default 200, much faster than the real 5000 so a file goes quickly).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "../gcode.h"
+#include "../serial.h"
+}
+
+// characters a control tick at 115200 baud, and the most waiting in the
+// SCI receive FIFO
+static const unsigned kCharsPerTick = 115200 / 10 / 200;
+static const int kFifo = 4;
+
+static const char kSample[] =
+    "( every code the target takes )\n"
+    "G90 F1200\n"
+    "N10 G1 X10 Y-5.5\n"
+    "G2 X20 Y-5.5 I5 J0 ; half circle\n"
+    "G3 X20 Y-5.5 I-5   ; full circle back\n"
+    "G5 X0 Y0 I-5 J5 P5 Q-5\n"
+    "G91 G0 X1 Y1\n"
+    "G1 X-2 F600\n"
+    "G90\n"
+    "M150 I1 J2 P0.5 Q1.5\n"
+    "M152\n"
+    "G1 X\n"
+    "G7 X3\n"
+    "G1 X-12.25 Y12.5\n";
+
+struct Out {
+    bool move;
+    int32_t a, b, c;    // x y feed, or code has i
+    int32_t d, e, f;    // j p q for commands
+
+    bool operator==(const Out &o) const
+    {
+        return move == o.move && a == o.a && b == o.b && c == o.c && d == o.d && e == o.e
+               && f == o.f;
+    }
+};
+
+// what the built in program has to give, in order
+struct Expect {
+    char kind;          // L line, A arc, B Bezier, M command
+    double x, y;        // end point, or M code and words given
+    double feed;        // deg/s, -1 for rapid
+    double cx, cy;      // arc centre
+    double sweep;       // degrees the arc turns, counterclockwise positive
+    double w[4];        // I J P Q of a command
+};
+
+static const Expect kExpect[] = {
+    { 'L', 10, -5.5, 20, 0, 0, 0, { 0 } },              // F1200 is 20 deg/s
+    { 'A', 20, -5.5, 20, 15, -5.5, -180, { 0 } },
+    { 'A', 20, -5.5, 20, 15, -5.5, 360, { 0 } },
+    { 'B', 0, 0, 20, 0, 0, 0, { 0 } },
+    { 'L', 1, 1, -1, 0, 0, 0, { 0 } },                  // G91 from 0 0
+    { 'L', -1, 1, 10, 0, 0, 0, { 0 } },
+    { 'M', 150, GCODE_HAS_I | GCODE_HAS_J | GCODE_HAS_P | GCODE_HAS_Q, 0, 0, 0, 0,
+      { 1, 2, 0.5, 1.5 } },
+    { 'M', 152, 0, 0, 0, 0, 0, { 0 } },
+    { 'L', -12.25, 12.5, 10, 0, 0, 0, { 0 } },          // back in G90
+};
+static const unsigned kSampleLines = 14, kSampleErrors = 2;
+
+static int32_t q16(double v)
+{
+    return static_cast<int32_t>(std::lround(v * 65536.0));
+}
+
+// a Q16 value rounded, and an arc point off its circle
+static const double kRound = 1.0 / 65536;
+static const double kOffArc = 0.001;
+
+static bool at(const Out &o, double x, double y)
+{
+    return std::fabs(o.a / 65536.0 - x) <= kRound && std::fabs(o.b / 65536.0 - y) <= kRound;
+}
+
+static bool feedIs(const Out &o, double feed)
+{
+    return feed < 0 ? o.c == GCODE_RAPID : std::fabs(o.c / 65536.0 - feed) <= kRound;
+}
+
+// the outputs of the built in program against kExpect, what is wrong in why
+static bool expected(const std::vector<Out> &got, std::string &why)
+{
+    char buf[120];
+    std::size_t k = 0;
+    double px = 0, py = 0;
+
+    for (std::size_t n = 0; n < sizeof kExpect / sizeof kExpect[0]; n++) {
+        const Expect &e = kExpect[n];
+        double swept = 0, r = std::hypot(px - e.cx, py - e.cy);
+
+        if (e.kind == 'M')
+            std::snprintf(buf, sizeof buf, "expected output %u, M%g: ",
+                          static_cast<unsigned>(n), e.x);
+        else
+            std::snprintf(buf, sizeof buf, "expected output %u, %c to %g %g: ",
+                          static_cast<unsigned>(n), e.kind, e.x, e.y);
+        why = buf;
+        if (e.kind == 'M') {
+            if (k == got.size() || got[k].move) {
+                why += "no command";
+                return false;
+            }
+            const Out &o = got[k++];
+            if (o.a != e.x || o.b != e.y || o.c != q16(e.w[0]) || o.d != q16(e.w[1])
+                    || o.e != q16(e.w[2]) || o.f != q16(e.w[3])) {
+                why += "wrong words";
+                return false;
+            }
+            continue;
+        }
+        for (;;) {
+            if (k == got.size() || !got[k].move) {
+                why += "no end point";
+                return false;
+            }
+            const Out &o = got[k++];
+            double x = o.a / 65536.0, y = o.b / 65536.0;
+            if (!feedIs(o, e.feed)) {
+                why += "wrong feed";
+                return false;
+            }
+            if (e.kind == 'A') {
+                if (std::fabs(std::hypot(x - e.cx, y - e.cy) - r) > kOffArc) {
+                    std::snprintf(buf, sizeof buf, "%.4f %.4f off the circle", x, y);
+                    why += buf;
+                    return false;
+                }
+                double d = std::atan2(y - e.cy, x - e.cx) - std::atan2(py - e.cy, px - e.cx);
+                swept += std::remainder(d, 2 * 3.14159265358979323846) * 180 / 3.14159265358979323846;
+            }
+            px = x;
+            py = y;
+            if (e.kind == 'L' || at(o, e.x, e.y))
+                break;
+        }
+        if (!at(got[k - 1], e.x, e.y)) {
+            why += "wrong end point";
+            return false;
+        }
+        if (e.kind == 'A' && std::fabs(swept - e.sweep) > 1) {
+            std::snprintf(buf, sizeof buf, "turned %.1f degrees", swept);
+            why += buf;
+            return false;
+        }
+    }
+    if (k != got.size()) {
+        why = "more outputs than expected";
+        return false;
+    }
+    why.clear();
+    return true;
+}
+
+// pulls whatever the interpreter has waiting, as nextSegment does
+static bool pull(Gcode *g, std::vector<Out> &out)
+{
+    int32_t x, y, feed;
+    GcodeCommand cmd;
+
+    if (Gcode_next(g, &x, &y, &feed)) {
+        out.push_back(Out{ true, x, y, feed, 0, 0, 0 });
+        return true;
+    }
+    if (Gcode_command(g, &cmd)) {
+        out.push_back(Out{ false, cmd.code, cmd.has, cmd.i, cmd.j, cmd.p, cmd.q });
+        return true;
+    }
+    return false;
+}
+
+static void direct(const std::string &text, std::vector<Out> &out, Gcode *g)
+{
+    Gcode_init(g, 0, 0);
+    for (char ch : text) {
+        while (pull(g, out))
+            ;
+        Gcode_putc(g, static_cast<unsigned char>(ch));
+    }
+    while (pull(g, out))
+        ;
+}
+
+struct Link {
+    int master = -1;
+    int slave = -1;
+    unsigned charUs = 1;
+    std::atomic<bool> sent{ false };
+};
+
+static bool openLink(Link &l)
+{
+    termios t;
+
+    l.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (l.master < 0 || grantpt(l.master) || unlockpt(l.master))
+        return false;
+    l.slave = open(ptsname(l.master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (l.slave < 0 || tcgetattr(l.slave, &t))
+        return false;
+    // no echo and no flow control in the line discipline, XON and XOFF
+    // have to reach the two ends as they are
+    cfmakeraw(&t);
+    return tcsetattr(l.slave, TCSANOW, &t) == 0;
+}
+
+// the PC side, one character at a time, stopping while held off
+static void sender(Link *l, const std::string *text)
+{
+    bool held = false;
+    std::size_t i = 0;
+
+    while (i < text->size()) {
+        pollfd p = { l->master, POLLIN, 0 };
+        unsigned char c;
+        while (poll(&p, 1, held ? 10 : 0) > 0 && read(l->master, &c, 1) == 1) {
+            if (c == XOFF)
+                held = true;
+            else if (c == XON)
+                held = false;
+            p.revents = 0;
+        }
+        int waiting = 0;
+        if (held || (ioctl(l->slave, FIONREAD, &waiting) == 0 && waiting >= kFifo))
+            continue;
+        if (write(l->master, &(*text)[i], 1) == 1)
+            i++;
+        std::this_thread::sleep_for(std::chrono::microseconds(l->charUs));
+    }
+    l->sent = true;
+}
+
+struct Target {
+    unsigned char ring[SERIAL_RX_SIZE];
+    unsigned head = 0, tail = 0;
+    bool paused = false;
+    unsigned overruns = 0, peak = 0, xoffs = 0;
+
+    unsigned level() const { return (head - tail) & (SERIAL_RX_SIZE - 1); }
+};
+
+// what sciRxISR does with everything that has arrived
+static void receive(Link &l, Target &t)
+{
+    unsigned char c;
+
+    while (read(l.slave, &c, 1) == 1) {
+        unsigned next = (t.head + 1) & (SERIAL_RX_SIZE - 1);
+        if (next == t.tail) {
+            t.overruns++;
+            continue;
+        }
+        t.ring[t.head] = c;
+        t.head = next;
+        if (t.level() > t.peak)
+            t.peak = t.level();
+        if (!t.paused && t.level() >= SERIAL_RX_HIGH) {
+            const unsigned char off = XOFF;
+            t.paused = true;
+            t.xoffs++;
+            if (write(l.slave, &off, 1) != 1)
+                t.overruns++;
+        }
+    }
+}
+
+// a control tick passing, with the receive interrupt taking characters
+static void tick(Link &l, Target &t, unsigned us)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+
+    do {
+        receive(l, t);
+    } while (std::chrono::steady_clock::now() < end);
+}
+
+// Serial_getc
+static int takeChar(Link &l, Target &t)
+{
+    int c = -1;
+
+    if (t.tail != t.head) {
+        c = t.ring[t.tail];
+        t.tail = (t.tail + 1) & (SERIAL_RX_SIZE - 1);
+    }
+    if (t.paused && t.level() <= SERIAL_RX_LOW) {
+        const unsigned char on = XON;
+        t.paused = false;
+        if (write(l.slave, &on, 1) != 1)
+            t.overruns++;
+    }
+    return c;
+}
+
+static bool streamed(const std::string &text, std::vector<Out> &out, Gcode *g,
+                     unsigned tickUs, Target &t)
+{
+    Link l;
+    if (!openLink(l)) {
+        std::perror("gcodetest: pty");
+        return false;
+    }
+    l.charUs = tickUs / kCharsPerTick ? tickUs / kCharsPerTick : 1;
+    Gcode_init(g, 0, 0);
+    std::thread th(sender, &l, &text);
+    int idle = 0;
+
+    // the path feed loop, a point per control tick
+    while (idle < 50) {
+        receive(l, t);
+        if (pull(g, out)) {
+            tick(l, t, tickUs);
+            continue;
+        }
+        int c = takeChar(l, t);
+        if (c >= 0) {
+            Gcode_putc(g, static_cast<uint16_t>(c));
+            idle = 0;
+        } else {
+            tick(l, t, tickUs);
+            if (l.sent)
+                idle++;
+        }
+    }
+    th.join();
+    close(l.slave);
+    close(l.master);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    unsigned tickUs = 200;
+    std::vector<std::string> names;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!std::strcmp(argv[i], "-t") && i + 1 < argc)
+            tickUs = static_cast<unsigned>(std::atoi(argv[++i]));
+        else
+            names.push_back(argv[i]);
+    }
+    if (names.empty())
+        names.push_back("");
+
+    int failed = 0;
+    for (const std::string &name : names) {
+        std::string text = kSample;
+        if (!name.empty()) {
+            std::ifstream f(name);
+            if (!f) {
+                std::fprintf(stderr, "gcodetest: cannot open %s\n", name.c_str());
+                return 2;
+            }
+            std::stringstream s;
+            s << f.rdbuf();
+            text = s.str();
+        }
+        if (text.empty() || text.back() != '\n')
+            text += '\n';
+
+        static Gcode g;
+        std::vector<Out> want, got;
+        Target t;
+        direct(text, want, &g);
+        unsigned lines = g.lines, errors = g.errors;
+        if (!streamed(text, got, &g, tickUs, t))
+            return 2;
+
+        bool same = want == got && g.lines == lines && g.errors == errors;
+        for (std::size_t i = 0; verbose && i < got.size(); i++) {
+            const Out &o = got[i];
+            if (o.move)
+                std::printf("%10.4f %10.4f  F %.2f\n", o.a / 65536.0, o.b / 65536.0,
+                            o.c == GCODE_RAPID ? -1.0 : o.c / 65536.0);
+            else
+                std::printf("M%d has %d I %.4f J %.4f P %.4f Q %.4f\n", o.a, o.b,
+                            o.c / 65536.0, o.d / 65536.0, o.e / 65536.0, o.f / 65536.0);
+        }
+        std::printf("%s: %u lines, %u errors, %u outputs, %u XOFF, ring peak %u of %u, "
+                    "%u overruns, %s\n", name.empty() ? "built in" : name.c_str(),
+                    g.lines, g.errors, static_cast<unsigned>(got.size()), t.xoffs, t.peak,
+                    SERIAL_RX_SIZE, t.overruns, same ? "matches direct feed" : "MISMATCH");
+        if (!same || t.overruns)
+            failed = 1;
+        if (name.empty()) {
+            std::string why;
+            if (!expected(got, why))
+                std::printf("built in: %s\n", why.c_str());
+            else if (g.lines != kSampleLines || g.errors != kSampleErrors)
+                std::printf("built in: %u lines and %u errors, expected %u and %u\n",
+                            g.lines, g.errors, kSampleLines, kSampleErrors);
+            else
+                std::printf("built in: every output as expected\n");
+            if (!why.empty() || g.lines != kSampleLines || g.errors != kSampleErrors)
+                failed = 1;
+        }
+    }
+    return failed;
+}
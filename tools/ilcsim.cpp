@@ -0,0 +1,212 @@
+/*
+ *  ilcsim.cpp
+ *
+ *  Host simulation of the iterative learning control of ilc.h over
+ *  repeated runs of a stored plot, and a check that it learns.
+ *
+ *  plot_sidewind.h is fed to the planner a point a tick as the stepper
+ *  takes them, and both axes of axissim.h follow it under the PD law with
+ *  feedforward. A run starts and ends as it does in the stepper: from
+ *  the first move until everything is drawn and the reference is at rest,
+ *  with Ilc_step taking the axis errors and handing back the corrections
+ *  every tick, then Ilc_end, and Ilc_filter as the path feed calls it.
+ *  Each run starts at rest on the first point with what the last runs
+ *  learned. For every run it prints the rms error Ilc_filter works out
+ *  from the samples, and the rms and largest error of the plant.
+ *
+ *  It fails if the run at TRAJ_FEEDRATE does not fit in the ILC_SAMPLES
+ *  samples, or if the last run is not below the first.
+ *
+ *      gcc -O2 -c ../ilc.c ../trajectory.c ../planner.c ../path.c ../control.c \
+ *          ../qmath.c
+ *      g++ -std=c++11 -O2 -o ilcsim ilcsim.cpp ilc.o trajectory.o planner.o path.o \
+ *          control.o qmath.o
+ *      ./ilcsim [runs [kv scale [ka scale]]]
+ *
+ *  8 runs by default, on a plant with the back EMF and inertia of the
+ *  feedforward model times the scales, 1 by default.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../ilc.h"
+#include "../path.h"
+#include "../planner.h"
+#include "../trajectory.h"
+#include "../plot_sidewind.h"
+}
+
+using namespace axissim;
+
+static const double kMaxRun = 60;       // seconds
+
+struct Axis {
+    Motor m;
+    Io io;
+    CtrlGains g;
+    int32_t pos, vel;
+
+    void init(double kp, double kd, int32_t kv, int32_t ka, const double *plant)
+    {
+        Ctrl_setGainsShift(&g, CTRL_Q16(kp), CTRL_Q16(kd));
+        Ctrl_setFeedforward(&g, kv, ka);
+        m.kv *= plant[0];
+        m.ka *= plant[1];
+    }
+
+    void start(int32_t at)
+    {
+        m.pos = at / 65536.0;
+        m.vel = 0;
+        io = Io();
+    }
+
+    void sample()
+    {
+        io.latch();
+        pos = io.encoder(m.pos);
+        vel = io.tacho(m.vel);
+    }
+
+    void control(int32_t posRef, int32_t velRef, int32_t accRef, int32_t trim)
+    {
+        io.out = Ctrl_outputShift(&g, posRef - pos + trim, vel, velRef, accRef);
+        m.run(io.dac);
+    }
+};
+
+struct Run {
+    long ticks;             // of the run as the learning sees it
+    double rms, worst;      // plant, degrees
+};
+
+static Run run(Ilc *l, Axis &ax, Axis &ay)
+{
+    static Trajectory traj;
+    static Planner planner;
+    PathDecoder d;
+    TrajSegment seg;
+    int32_t x, y;
+    bool more = true;
+    double sum = 0;
+    long n = 0;
+    Run r = { 0, 0, 0 };
+
+    Path_open(&d, sidewindPath);
+    Path_next(&d, &x, &y);
+    Traj_init(&traj, x, y);
+    Planner_init(&planner, x, y);
+    ax.start(x);
+    ay.start(y);
+    ay.io.turn = true;
+
+    for (long k = 0; k * kTick < kMaxRun; k++) {
+        int moving = Traj_busy(&traj);
+        int32_t cx = 0, cy = 0, vx, vy, accX, accY;
+
+        ax.sample();
+        ay.sample();
+        Traj_step(&traj);
+        if (!Traj_busy(&traj) && (Planner_full(&planner) || traj.vEnd || !more)
+                && Planner_next(&planner, &seg)) {
+            Traj_start(&traj, &seg);
+            moving = 1;
+        }
+        vx = moving ? traj.x.vel : 0;
+        vy = moving ? traj.y.vel : 0;
+        accX = moving ? traj.x.acc : 0;
+        accY = moving ? traj.y.acc : 0;
+
+        // as the stepper, plotting lasts until the last point is fed
+        if (moving && more && l->state == ILC_READY)
+            Ilc_begin(l);
+        if (Ilc_running(l)) {
+            if (moving || more || !Planner_empty(&planner)) {
+                Ilc_step(l, traj.x.pos - ax.pos, traj.y.pos - ay.pos, &cx, &cy);
+                r.ticks++;
+            } else {
+                Ilc_end(l);
+                Ilc_filter(l);
+                break;
+            }
+        }
+
+        if (more && !Planner_full(&planner)) {
+            if (Path_next(&d, &x, &y))
+                Planner_push(&planner, &traj, x, y, TRAJ_FEEDRATE * 65536L);
+            else
+                more = false;
+        }
+        if (Ilc_running(l)) {
+            double e = std::hypot(traj.x.pos / 65536.0 - ax.m.pos,
+                                  traj.y.pos / 65536.0 - ay.m.pos);
+
+            sum += e * e;
+            n++;
+            r.worst = std::fmax(r.worst, e);
+        }
+        ax.control(traj.x.pos, vx, accX, cx);
+        ay.control(traj.y.pos, vy, accY, cy);
+    }
+    r.rms = n ? std::sqrt(sum / n) : 0;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = argc > 1 ? std::atoi(argv[1]) : 8;
+    double plant[2] = { 1, 1 };
+    static Ilc l;
+    Axis ax, ay;
+    double first = 0, last = 0;
+    long capacity = static_cast<long>(ILC_SAMPLES) * ILC_DECIMATE;
+
+    if (argc > 2)
+        plant[0] = std::atof(argv[2]);
+    if (argc > 3)
+        plant[1] = std::atof(argv[3]);
+    if (argc > 4 || runs < 2) {
+        std::fprintf(stderr, "usage: ilcsim [runs [kv scale [ka scale]]], at least 2 runs\n");
+        return 2;
+    }
+
+    ax.init(X_KP_COUNTS, X_KD_COUNTS, X_KV_DAC, X_KA_DAC, plant);
+    ay.init(Y_KP_COUNTS, Y_KD_COUNTS, Y_KV_DAC, Y_KA_DAC, plant);
+    Ilc_init(&l);
+
+    std::printf("%d points at %d deg/s, plant kv x%.2f ka x%.2f, %u samples of %.0f ms\n",
+                SIDEWIND_POINTS, TRAJ_FEEDRATE, plant[0], plant[1], ILC_SAMPLES,
+                ILC_DECIMATE * kTick * 1000);
+    std::printf("  run   length   samples rms x   y, deg   plant rms   largest\n");
+    for (int i = 1; i <= runs; i++) {
+        Run r = run(&l, ax, ay);
+        double rms = std::hypot(l.x.rms / 65536.0, l.y.rms / 65536.0);
+
+        if (l.state != ILC_READY) {
+            std::fprintf(stderr, "ilcsim: run %d did not end in %.0f s\n", i, kMaxRun);
+            return 1;
+        }
+        std::printf("  %3d  %6.2f s  %8.4f %8.4f  %10.4f %9.4f\n", i, r.ticks * kTick,
+                    l.x.rms / 65536.0, l.y.rms / 65536.0, r.rms, r.worst);
+        if (r.ticks > capacity) {
+            std::printf("FAIL: the run takes %.2f s, the learning covers %.2f s\n",
+                        r.ticks * kTick, capacity * kTick);
+            return 1;
+        }
+        if (i == 1)
+            first = rms;
+        last = rms;
+    }
+    if (last >= first) {
+        std::printf("FAIL: run %d at %.4f deg rms is not below run 1 at %.4f\n", runs, last,
+                    first);
+        return 1;
+    }
+    std::printf("run %d at %.4f deg rms, %.1f%% of run 1, the runs fit in %.2f s\n", runs,
+                last, 100 * last / first, capacity * kTick);
+    return 0;
+}
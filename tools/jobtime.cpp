@@ -0,0 +1,178 @@
+/*
+ *  jobtime.cpp
+ *
+ *  Host simulation of a stored plot run through the look ahead planner,
+ *  checking the job time estimate of task.c against the run and the old
+ *  fixed 0.1 s slot per point.
+ *
+ *  The estimate is worked out as plotDuration does, a planner of its own
+ *  and Traj_duration over every segment. The run feeds the same points to
+ *  the planner the way the stepper does, waiting for the look ahead
+ *  window to fill when starting from rest, and drives both axes of
+ *  axissim.h through the PD law with feedforward. It reports when the
+ *  reference finishes and when both axes have settled within an encoder
+ *  count of the last point, the largest drive the reference asks for by
+ *  the feedforward model against X_DRIVE, and the largest output and
+ *  tracking error on the plant.
+ *
+ *      gcc -O2 -c ../trajectory.c ../planner.c ../path.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o jobtime jobtime.cpp trajectory.o planner.o path.o control.o qmath.o
+ *      ./jobtime [feed]
+ *
+ *  feed is the drawing speed in deg/s, TRAJ_FEEDRATE by default. The plot
+ *  is plot_sidewind.h.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../path.h"
+#include "../planner.h"
+#include "../trajectory.h"
+#include "../plot_sidewind.h"
+}
+
+using namespace axissim;
+
+static const double kOldSlot = 0.1;     // seconds a point took before the planner
+static const double kMaxRun = 120;      // seconds
+
+// as plotDuration in task.c
+static double estimate(const Trajectory *traj, int32_t feed)
+{
+    static Planner dry;
+    PathDecoder d;
+    TrajSegment seg;
+    int32_t x = traj->x.pos, y = traj->y.pos, total = 0;
+
+    Planner_init(&dry, x, y);
+    Path_open(&d, sidewindPath);
+    while (Path_next(&d, &x, &y)) {
+        if (Planner_full(&dry) && Planner_next(&dry, &seg))
+            total += Traj_duration(&seg);
+        Planner_push(&dry, traj, x, y, feed);
+    }
+    while (Planner_next(&dry, &seg))
+        total += Traj_duration(&seg);
+    return total / 65536.0;
+}
+
+struct Axis {
+    Motor m;
+    Io io;
+    CtrlGains g;
+    double worstErr = 0, worstDrive = 0;
+    int32_t worstOut = 0;
+
+    void init(double kp, double kd, int32_t kv, int32_t ka, double pos)
+    {
+        Ctrl_setGainsShift(&g, CTRL_Q16(kp), CTRL_Q16(kd));
+        Ctrl_setFeedforward(&g, kv, ka);
+        m.pos = pos;
+    }
+
+    // what the feedforward model says the reference takes
+    void drive(int32_t kv, int32_t ka, int32_t velRef, int32_t accRef)
+    {
+        double u = kv / 65536.0 * velRef / 65536.0 + ka / 65536.0 * accRef / 256.0;
+
+        worstDrive = std::fmax(worstDrive, std::fabs(u));
+    }
+
+    void tick(int32_t posRef, int32_t velRef, int32_t accRef)
+    {
+        int32_t vel, out;
+
+        io.latch();
+        vel = io.tacho(m.vel);
+        out = Ctrl_outputShift(&g, posRef - io.encoder(m.pos), vel, velRef, accRef);
+        io.out = out;
+        if (std::abs(out - DAC_MID) > worstOut)
+            worstOut = std::abs(out - DAC_MID);
+        worstErr = std::fmax(worstErr, std::fabs(posRef / 65536.0 - m.pos));
+        m.run(io.dac);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    int32_t feed = (argc > 1 ? std::atoi(argv[1]) : TRAJ_FEEDRATE) * 65536L;
+    static Trajectory traj;
+    static Planner planner;
+    PathDecoder d;
+    TrajSegment seg;
+    Axis ax, ay;
+    int32_t x, y, lastX = 0, lastY = 0;
+    bool more = true;
+    double done = -1, settled = -1;
+    long k;
+
+    // start on the first point, as a job does after the move there
+    Path_open(&d, sidewindPath);
+    Path_next(&d, &x, &y);
+    Traj_init(&traj, x, y);
+    Planner_init(&planner, x, y);
+    ax.init(X_KP_COUNTS, X_KD_COUNTS, X_KV_DAC, X_KA_DAC, x / 65536.0);
+    ay.init(Y_KP_COUNTS, Y_KD_COUNTS, Y_KV_DAC, Y_KA_DAC, y / 65536.0);
+    ay.io.turn = true;
+    double est = estimate(&traj, feed);
+    Path_open(&d, sidewindPath);
+
+    for (k = 0; k * kTick < kMaxRun; k++) {
+        int moving = Traj_busy(&traj);
+
+        Traj_step(&traj);
+        if (!Traj_busy(&traj) && (Planner_full(&planner) || traj.vEnd || !more)
+                && Planner_next(&planner, &seg)) {
+            Traj_start(&traj, &seg);
+            moving = 1;
+        }
+        // a point a tick, as the stepper takes them off the segment queue
+        if (more && !Planner_full(&planner)) {
+            if (Path_next(&d, &x, &y)) {
+                Planner_push(&planner, &traj, x, y, feed);
+                lastX = x;
+                lastY = y;
+            } else {
+                more = false;
+            }
+        }
+
+        int32_t vx = moving ? traj.x.vel : 0, vy = moving ? traj.y.vel : 0;
+        int32_t accX = moving ? traj.x.acc : 0, accY = moving ? traj.y.acc : 0;
+        ax.drive(X_KV_DAC, X_KA_DAC, vx, accX);
+        ay.drive(Y_KV_DAC, Y_KA_DAC, vy, accY);
+        ax.tick(traj.x.pos, vx, accX);
+        ay.tick(traj.y.pos, vy, accY);
+
+        if (done < 0 && !more && !Traj_busy(&traj) && Planner_empty(&planner))
+            done = (k + 1) * kTick;
+        if (done >= 0) {
+            bool still = std::fabs(ax.m.pos - lastX / 65536.0) <= kEncoder
+                         && std::fabs(ay.m.pos - lastY / 65536.0) <= kEncoder;
+            if (!still)
+                settled = -1;
+            else if (settled < 0)
+                settled = (k + 1) * kTick;
+            if (settled >= 0 && (k + 1) * kTick - settled > 0.5)
+                break;
+        }
+    }
+    if (done < 0) {
+        std::fprintf(stderr, "jobtime: the plot did not finish in %.0f s\n", kMaxRun);
+        return 1;
+    }
+
+    std::printf("%d points at %.0f deg/s\n", SIDEWIND_POINTS, feed / 65536.0);
+    std::printf("estimate %.3f s, reference done %.3f s, axes settled %.3f s\n",
+                est, done, settled);
+    std::printf("old fixed slots %.1f s, %.2f times as long\n",
+                SIDEWIND_POINTS * kOldSlot, SIDEWIND_POINTS * kOldSlot / done);
+    std::printf("peak feedforward drive x %.0f y %.0f of %d counts, peak output x %d y %d\n",
+                ax.worstDrive, ay.worstDrive, X_DRIVE, ax.worstOut, ay.worstOut);
+    std::printf("worst tracking error x %.4f y %.4f deg\n", ax.worstErr, ay.worstErr);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ *  kintest.cpp
+ *
+ *  Host check of the screen to axis angle transform of kinematics.h.
+ *
+ *  Every point of a grid over the screen is turned into axis angles by
+ *  Kin_toAxes and by the exact formulas in double precision. The axis
+ *  error is the larger difference of the two angles, the screen error how
+ *  far from the point the beam lands at the angles Kin_toAxes gave. The
+ *  run fails if any axis error is over a tenth of an encoder count, which
+ *  the position loop could start to see.
+ *
+ *  The cost is timed on the host, for the whole call and for its square
+ *  root and arctangents on their own, and only shows how the parts
+ *  compare. On the target a __P2AMC_MODE_DEBUG build with
+ *  __P2AMC_MODE_CARTESIAN keeps the longest call in kinCycles.
+ *
+ *      gcc -O2 -c ../kinematics.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o kintest kintest.cpp kinematics.o qmath.o
+ *      ./kintest [-d distance] [-g gain] [-r range] [-s step]
+ *
+ *  The defaults are KIN_DISTANCE and KIN_OPTICAL_GAIN, and a range of
+ *  0.8 of the distance either way at a step of 0.7 screen units.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "../kinematics.h"
+#include "../qmath.h"
+}
+
+static const double kPi = 3.14159265358979323846;
+static const double kEncoder = 360.0 / 2048;    // degrees per count
+static const double kMaxErr = kEncoder / 10;
+static const long kCalls = 2000000;
+
+static int32_t q16(double v)
+{
+    return static_cast<int32_t>(std::lround(v * 65536.0));
+}
+
+// ns per call of f over kCalls spread out inputs
+template <typename F>
+static double timeIt(F f)
+{
+    volatile int32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < kCalls; i++)
+        sink = sink + f(static_cast<int32_t>(i * 37 % 26214400 - 13107200),
+                        static_cast<int32_t>(i * 53 % 26214400 - 13107200));
+    std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+    return t.count() / kCalls;
+}
+
+int main(int argc, char **argv)
+{
+    double dist = KIN_DISTANCE, gain = KIN_OPTICAL_GAIN, range = -1, step = 0.7;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "-d"))
+            dist = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-g"))
+            gain = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-r"))
+            range = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-s"))
+            step = std::atof(argv[i + 1]);
+    }
+    if (argc % 2 == 0 || dist <= 0 || gain < 1 || step <= 0) {
+        std::fprintf(stderr, "usage: kintest [-d distance] [-g gain] [-r range] [-s step]\n");
+        return 2;
+    }
+    if (range < 0)
+        range = 0.8 * dist;
+
+    Kinematics k;
+    Kin_init(&k, q16(dist), static_cast<uint16_t>(gain));
+
+    double axisErr = 0, screenErr = 0, atX = 0, atY = 0;
+    long points = 0;
+    for (double x = -range; x <= range; x += step) {
+        for (double y = -range; y <= range; y += step) {
+            int32_t ax, ay;
+            Kin_toAxes(&k, q16(x), q16(y), &ax, &ay);
+
+            // exact angles in degrees, and where the beam lands at ours
+            double ex = std::atan(x / dist) * 180 / kPi / gain;
+            double ey = std::atan(y / std::hypot(dist, x)) * 180 / kPi / gain;
+            double ox = ax / 65536.0 * gain * kPi / 180, oy = ay / 65536.0 * gain * kPi / 180;
+            double sx = dist * std::tan(ox), sy = std::hypot(dist, sx) * std::tan(oy);
+            double e = std::fmax(std::fabs(ax / 65536.0 - ex), std::fabs(ay / 65536.0 - ey));
+
+            if (e > axisErr) {
+                axisErr = e;
+                atX = x;
+                atY = y;
+            }
+            screenErr = std::fmax(screenErr, std::hypot(sx - x, sy - y));
+            points++;
+        }
+    }
+
+    std::printf("%ld points over +-%.1f at distance %.1f, gain %.0f\n", points, range, dist, gain);
+    std::printf("worst axis error %.6f deg at %.1f %.1f, %.0f ULP Q16, %.4f encoder counts\n",
+                axisErr, atX, atY, axisErr * 65536, axisErr / kEncoder);
+    std::printf("worst screen error %.5f units\n", screenErr);
+
+    double whole = timeIt([&](int32_t x, int32_t y) {
+        int32_t ax, ay;
+        Kin_toAxes(&k, x, y, &ax, &ay);
+        return ax + ay;
+    });
+    double root = timeIt([&](int32_t x, int32_t) {
+        return static_cast<int32_t>(isqrt64(static_cast<uint64_t>(
+            static_cast<int64_t>(k.dist) * k.dist + static_cast<int64_t>(x) * x)));
+    });
+    double atan = timeIt([&](int32_t x, int32_t) { return qatan_lut(x, k.dist); });
+    std::printf("host cost per call %.1f ns: isqrt64 %.1f ns, qatan_lut %.1f ns twice\n",
+                whole, root, atan);
+
+    if (axisErr > kMaxErr) {
+        std::printf("over the %.4f deg limit\n", kMaxErr);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,325 @@
+/*
+ *  lqrgen.cpp
+ *
+ *  Host tool that designs the state space control law of statespace.h
+ *  and writes its matrices out as a firmware header.
+ *
+ *  Each axis is the motor and gearbox driven by the DAC:
+ *
+ *      pos' = vel
+ *      vel' = (u - kv vel) / ka
+ *
+ *  with kv and ka in DAC counts per deg/s and per deg/s^2 as in
+ *  trajectory.h. The timer writes the two DACs in turn, so an axis takes
+ *  an output every other tick, a tick after it was worked out, and holds
+ *  it for two. The model is discretised exactly at the control tick for
+ *  the estimator, which runs every tick, and over the two tick period of
+ *  the DAC for the LQR gain, with the value the DAC holds over the first
+ *  tick as a third state and the new output acting over the second. The
+ *  LQR gain comes from the discrete Riccati equation on that three state
+ *  model, the estimator gain from the dual one on the two state plant
+ *  measured by the encoder. Each matrix is scaled to the largest Q format
+ *  its entries fit in.
+ *
+ *  The design is then checked against the PD law with the gains of
+ *  control.h, both with the same feedforward, on the axis of axissim.h:
+ *  the DACs written in turn, the encoder and the tachometer the PD law
+ *  takes its velocity from. The quantised matrices run through
+ *  statespace.c, and the comparison is printed.
+ *
+ *      gcc -O2 -c ../statespace.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o lqrgen lqrgen.cpp statespace.o control.o qmath.o
+ *      ./lqrgen [-x kv,ka] [-y kv,ka] [-q pos,vel,u] [-r r] [-n vel,enc] > ../ss_gains.h
+ *
+ *  -q and -r are the LQR weights on the state errors, degrees, deg/s and
+ *  DAC counts, and on the output. -n is the process noise on the velocity,
+ *  deg/s per tick, and the encoder noise in degrees, for the estimator.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../statespace.h"
+}
+
+using namespace axissim;
+
+typedef std::vector<std::vector<double> > Mat;
+
+// PD gains from control.h, for the comparison
+static const double kPdKp[2] = { X_KP_COUNTS, Y_KP_COUNTS };
+static const double kPdKd[2] = { X_KD_COUNTS, Y_KD_COUNTS };
+
+static Mat zeros(std::size_t r, std::size_t c)
+{
+    return Mat(r, std::vector<double>(c, 0.0));
+}
+
+static Mat mul(const Mat &a, const Mat &b)
+{
+    Mat c = zeros(a.size(), b[0].size());
+    for (std::size_t i = 0; i < a.size(); i++)
+        for (std::size_t j = 0; j < b[0].size(); j++)
+            for (std::size_t k = 0; k < b.size(); k++)
+                c[i][j] += a[i][k] * b[k][j];
+    return c;
+}
+
+static Mat trans(const Mat &a)
+{
+    Mat t = zeros(a[0].size(), a.size());
+    for (std::size_t i = 0; i < a.size(); i++)
+        for (std::size_t j = 0; j < a[0].size(); j++)
+            t[j][i] = a[i][j];
+    return t;
+}
+
+static Mat add(const Mat &a, const Mat &b, double s = 1.0)
+{
+    Mat c = a;
+    for (std::size_t i = 0; i < a.size(); i++)
+        for (std::size_t j = 0; j < a[0].size(); j++)
+            c[i][j] += s * b[i][j];
+    return c;
+}
+
+static Mat scale(const Mat &a, double s)
+{
+    return add(zeros(a.size(), a[0].size()), a, s);
+}
+
+struct Design {
+    Mat ad, bd;     // 2 x 2, 2 x 1, a tick
+    Mat k;          // 1 x 3, two ticks
+    Mat m;          // 2 x 1
+};
+
+/*
+ * Both Riccati equations have a single input or output, so the inverse is
+ * a division. Iterated to convergence, they are small and well damped.
+ */
+static Design design(double kv, double ka, const double q[3], double r,
+                     double procVel, double enc)
+{
+    Design d;
+    double a = kv / ka, e = std::exp(-a * kTick);
+
+    d.ad = Mat{ { 1, (1 - e) / a }, { 0, e } };
+    d.bd = Mat{ { (kTick - (1 - e) / a) / kv }, { (1 - e) / kv } };
+
+    // over the two ticks, the held value for one and the new output for
+    // the other, which is then held
+    Mat ad2 = mul(d.ad, d.ad), bHeld = mul(d.ad, d.bd);
+    Mat A = Mat{ { ad2[0][0], ad2[0][1], bHeld[0][0] },
+                 { ad2[1][0], ad2[1][1], bHeld[1][0] },
+                 { 0, 0, 0 } };
+    Mat B = Mat{ { d.bd[0][0] }, { d.bd[1][0] }, { 1 } };
+    Mat Q = zeros(3, 3), P;
+    for (int i = 0; i < 3; i++)
+        Q[i][i] = 1.0 / (q[i] * q[i]);
+    double R = 1.0 / (r * r);
+    P = Q;
+    for (int it = 0; it < 100000; it++) {
+        Mat PB = mul(P, B), BtPA = mul(trans(B), mul(P, A));
+        double s = R + mul(trans(B), PB)[0][0];
+        Mat next = add(add(Q, mul(trans(A), mul(P, A))),
+                       mul(mul(trans(A), PB), BtPA), -1.0 / s);
+        double diff = 0;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                diff = std::fmax(diff, std::fabs(next[i][j] - P[i][j]));
+        P = next;
+        if (diff < 1e-12 * std::fabs(P[0][0]))
+            break;
+    }
+    {
+        Mat PB = mul(P, B);
+        double s = R + mul(trans(B), PB)[0][0];
+        d.k = scale(mul(trans(B), mul(P, A)), 1.0 / s);
+    }
+
+    // estimator, prior covariance of the two state plant
+    Mat C = Mat{ { 1, 0 } }, W = Mat{ { 0, 0 }, { 0, procVel * procVel } };
+    double V = enc * enc;
+    P = W;
+    for (int it = 0; it < 100000; it++) {
+        Mat PC = mul(P, trans(C));
+        double s = V + mul(C, PC)[0][0];
+        Mat post = add(P, mul(PC, trans(PC)), -1.0 / s);
+        Mat next = add(mul(d.ad, mul(post, trans(d.ad))), W);
+        double diff = std::fabs(next[0][0] - P[0][0]) + std::fabs(next[1][1] - P[1][1]);
+        P = next;
+        if (diff < 1e-15 * std::fabs(P[1][1]))
+            break;
+    }
+    {
+        Mat PC = mul(P, trans(C));
+        d.m = scale(PC, 1.0 / (V + mul(C, PC)[0][0]));
+    }
+    return d;
+}
+
+struct Fixed {
+    int q;
+    std::vector<long> v;
+};
+
+// largest Q format, up to 30, that holds every entry
+static Fixed toFixed(const Mat &a)
+{
+    Fixed f;
+    double big = 0;
+    for (const auto &row : a)
+        for (double x : row)
+            big = std::fmax(big, std::fabs(x));
+    f.q = 30;
+    while (f.q > 0 && std::ldexp(big, f.q) >= 2147483647.0)
+        f.q--;
+    for (const auto &row : a)
+        for (double x : row)
+            f.v.push_back(std::lround(std::ldexp(x, f.q)));
+    return f;
+}
+
+/*
+ *  ======== comparison ========
+ */
+
+struct Score {
+    double overshoot, settle, rms;
+};
+
+/*
+ * 10 degree step, then a 10 degree 2 Hz sine, from the same plant and
+ * feedforward, with the law either PD (model == nullptr) or the quantised
+ * state space design. The y axis takes its outputs on the other ticks.
+ */
+static Score simulate(double kv, double ka, int axis, const SsModel *model)
+{
+    Score sc{ 0, 0, 0 };
+    for (int run = 0; run < 2; run++) {
+        Motor m;
+        Io io;
+        CtrlGains g;
+        StateSpace ss;
+        double sum = 0;
+        int n = run ? 400 : 200;
+
+        m.kv = kv;
+        m.ka = ka;
+        io.turn = axis != 0;
+        Ctrl_setGainsShift(&g, CTRL_Q16(kPdKp[axis]), CTRL_Q16(kPdKd[axis]));
+        Ctrl_setFeedforward(&g, q16(kv), q16(ka));
+        if (model)
+            SS_init(&ss, model, 0, q16(kv), q16(ka));
+        for (int k = 0; k < n; k++) {
+            double t = k * kTick, w = 2 * kPi * 2;
+            double ref = run ? 10 * std::sin(w * t) : 10;
+            double vRef = run ? 10 * w * std::cos(w * t) : 0;
+            double aRef = run ? -10 * w * w * std::sin(w * t) : 0;
+            int32_t accRef = static_cast<int32_t>(std::floor(aRef * 256)), pos, vel;
+
+            io.latch();
+            pos = io.encoder(m.pos);
+            vel = io.tacho(m.vel);
+            if (!model)
+                io.out = Ctrl_outputShift(&g, q16(ref) - pos, vel, q16(vRef), accRef);
+            else
+                io.out = SS_output(&ss, pos, q16(ref), q16(vRef), accRef, !io.turn);
+            if (!run) {
+                sc.overshoot = std::fmax(sc.overshoot, m.pos - 10);
+                if (std::fabs(m.pos - 10) > 0.2)
+                    sc.settle = (k + 1) * kTick;
+            } else {
+                sum += (m.pos - ref) * (m.pos - ref);
+            }
+            m.run(io.dac);
+        }
+        if (run)
+            sc.rms = std::sqrt(sum / n);
+    }
+    return sc;
+}
+
+static void writeMatrix(const char *axis, const char *name, const Fixed &f)
+{
+    std::fprintf(stdout, "const int32_t %sSs%s[%u] = {", axis, name,
+                 static_cast<unsigned>(f.v.size()));
+    for (std::size_t i = 0; i < f.v.size(); i++)
+        std::fprintf(stdout, "%s%ldL", i ? ", " : " ", f.v[i]);
+    std::fprintf(stdout, " };\n");
+}
+
+static bool pair(const char *s, double *a, double *b)
+{
+    return std::sscanf(s, "%lf,%lf", a, b) == 2 && *a > 0 && *b > 0;
+}
+
+int main(int argc, char **argv)
+{
+    double kv[2] = { 1.92, 1.92 }, ka[2] = { 0.0555, 0.0555 };
+    double q[3] = { 1, 50, 400 }, r = 400, procVel = 2, enc = kEncoder / std::sqrt(12.0);
+    const char *axis[2] = { "x", "y" };
+    int i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        bool ok = true;
+        if (!std::strcmp(argv[i], "-x"))
+            ok = pair(argv[i + 1], &kv[0], &ka[0]);
+        else if (!std::strcmp(argv[i], "-y"))
+            ok = pair(argv[i + 1], &kv[1], &ka[1]);
+        else if (!std::strcmp(argv[i], "-q"))
+            ok = std::sscanf(argv[i + 1], "%lf,%lf,%lf", &q[0], &q[1], &q[2]) == 3;
+        else if (!std::strcmp(argv[i], "-r"))
+            ok = (r = std::atof(argv[i + 1])) > 0;
+        else if (!std::strcmp(argv[i], "-n"))
+            ok = pair(argv[i + 1], &procVel, &enc);
+        else
+            break;
+        if (!ok)
+            break;
+    }
+    if (i != argc) {
+        std::fprintf(stderr, "usage: lqrgen [-x kv,ka] [-y kv,ka] [-q pos,vel,u] [-r r] "
+                             "[-n vel,enc] > header\n");
+        return 2;
+    }
+
+    std::fprintf(stdout, "// this is generated by tools/lqrgen\n");
+    std::fprintf(stdout, "// state space gains for the axes, see statespace.h\n");
+    for (int a = 0; a < 2; a++) {
+        Design d = design(kv[a], ka[a], q, r, procVel, enc);
+        Mat g = Mat{ { d.ad[0][0], d.ad[0][1], d.bd[0][0] },
+                     { d.ad[1][0], d.ad[1][1], d.bd[1][0] } };
+        Fixed fx[3] = { toFixed(g), toFixed(d.m), toFixed(d.k) };
+        std::vector<int32_t> v[3];
+        for (int i = 0; i < 3; i++)
+            v[i].assign(fx[i].v.begin(), fx[i].v.end());
+        SsModel model = { { 2, 3, static_cast<uint16_t>(fx[0].q), v[0].data() },
+                          { 2, 1, static_cast<uint16_t>(fx[1].q), v[1].data() },
+                          { 1, 3, static_cast<uint16_t>(fx[2].q), v[2].data() } };
+
+        std::fprintf(stdout, "// kv %g, ka %g\n", kv[a], ka[a]);
+        writeMatrix(axis[a], "G", fx[0]);
+        writeMatrix(axis[a], "M", fx[1]);
+        writeMatrix(axis[a], "K", fx[2]);
+        std::fprintf(stdout, "const SsModel %sSsModel = { { 2, 3, %d, %sSsG }, "
+                             "{ 2, 1, %d, %sSsM }, { 1, 3, %d, %sSsK } };\n",
+                     axis[a], fx[0].q, axis[a], fx[1].q, axis[a], fx[2].q, axis[a]);
+
+        std::fprintf(stderr, "%s: K = [%.3f %.4f %.4f], M = [%.4f %.3f]\n", axis[a],
+                     d.k[0][0], d.k[0][1], d.k[0][2], d.m[0][0], d.m[1][0]);
+        Score pd = simulate(kv[a], ka[a], a, nullptr), ss = simulate(kv[a], ka[a], a, &model);
+        std::fprintf(stderr, "  PD:  step overshoot %.3f deg, settles in %.0f ms, sine rms %.4f deg\n",
+                     pd.overshoot, pd.settle * 1000, pd.rms);
+        std::fprintf(stderr, "  LQR: step overshoot %.3f deg, settles in %.0f ms, sine rms %.4f deg\n",
+                     ss.overshoot, ss.settle * 1000, ss.rms);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ *  mracsim.cpp
+ *
+ *  Host simulation of the model reference adaptive control of mrac.h
+ *  against the PD law with feedforward.
+ *
+ *  The x axis of axissim.h follows a 15 degree 0.7 Hz sine with a 4
+ *  degree 1.9 Hz one on top, under each law in turn, for a list of loads
+ *  that put the plant off the feedforward model. The tracking error is
+ *  taken as rms over the first 5 s and the last 5 s of the run, with the
+ *  estimates and bound hits MRAC ended on. Then the nominal axis makes a
+ *  2 degree step and sits at rest, and how far the estimates moved over
+ *  the step and then drifted at rest is printed.
+ *
+ *      gcc -O2 -c ../mrac.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o mracsim mracsim.cpp mrac.o control.o qmath.o
+ *      ./mracsim [seconds [rest seconds]]
+ *
+ *  The runs are 60 s and the rest 1200 s by default.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../mrac.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+// back EMF and inertia of the plant against the feedforward model
+static const double kLoads[][2] = {
+    { 1, 1 }, { 0.9, 0.8 }, { 1, 2 }, { 1, 3 }, { 1.3, 3 }, { 0.8, 0.6 }, { 1, 6 }
+};
+
+static const double kWindow = 5;    // seconds
+
+struct Run {
+    double early, late;
+};
+
+// the reference at t, degrees, deg/s and deg/s^2
+static void sines(double t, double *p, double *v, double *a)
+{
+    double w1 = 2 * kPi * 0.7, w2 = 2 * kPi * 1.9;
+
+    *p = 15 * std::sin(w1 * t) + 4 * std::sin(w2 * t);
+    *v = 15 * w1 * std::cos(w1 * t) + 4 * w2 * std::cos(w2 * t);
+    *a = -15 * w1 * w1 * std::sin(w1 * t) - 4 * w2 * w2 * std::sin(w2 * t);
+}
+
+static void step(double t, double *p, double *v, double *a)
+{
+    *p = t > 1 ? 2 : 0;
+    *v = 0;
+    *a = 0;
+}
+
+template <typename Ref>
+static Run run(bool mrac, Ref ref, double seconds, double kv, double ka, Mrac *mr)
+{
+    Motor m;
+    Io io;
+    CtrlGains g;
+    double early = 0, late = 0;
+    long n = static_cast<long>(seconds / kTick), ne = 0, nl = 0;
+
+    m.kv *= kv;
+    m.ka *= ka;
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, X_KV_DAC, X_KA_DAC);
+    Mrac_init(mr, 0, X_KV_DAC, X_KA_DAC);
+
+    for (long k = 0; k < n; k++) {
+        double t = k * kTick, p, v, a, e;
+        int32_t pos, vel, posRef, velRef, accRef;
+
+        ref(t, &p, &v, &a);
+        posRef = q16(p);
+        velRef = q16(v);
+        accRef = static_cast<int32_t>(std::floor(a * 256));
+        io.latch();
+        pos = io.encoder(m.pos);
+        vel = io.tacho(m.vel);
+        if (mrac)
+            io.out = Mrac_output(mr, pos, vel, posRef, velRef, accRef);
+        else
+            io.out = Ctrl_outputShift(&g, posRef - pos, vel, velRef, accRef);
+
+        e = p - m.pos;
+        if (t > 1 && t < 1 + kWindow) {
+            early += e * e;
+            ne++;
+        }
+        if (t > seconds - kWindow) {
+            late += e * e;
+            nl++;
+        }
+        m.run(io.dac);
+    }
+    return Run{ std::sqrt(early / ne), std::sqrt(late / nl) };
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 60;
+    double rest = argc > 2 ? std::atof(argv[2]) : 1200;
+    Mrac mr;
+
+    if (seconds < 2 * kWindow || rest < 2 * kWindow) {
+        std::fprintf(stderr, "usage: mracsim [seconds [rest seconds]], at least %.0f s\n",
+                     2 * kWindow);
+        return 2;
+    }
+
+    std::printf("15 deg 0.7 Hz and 4 deg 1.9 Hz sines for %.0f s, rms error in deg\n", seconds);
+    std::printf("  kv    ka      PD      MRAC first  MRAC last   ka x    kv x   bound hits\n");
+    for (const double *l : kLoads) {
+        Run pd = run(false, sines, seconds, l[0], l[1], &mr);
+        Run ad = run(true, sines, seconds, l[0], l[1], &mr);
+
+        std::printf("  x%.1f  x%.1f  %7.3f  %10.3f %10.3f  %6.2f  %6.2f   %u/%u\n",
+                    l[0], l[1], pd.late, ad.early, ad.late,
+                    static_cast<double>(mr.ka) / X_KA_DAC, static_cast<double>(mr.kv) / X_KV_DAC,
+                    mr.clampA, mr.clampV);
+    }
+
+    run(true, step, 2 * kWindow, 1, 1, &mr);
+    int32_t ka = mr.ka, kv = mr.kv;
+    run(true, step, rest, 1, 1, &mr);
+    std::printf("2 deg step: ka %+.3f%%, kv %+.3f%% of nominal, then %.0f s at rest: "
+                "%+.3f%%, %+.3f%% more\n",
+                100.0 * (ka - X_KA_DAC) / X_KA_DAC, 100.0 * (kv - X_KV_DAC) / X_KV_DAC, rest,
+                100.0 * (mr.ka - ka) / X_KA_DAC, 100.0 * (mr.kv - kv) / X_KV_DAC);
+    return 0;
+}
@@ -0,0 +1,605 @@
+/*
+ *  pathc.cpp
+ *
+ *  Host path compiler, turns a G-code drawing into a firmware plot header.
+ *
+ *  Every run of G1/G2/G3/G5 moves between G0 rapids is a stroke, with the
+ *  arcs and Beziers broken into chords as curve.c breaks them. The strokes
+ *  are simplified with Ramer-Douglas-Peucker, then put in an order and
+ *  direction that keeps the travel between them short: greedy nearest
+ *  neighbour tours from a few starting strokes are improved with 2-opt,
+ *  and the shortest wins. Both only look at the closest stroke ends to
+ *  each end, found once up front, so a pass is linear in the strokes
+ *  rather than quadratic. Finding those and the tours are shared out
+ *  over the threads. The result is written in the compact format of
+ *  path.h, see pathformat.h.
+ *
+ *  The firmware has no pen lift so the travel moves are drawn as straight
+ *  lines, and it plots at one feedrate so F words are ignored.
+ *
+ *      g++ -std=c++11 -O2 -pthread -o pathc pathc.cpp
+ *      ./pathc [-e tol] [-t tol] [-j threads] name < drawing.gcode > ../plot_name.h
+ *
+ *  -e is the simplification and arc chord tolerance in degrees (default
+ *  0.01), -t the encoding tolerance as for pathenc.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pathformat.h"
+
+using pathformat::Point;
+typedef std::vector<Point> Stroke;
+
+static const double kPi = 3.14159265358979323846;
+
+// 2-opt passes over the whole tour before settling for what it has
+static const int kMaxPasses = 50;
+
+// closest stroke ends kept for each end, and strokes the tours start from
+static const std::size_t kNeighbours = 16;
+static const std::size_t kStarts = 4;
+
+// firmware curve.h, chord error and most Bezier chords as a power of 2
+static const double kCurveTol = 655 / 65536.0;
+static const int kBezierMaxShift = 8;
+
+/*
+ *  ======== G-code ========
+ */
+
+struct Parser {
+    std::vector<Stroke> strokes;
+    Stroke current;
+    Point pos{0, 0};
+    int motion = 0;
+    bool relative = false;
+    double tol = 0.01;
+    int line = 0;
+    int errors = 0;
+
+    void endStroke()
+    {
+        if (current.size() > 1)
+            strokes.push_back(current);
+        current.clear();
+    }
+
+    void drawTo(Point p)
+    {
+        if (current.empty())
+            current.push_back(pos);
+        current.push_back(p);
+    }
+
+    void arc(Point end, double i, double j, bool cw)
+    {
+        Point c{pos.x + i, pos.y + j};
+        double r = std::hypot(i, j);
+        double a0 = std::atan2(pos.y - c.y, pos.x - c.x);
+        double a1 = std::atan2(end.y - c.y, end.x - c.x);
+        double sweep = a1 - a0;
+
+        if (cw && sweep >= 0)
+            sweep -= 2 * kPi;
+        if (!cw && sweep <= 0)
+            sweep += 2 * kPi;
+        // chord angle that keeps the sagitta within tol
+        double step = r > tol ? 2 * std::acos(1 - tol / r) : kPi / 2;
+        int n = std::max(1, static_cast<int>(std::ceil(std::fabs(sweep) / step)));
+        for (int k = 1; k < n; k++) {
+            double a = a0 + sweep * k / n;
+            drawTo(Point{c.x + r * std::cos(a), c.y + r * std::sin(a)});
+        }
+        drawTo(end);
+    }
+
+    // G5, the control points are offsets from the start and from the end,
+    // stepped in 2^k chords chosen as Curve_bezier chooses them
+    void bezier(Point end, double i, double j, double p, double q)
+    {
+        Point p0 = pos, p1{pos.x + i, pos.y + j}, p2{end.x + p, end.y + q};
+        double bend = std::max(std::fabs(p0.x - 2 * p1.x + p2.x),
+                               std::fabs(p1.x - 2 * p2.x + end.x))
+                    + std::max(std::fabs(p0.y - 2 * p1.y + p2.y),
+                               std::fabs(p1.y - 2 * p2.y + end.y));
+        int k = 0;
+
+        while (k < kBezierMaxShift && kCurveTol * (4 << (2 * k)) < bend * 3)
+            k++;
+        int n = 1 << k;
+        for (int m = 1; m < n; m++) {
+            double t = static_cast<double>(m) / n, u = 1 - t;
+            double a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+            drawTo(Point{a * p0.x + b * p1.x + c * p2.x + d * end.x,
+                         a * p0.y + b * p1.y + c * p2.y + d * end.y});
+        }
+        drawTo(end);
+    }
+
+    static double word(const double *val, const bool *has, char letter)
+    {
+        return has[letter - 'A'] ? val[letter - 'A'] : 0;
+    }
+
+    void execute(const std::string &text)
+    {
+        double val[26];
+        bool has[26] = {false};
+        int g = -1;
+        std::size_t k = 0;
+
+        while (k < text.size()) {
+            char ch = static_cast<char>(std::toupper(static_cast<unsigned char>(text[k])));
+            if (ch == ' ' || ch == '\t' || ch == '\r') {
+                k++;
+                continue;
+            }
+            if (ch < 'A' || ch > 'Z') {
+                errors++;
+                return;
+            }
+            const char *start = text.c_str() + k + 1;
+            char *stop;
+            double v = std::strtod(start, &stop);
+            if (stop == start) {
+                errors++;
+                return;
+            }
+            k = stop - text.c_str();
+            if (ch == 'G') {
+                int code = static_cast<int>(v);
+                if (code <= 3 || code == 5)
+                    g = code;
+                else if (code == 90 || code == 91)
+                    relative = code == 91;
+                else if (code != 17 && code != 21 && code != 94)
+                    errors++;
+            } else {
+                val[ch - 'A'] = v;
+                has[ch - 'A'] = true;
+            }
+        }
+        if (g >= 0)
+            motion = g;
+
+        bool hx = has['X' - 'A'], hy = has['Y' - 'A'];
+        bool arcs = motion == 2 || motion == 3;
+        if (!hx && !hy && !(arcs && (has['I' - 'A'] || has['J' - 'A'])))
+            return;
+        if (arcs && !has['I' - 'A'] && !has['J' - 'A'])
+            return;
+        Point end = pos;
+        if (hx)
+            end.x = relative ? pos.x + val['X' - 'A'] : val['X' - 'A'];
+        if (hy)
+            end.y = relative ? pos.y + val['Y' - 'A'] : val['Y' - 'A'];
+
+        if (motion == 0)
+            endStroke();
+        else if (motion == 1)
+            drawTo(end);
+        else if (motion == 5)
+            bezier(end, word(val, has, 'I'), word(val, has, 'J'), word(val, has, 'P'),
+                   word(val, has, 'Q'));
+        else
+            arc(end, word(val, has, 'I'), word(val, has, 'J'), motion == 2);
+        pos = end;
+    }
+
+    void parse(std::istream &in)
+    {
+        std::string raw;
+        while (std::getline(in, raw)) {
+            std::string text;
+            bool paren = false;
+            line++;
+            for (char c : raw) {
+                if (paren) {
+                    paren = c != ')';
+                } else if (c == '(') {
+                    paren = true;
+                } else if (c == ';') {
+                    break;
+                } else {
+                    text += c;
+                }
+            }
+            execute(text);
+        }
+        endStroke();
+    }
+};
+
+/*
+ *  ======== Simplification ========
+ */
+
+static double segmentDistance(Point p, Point a, Point b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+    t = std::min(1.0, std::max(0.0, t));
+    return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+// Ramer-Douglas-Peucker with an explicit stack, long strokes would
+// otherwise recurse once per point
+static Stroke simplify(const Stroke &s, double tol)
+{
+    std::vector<char> keep(s.size(), 0);
+    std::vector<std::pair<std::size_t, std::size_t> > todo;
+
+    keep.front() = keep.back() = 1;
+    todo.push_back(std::make_pair(std::size_t(0), s.size() - 1));
+    while (!todo.empty()) {
+        std::size_t a = todo.back().first, b = todo.back().second;
+        todo.pop_back();
+        double worst = 0;
+        std::size_t at = a;
+        for (std::size_t i = a + 1; i < b; i++) {
+            double d = segmentDistance(s[i], s[a], s[b]);
+            if (d > worst) {
+                worst = d;
+                at = i;
+            }
+        }
+        if (worst > tol) {
+            keep[at] = 1;
+            todo.push_back(std::make_pair(a, at));
+            todo.push_back(std::make_pair(at, b));
+        }
+    }
+
+    Stroke out;
+    for (std::size_t i = 0; i < s.size(); i++)
+        if (keep[i])
+            out.push_back(s[i]);
+    return out;
+}
+
+/*
+ *  ======== Stroke ordering ========
+ */
+
+struct Leg {
+    std::size_t stroke;
+    bool reversed;
+};
+
+struct Tour {
+    std::vector<Leg> legs;
+    double travel;
+};
+
+/*
+ * The ends of stroke s are numbered 2s for its first point and 2s + 1 for
+ * its last, home is the number after them all. near holds the closest
+ * ends to each, nearest first, leaving out the other end of the same
+ * stroke that travel never goes to.
+ */
+struct Ends {
+    std::vector<Point> at;
+    std::vector<std::vector<std::size_t> > near;
+
+    std::size_t startOf(const Leg &l) const { return 2 * l.stroke + l.reversed; }
+    std::size_t endOf(const Leg &l) const { return 2 * l.stroke + !l.reversed; }
+    Point start(const Leg &l) const { return at[startOf(l)]; }
+    Point end(const Leg &l) const { return at[endOf(l)]; }
+};
+
+static double dist(Point a, Point b)
+{
+    return std::hypot(a.x - b.x, a.y - b.y);
+}
+
+template <typename F>
+static void parallelFor(std::size_t n, unsigned threads, F f)
+{
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.push_back(std::thread([&]() {
+            for (std::size_t i = next++; i < n; i = next++)
+                f(i);
+        }));
+    }
+    for (std::thread &t : pool)
+        t.join();
+}
+
+// the ends sorted by x, each looks outwards from itself until the ends
+// left are further off in x alone than the furthest it has kept
+static Ends findEnds(const std::vector<Stroke> &strokes, Point home, unsigned threads)
+{
+    Ends e;
+    for (const Stroke &s : strokes) {
+        e.at.push_back(s.front());
+        e.at.push_back(s.back());
+    }
+    e.at.push_back(home);
+    std::size_t ends = 2 * strokes.size();
+    e.near.resize(ends + 1);
+
+    std::vector<std::size_t> byX(ends + 1), rank(ends + 1);
+    for (std::size_t i = 0; i <= ends; i++)
+        byX[i] = i;
+    std::sort(byX.begin(), byX.end(),
+              [&](std::size_t a, std::size_t b) { return e.at[a].x < e.at[b].x; });
+    for (std::size_t i = 0; i <= ends; i++)
+        rank[byX[i]] = i;
+
+    parallelFor(ends + 1, threads, [&](std::size_t k) {
+        std::vector<std::pair<double, std::size_t> > best;
+        Point p = e.at[k];
+        auto consider = [&](std::size_t i) {
+            double dx = e.at[i].x - p.x, dy = e.at[i].y - p.y, d = dx * dx + dy * dy;
+            if (i == ends || i / 2 == k / 2 || (best.size() == kNeighbours && d >= best.back().first))
+                return;
+            if (best.size() == kNeighbours)
+                best.pop_back();
+            best.insert(std::upper_bound(best.begin(), best.end(), std::make_pair(d, i)),
+                        std::make_pair(d, i));
+        };
+        auto far = [&](std::size_t i) {
+            double dx = e.at[i].x - p.x;
+            return best.size() == kNeighbours && dx * dx >= best.back().first;
+        };
+        std::size_t lo = rank[k], hi = rank[k] + 1;
+        while (lo > 0 || hi <= ends) {
+            if (lo > 0 && far(byX[lo - 1]))
+                lo = 0;
+            if (hi <= ends && far(byX[hi]))
+                hi = ends + 1;
+            if (lo > 0)
+                consider(byX[--lo]);
+            if (hi <= ends)
+                consider(byX[hi++]);
+        }
+        for (const std::pair<double, std::size_t> &b : best)
+            e.near[k].push_back(b.second);
+    });
+    return e;
+}
+
+static double travel(const Ends &e, const std::vector<Leg> &legs, Point home)
+{
+    double d = 0;
+    Point at = home;
+    for (const Leg &l : legs) {
+        d += dist(at, e.start(l));
+        at = e.end(l);
+    }
+    return d;
+}
+
+// the closest free end is nearly always on the neighbour list, only once
+// all of those are taken does it look through every stroke
+static std::vector<Leg> nearestNeighbour(const Ends &e, Leg first)
+{
+    std::size_t n = e.at.size() / 2;
+    std::vector<char> used(n, 0);
+    std::vector<Leg> legs;
+
+    legs.push_back(first);
+    used[first.stroke] = 1;
+    for (std::size_t k = 1; k < n; k++) {
+        std::size_t from = e.endOf(legs.back());
+        Point at = e.at[from];
+        double best = HUGE_VAL;
+        Leg next{0, false};
+        bool found = false;
+        for (std::size_t q : e.near[from]) {
+            if (!used[q / 2]) {
+                next = Leg{q / 2, (q & 1) != 0};
+                found = true;
+                break;
+            }
+        }
+        for (std::size_t i = 0; i < n && !found; i++) {
+            if (used[i])
+                continue;
+            double f = dist(at, e.at[2 * i]), r = dist(at, e.at[2 * i + 1]);
+            if (f < best) {
+                best = f;
+                next = Leg{i, false};
+            }
+            if (r < best) {
+                best = r;
+                next = Leg{i, true};
+            }
+        }
+        used[next.stroke] = 1;
+        legs.push_back(next);
+    }
+    return legs;
+}
+
+/*
+ * Reversing legs i..j flips each of them too, only the two travel moves at
+ * the ends of the run change length. For that to pay one of the two new
+ * moves has to be shorter than the one it replaces on its side, so it is
+ * enough to try joining each end to its neighbours closer than the move it
+ * makes now: the end before leg i to the end of leg j, or the start of
+ * leg j + 1 to the start of leg i.
+ */
+static void twoOpt(const Ends &e, std::vector<Leg> &legs, Point home)
+{
+    std::size_t n = legs.size(), homeEnd = e.at.size() - 1;
+    std::vector<std::size_t> slot(n);
+
+    for (std::size_t k = 0; k < n; k++)
+        slot[legs[k].stroke] = k;
+
+    // reverses i..j if that shortens the tour
+    auto tryMove = [&](std::size_t i, std::size_t j) {
+        Point before = i ? e.end(legs[i - 1]) : home;
+        Point si = e.start(legs[i]), ej = e.end(legs[j]);
+        double now = dist(before, si), then = dist(before, ej);
+        if (j + 1 < n) {
+            Point after = e.start(legs[j + 1]);
+            now += dist(ej, after);
+            then += dist(si, after);
+        }
+        if (then >= now - 1e-9)
+            return false;
+        std::reverse(legs.begin() + i, legs.begin() + j + 1);
+        for (std::size_t k = i; k <= j; k++) {
+            legs[k].reversed = !legs[k].reversed;
+            slot[legs[k].stroke] = k;
+        }
+        return true;
+    };
+
+    for (int pass = 0; pass < kMaxPasses; pass++) {
+        bool improved = false;
+        for (std::size_t i = 0; i < n; i++) {
+            std::size_t from = i ? e.endOf(legs[i - 1]) : homeEnd;
+            for (std::size_t q : e.near[from]) {
+                if (dist(e.at[from], e.at[q]) >= dist(e.at[from], e.start(legs[i])))
+                    break;
+                std::size_t j = slot[q / 2];
+                if (j >= i && q == e.endOf(legs[j]) && tryMove(i, j)) {
+                    improved = true;
+                    from = i ? e.endOf(legs[i - 1]) : homeEnd;
+                }
+            }
+            if (!i)
+                continue;
+            std::size_t to = e.startOf(legs[i]);
+            for (std::size_t q : e.near[to]) {
+                if (dist(e.at[to], e.at[q]) >= dist(e.at[to], e.end(legs[i - 1])))
+                    break;
+                std::size_t k = slot[q / 2];
+                if (k < i && q == e.startOf(legs[k]) && tryMove(k, i - 1)) {
+                    improved = true;
+                    to = e.startOf(legs[i]);
+                }
+            }
+        }
+        if (!improved)
+            break;
+    }
+}
+
+static Tour order(const std::vector<Stroke> &strokes, Point home, unsigned threads)
+{
+    Ends e = findEnds(strokes, home, threads);
+
+    // seed from the strokes closest to home, each in both directions
+    std::vector<Leg> seeds;
+    std::vector<std::size_t> idx(strokes.size());
+    for (std::size_t i = 0; i < idx.size(); i++)
+        idx[i] = i;
+    std::size_t tries = std::min(idx.size(), kStarts);
+    std::partial_sort(idx.begin(), idx.begin() + tries, idx.end(),
+                      [&](std::size_t a, std::size_t b) {
+                          return std::min(dist(home, e.at[2 * a]), dist(home, e.at[2 * a + 1])) <
+                                 std::min(dist(home, e.at[2 * b]), dist(home, e.at[2 * b + 1]));
+                      });
+    for (std::size_t k = 0; k < tries; k++) {
+        seeds.push_back(Leg{idx[k], false});
+        seeds.push_back(Leg{idx[k], true});
+    }
+
+    std::vector<Tour> tours(seeds.size());
+    parallelFor(seeds.size(), threads, [&](std::size_t k) {
+        tours[k].legs = nearestNeighbour(e, seeds[k]);
+        twoOpt(e, tours[k].legs, home);
+        tours[k].travel = travel(e, tours[k].legs, home);
+    });
+    return *std::min_element(tours.begin(), tours.end(),
+                             [](const Tour &a, const Tour &b) { return a.travel < b.travel; });
+}
+
+int main(int argc, char **argv)
+{
+    double tol = 0.01, encodeTol = 0.001;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!std::strcmp(argv[i], "-e"))
+            tol = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-t"))
+            encodeTol = std::atof(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-j"))
+            threads = std::max(1, std::atoi(argv[i + 1]));
+        else
+            break;
+    }
+    if (i != argc - 1 || tol <= 0) {
+        std::fprintf(stderr, "usage: pathc [-e tol] [-t tol] [-j threads] name < gcode > header\n");
+        return 2;
+    }
+    std::string name = argv[i];
+    auto t0 = std::chrono::steady_clock::now();
+
+    Parser parser;
+    parser.tol = tol;
+    parser.parse(std::cin);
+    std::vector<Stroke> &strokes = parser.strokes;
+    if (strokes.empty()) {
+        std::fprintf(stderr, "pathc: no drawing moves in the input\n");
+        return 1;
+    }
+    if (parser.errors)
+        std::fprintf(stderr, "pathc: %d bad lines ignored\n", parser.errors);
+
+    std::size_t before = 0, after = 0;
+    for (const Stroke &s : strokes)
+        before += s.size();
+    parallelFor(strokes.size(), threads, [&](std::size_t k) {
+        strokes[k] = simplify(strokes[k], tol);
+    });
+
+    Point home{0, 0};
+    double givenTravel = 0;
+    Point at = home;
+    for (const Stroke &s : strokes) {
+        givenTravel += dist(at, s.front());
+        at = s.back();
+    }
+    Tour tour = order(strokes, home, threads);
+
+    std::vector<Point> pts;
+    for (const Leg &l : tour.legs) {
+        const Stroke &s = strokes[l.stroke];
+        if (l.reversed)
+            pts.insert(pts.end(), s.rbegin(), s.rend());
+        else
+            pts.insert(pts.end(), s.begin(), s.end());
+    }
+    after = pts.size();
+    if (pts.size() > pathformat::kMaxPoints) {
+        std::fprintf(stderr, "pathc: %u points, the path format holds %u\n",
+                     static_cast<unsigned>(pts.size()),
+                     static_cast<unsigned>(pathformat::kMaxPoints));
+        return 1;
+    }
+
+    int shift = pathformat::chooseShift(pts, encodeTol);
+    std::vector<uint16_t> words = pathformat::pack(pathformat::encode(pts, shift), pts.size(), shift);
+    pathformat::writeHeader(stdout, name, "tools/pathc", words);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::fprintf(stderr, "%u strokes, %u points simplified to %u\n",
+                 static_cast<unsigned>(strokes.size()), static_cast<unsigned>(before),
+                 static_cast<unsigned>(after));
+    std::fprintf(stderr, "travel %.1f degrees, %.1f in the order given\n",
+                 tour.travel, givenTravel);
+    std::fprintf(stderr, "%u words encoded, %.1fx smaller than tables, %.0f ms on %u threads\n",
+                 static_cast<unsigned>(words.size()),
+                 static_cast<double>(pathformat::tableWords(pts.size())) / words.size(), ms, threads);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ *  pathenc.cpp
+ *
+ *  Host tool that packs a plot into the compact path format of path.h and
+ *  reports how much flash it saves over plain int32_t tables.
+ *
+ *  The input is either "x y" pairs in degrees, one point per line, or an
+ *  old style plot header with xPlots and yPlots tables. Build and run with
+ *
+ *      g++ -std=c++11 -O2 -o pathenc pathenc.cpp
+ *      ./pathenc [-r bits] [-t tol] name < plot.txt > ../plot_name.h
+ *
+ *  -r fixes the resolution at 2^-bits degrees, otherwise the coarsest one
+ *  that keeps every point within tol degrees (default 0.001) is used.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "pathformat.h"
+
+using pathformat::Point;
+
+// numbers between the braces that follow name
+static std::vector<double> table(const std::string &text, const std::string &name)
+{
+    std::vector<double> v;
+    std::size_t at = text.find(name);
+    if (at == std::string::npos)
+        return v;
+    std::size_t open = text.find('{', at), close = text.find('}', open);
+    if (open == std::string::npos || close == std::string::npos)
+        return v;
+    std::string body = text.substr(open + 1, close - open - 1);
+    for (char &c : body)
+        if (c == ',')
+            c = ' ';
+    std::istringstream in(body);
+    double d;
+    while (in >> d)
+        v.push_back(d);
+    return v;
+}
+
+static bool readPoints(const std::string &text, std::vector<Point> &pts)
+{
+    if (text.find("xPlots") != std::string::npos) {
+        std::vector<double> xs = table(text, "xPlots"), ys = table(text, "yPlots");
+        if (xs.size() != ys.size())
+            return false;
+        for (std::size_t i = 0; i < xs.size(); i++)
+            pts.push_back(Point{xs[i], ys[i]});
+        return true;
+    }
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream l(line);
+        Point p;
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (!(l >> p.x >> p.y))
+            return false;
+        pts.push_back(p);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int shift = -1;
+    double tol = 0.001;
+    int i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!std::strcmp(argv[i], "-r"))
+            shift = std::atoi(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "-t"))
+            tol = std::atof(argv[i + 1]);
+        else
+            break;
+    }
+    if (i != argc - 1 || shift > pathformat::kMaxShift) {
+        std::fprintf(stderr, "usage: pathenc [-r bits] [-t tol] name < plot > header\n");
+        return 2;
+    }
+    std::string name = argv[i];
+
+    std::string text((std::istreambuf_iterator<char>(std::cin)),
+                     std::istreambuf_iterator<char>());
+    std::vector<Point> pts;
+    if (!readPoints(text, pts) || pts.empty() || pts.size() > pathformat::kMaxPoints) {
+        std::fprintf(stderr, "pathenc: no usable points in the input\n");
+        return 1;
+    }
+
+    if (shift < 0)
+        shift = pathformat::chooseShift(pts, tol);
+    std::vector<uint8_t> bytes = pathformat::encode(pts, shift);
+    std::vector<uint16_t> words = pathformat::pack(bytes, pts.size(), shift);
+    pathformat::writeHeader(stdout, name, "tools/pathenc", words);
+
+    std::size_t raw = pathformat::tableWords(pts.size());
+    std::fprintf(stderr, "%u points at %g degree resolution, max error %.5f degrees\n",
+                 static_cast<unsigned>(pts.size()), std::ldexp(1.0, -shift),
+                 pathformat::quantError(pts, shift));
+    std::fprintf(stderr, "%u words as tables, %u words encoded, %.1fx smaller\n",
+                 static_cast<unsigned>(raw), static_cast<unsigned>(words.size()),
+                 static_cast<double>(raw) / words.size());
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  pathformat.h
+ *
+ *  Host side writer for the compact plot path format, see ../path.h for the
+ *  layout. Shared by the host tools that emit firmware path headers.
+ */
+
+#ifndef PATHFORMAT_H
+#define PATHFORMAT_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace pathformat {
+
+struct Point {
+    double x;
+    double y;
+};
+
+// same limits as the firmware decoder
+const int kHeaderWords = 2;
+const int kMaxShift = 16;
+const std::size_t kMaxPoints = 0xFFFF;
+
+inline void putVarint(std::vector<uint8_t> &out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline uint32_t zigzag(int32_t v)
+{
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+// largest rounding error of the points at a resolution of 2^-shift degrees
+inline double quantError(const std::vector<Point> &pts, int shift)
+{
+    double scale = std::ldexp(1.0, shift), worst = 0;
+    for (const Point &p : pts) {
+        worst = std::max(worst, std::fabs(std::round(p.x * scale) / scale - p.x));
+        worst = std::max(worst, std::fabs(std::round(p.y * scale) / scale - p.y));
+    }
+    return worst;
+}
+
+// coarsest resolution that keeps every point within tol degrees
+inline int chooseShift(const std::vector<Point> &pts, double tol)
+{
+    int shift = 0;
+    while (shift < kMaxShift && quantError(pts, shift) > tol)
+        shift++;
+    return shift;
+}
+
+// record stream for the points at a resolution of 2^-shift degrees
+inline std::vector<uint8_t> encode(const std::vector<Point> &pts, int shift)
+{
+    std::vector<uint8_t> out;
+    double scale = std::ldexp(1.0, shift);
+    int32_t x = 0, y = 0, dx = 0, dy = 0;
+    uint32_t run = 0;
+    bool haveDelta = false;
+
+    auto flush = [&]() {
+        if (run)
+            putVarint(out, ((run - 1) << 1) | 1);
+        run = 0;
+    };
+
+    for (const Point &p : pts) {
+        int32_t qx = static_cast<int32_t>(std::lround(p.x * scale));
+        int32_t qy = static_cast<int32_t>(std::lround(p.y * scale));
+        int32_t ndx = qx - x, ndy = qy - y;
+
+        if (haveDelta && ndx == dx && ndy == dy && run < 0x7FFF) {
+            run++;
+        } else {
+            flush();
+            putVarint(out, zigzag(ndx) << 1);
+            putVarint(out, zigzag(ndy));
+            dx = ndx;
+            dy = ndy;
+            haveDelta = true;
+        }
+        x = qx;
+        y = qy;
+    }
+    flush();
+    return out;
+}
+
+// header and bytes packed two to a word, low byte first
+inline std::vector<uint16_t> pack(const std::vector<uint8_t> &bytes,
+                                  std::size_t points, int shift)
+{
+    std::vector<uint16_t> words;
+    words.push_back(static_cast<uint16_t>(points));
+    words.push_back(static_cast<uint16_t>(shift));
+    for (std::size_t i = 0; i < bytes.size(); i += 2) {
+        uint16_t w = bytes[i];
+        if (i + 1 < bytes.size())
+            w |= static_cast<uint16_t>(bytes[i + 1]) << 8;
+        words.push_back(w);
+    }
+    return words;
+}
+
+// words the same points take as a pair of int32_t tables on the C28x
+inline std::size_t tableWords(std::size_t points)
+{
+    return points * 2 * 2;
+}
+
+inline void writeHeader(std::FILE *f, const std::string &name,
+                        const std::string &source,
+                        const std::vector<uint16_t> &words)
+{
+    std::fprintf(f, "// this is generated by %s\n", source.c_str());
+    std::fprintf(f, "// compact plot path in degrees, see path.h for the format\n");
+    std::string upper = name;
+    for (char &c : upper)
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    std::fprintf(f, "#define %s_POINTS %u\n", upper.c_str(), words[0]);
+    std::fprintf(f, "const uint16_t %sPath[%u] = {", name.c_str(),
+                 static_cast<unsigned>(words.size()));
+    for (std::size_t i = 0; i < words.size(); i++) {
+        std::fprintf(f, "%s0x%04X", i % 10 ? ", " : (i ? ",\n    " : "\n    "),
+                     words[i]);
+    }
+    std::fprintf(f, " };\n");
+}
+
+} // namespace pathformat
+
+#endif
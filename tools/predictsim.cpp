@@ -0,0 +1,157 @@
+/*
+ *  predictsim.cpp
+ *
+ *  Host simulation of the delay compensated prediction of predict.h
+ *  against the plain PD law.
+ *
+ *  One axis of axissim.h runs three ways: the PD law on the measured
+ *  state at the tuned gains of control.h, the same at the raised gains
+ *  of predict.h, and the PD law at the raised gains on the state and
+ *  references predicted by Pred_step and Pred_reference over a horizon
+ *  of one control tick, which is what task.c measures at boot. Each
+ *  follows a 10 degree 1.3 Hz sine with feedforward and makes a 5 degree
+ *  step, on the nominal plant and two off the feedforward model. For the
+ *  sine it prints the rms tracking error, and how far the state the law
+ *  acts on is from the plant when the output reaches the DAC; for the
+ *  step the time it last left two encoder counts of the target and the
+ *  overshoot.
+ *
+ *      gcc -O2 -c ../predict.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o predictsim predictsim.cpp predict.o control.o qmath.o
+ *      ./predictsim [x|y [kp kd]]
+ *
+ *  x runs the x axis gains, y the y ones, and kp and kd in DAC counts per
+ *  degree and per deg/s replace the raised gains.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../predict.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+// back EMF and inertia of each plant against the feedforward model
+static const double kPlants[][2] = { { 1, 1 }, { 0.9, 0.8 }, { 1.2, 1.4 } };
+
+static const double kAmp = 10, kFreq = 1.3, kStep = 5;     // degrees, Hz
+static const double kBand = 2 * kEncoder;
+
+enum Law { Plain, Raised, Predicted };
+
+struct Result {
+    double rms, posAt, velAt;   // sine
+    double settle, over;        // step
+};
+
+struct Gains {
+    double kp, kd, pkp, pkd;
+};
+
+static void run(Law law, bool sine, const Gains &gains, const double *plant, Result *r)
+{
+    Motor m;
+    Io io;
+    CtrlGains g;
+    Predictor p;
+    double seconds = sine ? 20 : 1.5, w = 2 * kPi * kFreq, e = 0, ep = 0, ev = 0;
+    double posAt = 0, velAt = 0;
+    long n = 0, nAt = 0;
+    bool pending = false;
+
+    m.kv *= plant[0];
+    m.ka *= plant[1];
+    if (law == Plain)
+        Ctrl_setGainsShift(&g, CTRL_Q16(gains.kp), CTRL_Q16(gains.kd));
+    else
+        Ctrl_setGainsShift(&g, CTRL_Q16(gains.pkp), CTRL_Q16(gains.pkd));
+    Ctrl_setFeedforward(&g, X_KV_DAC, X_KA_DAC);
+    Pred_init(&p, X_KV_DAC, X_KA_DAC);
+    if (law == Predicted)
+        Pred_setDelay(&p, CONTROL_PERIOD_US);
+
+    for (long k = 0; k < seconds / kTick; k++) {
+        double t = k * kTick;
+        double ref = sine ? kAmp * std::sin(w * t) : kStep;
+        double vr = sine ? kAmp * w * std::cos(w * t) : 0;
+        double ar = sine ? -kAmp * w * w * std::sin(w * t) : 0;
+        int32_t pos, vel, posRef = q16(ref), velRef = q16(vr);
+        int32_t accRef = static_cast<int32_t>(std::floor(ar * 256));
+
+        io.latch();
+        // the output of the last tick is on the DAC now
+        if (pending && io.turn && t > 2) {
+            ep += (posAt - m.pos) * (posAt - m.pos);
+            ev += (velAt - m.vel) * (velAt - m.vel);
+            nAt++;
+        }
+        Pred_step(&p, io.encoder(m.pos), io.tacho(m.vel), io.dac, &pos, &vel);
+        if (law == Predicted)
+            Pred_reference(&p, &posRef, &velRef, accRef);
+        io.out = Ctrl_outputShift(&g, posRef - pos, vel, velRef, accRef);
+        posAt = pos / 65536.0;
+        velAt = vel / 65536.0;
+        pending = !io.turn;
+
+        for (int i = 0; i < kSubsteps; i++) {
+            double ts = t + (i + 1) * kTick / kSubsteps;
+
+            m.step(io.dac, kTick / kSubsteps);
+            if (sine && ts > 2) {
+                double d = kAmp * std::sin(w * ts) - m.pos;
+                e += d * d;
+                n++;
+            }
+            if (!sine) {
+                if (std::fabs(m.pos - kStep) > kBand)
+                    r->settle = ts;
+                r->over = std::fmax(r->over, m.pos - kStep);
+            }
+        }
+    }
+    if (sine) {
+        r->rms = std::sqrt(e / n);
+        r->posAt = std::sqrt(ep / nAt);
+        r->velAt = std::sqrt(ev / nAt);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool y = argc > 1 && !std::strcmp(argv[1], "y");
+    Gains gains = { X_KP_COUNTS, X_KD_COUNTS, X_PRED_KP_COUNTS, X_PRED_KD_COUNTS };
+    static const char *const names[] = { "tuned", "raised", "predicted" };
+
+    if (argc == 3 || argc > 4 || (argc > 1 && !y && std::strcmp(argv[1], "x"))) {
+        std::fprintf(stderr, "usage: predictsim [x|y [kp kd]]\n");
+        return 2;
+    }
+    if (y)
+        gains = Gains{ Y_KP_COUNTS, Y_KD_COUNTS, Y_PRED_KP_COUNTS, Y_PRED_KD_COUNTS };
+    if (argc == 4) {
+        gains.pkp = std::atof(argv[2]);
+        gains.pkd = std::atof(argv[3]);
+    }
+
+    std::printf("%s axis, tuned kp %.2f kd %.4f, raised kp %.2f kd %.4f, horizon %d us\n",
+                y ? "y" : "x", gains.kp, gains.kd, gains.pkp, gains.pkd, CONTROL_PERIOD_US);
+    for (const double *plant : kPlants) {
+        std::printf("plant kv x%.1f ka x%.1f\n", plant[0], plant[1]);
+        std::printf("  law         sine rms   pos at write  vel at write   step settle  over\n");
+        for (int law = Plain; law <= Predicted; law++) {
+            Result r = { 0, 0, 0, 0, 0 };
+
+            run(static_cast<Law>(law), true, gains, plant, &r);
+            run(static_cast<Law>(law), false, gains, plant, &r);
+            std::printf("  %-10s %9.3f %13.3f %13.2f %10.0f ms %5.2f\n", names[law], r.rms,
+                        r.posAt, r.velAt, r.settle * 1000, r.over);
+        }
+    }
+    return 0;
+}
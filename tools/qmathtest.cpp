@@ -0,0 +1,177 @@
+/*
+ *  qmathtest.cpp
+ *
+ *  Host check of the fixed point kernels of qmath.h against double
+ *  precision.
+ *
+ *  Every kernel is swept over its input range, the angles finely over a
+ *  little more than a turn either way, the ratios and vectors at random
+ *  over all magnitudes, the reciprocal and square root geometrically over
+ *  every positive Q16 value. For each it prints the worst error in units
+ *  of the last place of the result, the operations it is built from and
+ *  its host time per call, and the run fails if any error is over the
+ *  bound documented in qmath.h. The integer square roots must be exact.
+ *
+ *  Host times only rank the kernels against each other. A
+ *  __P2AMC_MODE_BENCH build times them in cycles on the target.
+ *
+ *      gcc -O2 -c ../qmath.c
+ *      g++ -std=c++11 -O2 -o qmathtest qmathtest.cpp qmath.o
+ *      ./qmathtest [-n samples]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+extern "C" {
+#include "../qmath.h"
+}
+
+static const double kPi = 3.14159265358979323846;
+static const double kQ16 = 65536.0;
+static const double kQ30 = 1073741824.0;
+static const int64_t kSweep = 400L << 16;   // angles swept, Q16 degrees
+
+struct Kernel {
+    const char *name;
+    const char *ops;    // as documented in qmath.h
+    double bound;       // ULP, 0 for exact
+    double worst;
+    double at;
+    double ns;
+};
+
+static void note(Kernel &k, double err, double at)
+{
+    if (err > k.worst) {
+        k.worst = err;
+        k.at = at;
+    }
+}
+
+// ns per call of f over n spread out inputs
+template <typename F>
+static double timeIt(long n, F f)
+{
+    volatile int32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < n; i++)
+        sink = sink + f(static_cast<int32_t>(i * 2654435761u));
+    std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+    return t.count() / n;
+}
+
+static double rad(int32_t angle)
+{
+    return angle / kQ16 * kPi / 180;
+}
+
+int main(int argc, char **argv)
+{
+    long samples = 2000000;
+
+    if (argc == 3 && !std::strcmp(argv[1], "-n")) {
+        samples = std::atol(argv[2]);
+    } else if (argc != 1) {
+        std::fprintf(stderr, "usage: qmathtest [-n samples]\n");
+        return 2;
+    }
+
+    Kernel sincos = { "qsincos", "24 x 3 shifts/adds", 140, 0, 0, 0 };
+    Kernel sinLut = { "qsin_lut", "1 mul 1 div", 5100, 0, 0, 0 };
+    Kernel atan2 = { "qatan2", "24 x 3 shifts/adds", 1, 0, 0, 0 };
+    Kernel atanLut = { "qatan_lut", "1 mul 1 div", 7, 0, 0, 0 };
+    Kernel recip = { "qrecip", "3 x 2 mul", 1, 0, 0, 0 };
+    Kernel sqrt = { "qsqrt", "3 x 3 mul + 1 fix", 0, 0, 0, 0 };
+    Kernel isqrt = { "isqrt32/64", "1 bit a step", 0, 0, 0, 0 };
+    Kernel *all[] = { &sincos, &sinLut, &atan2, &atanLut, &recip, &sqrt, &isqrt };
+
+    // angles, Q30 results
+    int64_t step = 2 * kSweep / samples + 1;
+    for (int64_t a = -kSweep; a <= kSweep; a += step) {
+        int32_t s, c, angle = static_cast<int32_t>(a);
+        double es = std::sin(rad(angle)) * kQ30, ec = std::cos(rad(angle)) * kQ30;
+
+        qsincos(angle, &s, &c);
+        note(sincos, std::fmax(std::fabs(s - es), std::fabs(c - ec)), angle / kQ16);
+        note(sinLut, std::fmax(std::fabs(qsin_lut(angle) - es), std::fabs(qcos_lut(angle) - ec)),
+             angle / kQ16);
+    }
+
+    // vectors and ratios at random over all magnitudes, Q16 results
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int32_t> any(-0x7FFFFFFF, 0x7FFFFFFF);
+    std::uniform_int_distribution<int> bits(0, 30);
+    for (long i = 0; i < samples; i++) {
+        int32_t y = any(rng) >> bits(rng), x = any(rng) >> bits(rng);
+        double e = std::atan2(static_cast<double>(y), static_cast<double>(x)) * 180 / kPi * kQ16;
+        double d = std::fabs(qatan2(y, x) - e);
+
+        if (x || y)
+            note(atan2, std::fmin(d, 360 * kQ16 - d), std::atan2(y, x) * 180 / kPi);
+        if (x == 0)
+            continue;
+        x = x < 0 ? -x : x;
+        e = std::atan(static_cast<double>(y) / x) * 180 / kPi * kQ16;
+        note(atanLut, std::fabs(qatan_lut(y, x) - e), e / kQ16);
+    }
+
+    // every magnitude of Q16, both signs for the reciprocal
+    for (int64_t x = 1; x <= 0x7FFFFFFF; x += x / (samples / 64 + 1) + 1) {
+        double e = std::fmin(kQ16 * kQ16 / x, 2147483647.0);
+        int32_t xi = static_cast<int32_t>(x);
+        int64_t r = qsqrt(xi), scaled = x << 16;
+
+        note(recip, std::fmax(std::fabs(qrecip(xi) - e), std::fabs(qrecip(-xi) + e)), x / kQ16);
+        if (r * r > scaled || (r + 1) * (r + 1) <= scaled)
+            note(sqrt, std::fabs(r - std::floor(std::sqrt(static_cast<double>(scaled)))) + 0.5,
+                 x / kQ16);
+    }
+
+    // integer roots, both sides of every power of 2 and at random
+    std::uniform_int_distribution<uint64_t> wide;
+    for (long i = 0; i < samples; i++) {
+        uint64_t x = i < 128 ? (1ULL << (i / 2)) - (i & 1) : wide(rng) >> (i % 64);
+        unsigned __int128 r = isqrt64(x);
+        uint32_t x32 = static_cast<uint32_t>(x), r32 = isqrt32(x32);
+
+        if (r * r > x || (r + 1) * (r + 1) <= x)
+            note(isqrt, 1, static_cast<double>(x));
+        if (static_cast<uint64_t>(r32) * r32 > x32
+                || (static_cast<uint64_t>(r32) + 1) * (r32 + 1) <= x32)
+            note(isqrt, 1, x32);
+    }
+
+    long n = samples;
+    sincos.ns = timeIt(n, [](int32_t a) {
+        int32_t s, c;
+        qsincos(a >> 4, &s, &c);
+        return s + c;
+    });
+    sinLut.ns = timeIt(n, [](int32_t a) { return qsin_lut(a >> 4); });
+    atan2.ns = timeIt(n, [](int32_t a) { return qatan2(a, a * 7 + 1); });
+    atanLut.ns = timeIt(n, [](int32_t a) { return qatan_lut(a, (a & 0x7FFFFFFF) | 1); });
+    recip.ns = timeIt(n, [](int32_t a) { return qrecip(a); });
+    sqrt.ns = timeIt(n, [](int32_t a) { return qsqrt(a & 0x7FFFFFFF); });
+    isqrt.ns = timeIt(n, [](int32_t a) {
+        return static_cast<int32_t>(isqrt64(static_cast<uint64_t>(a) * 0x9E3779B9u));
+    });
+
+    int failed = 0;
+    std::printf("%-11s %-20s %10s %10s %14s %8s\n", "kernel", "operations", "worst ULP",
+                "bound", "at", "ns/call");
+    for (Kernel *k : all) {
+        bool over = k->worst > (k->bound ? k->bound : 0);
+        std::printf("%-11s %-20s %10.2f %10s %14.6g %8.1f%s\n", k->name, k->ops, k->worst,
+                    k->bound ? std::to_string(static_cast<long>(k->bound)).c_str() : "exact",
+                    k->at, k->ns, over ? "  OVER" : "");
+        failed |= over;
+    }
+    return failed;
+}
@@ -0,0 +1,99 @@
+/*
+ *  schedsim.cpp
+ *
+ *  Host simulation of steps under the gain scheduling of sched.h against
+ *  the fixed PD gains.
+ *
+ *  The x axis of axissim.h is stepped from rest by a list of sizes with
+ *  no feedforward, once on the tuned gains and once on the built in table
+ *  of Sched_init scaling them each tick as task.c does. For each it
+ *  prints when the axis last left two encoder counts of the target in the
+ *  first 2 s, or - if it stops outside them, the overshoot and the error
+ *  left at the end.
+ *
+ *      gcc -O2 -c ../sched.c ../control.c ../qmath.c
+ *      g++ -std=c++11 -O2 -o schedsim schedsim.cpp sched.o control.o qmath.o
+ *      ./schedsim [coulomb]
+ *
+ *  coulomb is the plant's Coulomb friction in DAC counts, none by default.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "axissim.h"
+
+extern "C" {
+#include "../sched.h"
+#include "../trajectory.h"
+}
+
+using namespace axissim;
+
+static const double kSteps[] = { 0.7, 2, 5, 20, 60 };   // degrees
+static const double kRun = 2;                           // seconds
+static const double kBand = 2 * kEncoder;
+
+struct Step {
+    double settle, over, left;
+};
+
+static Step run(bool scheduled, double size, double coulomb)
+{
+    static Sched s;
+    Motor m;
+    Io io;
+    CtrlGains g;
+    SchedAxis a;
+    Step r = { 0, 0, 0 };
+
+    m.coulomb = coulomb;
+    Ctrl_setGainsShift(&g, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+    Ctrl_setFeedforward(&g, 0, 0);
+    Sched_init(&s);
+    Sched_axis(&a, CTRL_Q16(X_KP_COUNTS), CTRL_Q16(X_KD_COUNTS));
+
+    for (long k = 0; k < kRun / kTick; k++) {
+        int32_t vel, err;
+
+        io.latch();
+        vel = io.tacho(m.vel);
+        err = q16(size) - io.encoder(m.pos);
+        if (scheduled) {
+            Sched_gains(&s, &a, err, vel);
+            Ctrl_setGainsShift(&g, a.kpNow, a.kdNow);
+        }
+        io.out = Ctrl_outputShift(&g, err, vel, 0, 0);
+        m.run(io.dac);
+
+        if (std::fabs(m.pos - size) > kBand)
+            r.settle = (k + 1) * kTick;
+        r.over = std::fmax(r.over, m.pos - size);
+    }
+    r.left = size - m.pos;
+    if (std::fabs(r.left) > kBand)
+        r.settle = -1;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    double coulomb = argc > 1 ? std::atof(argv[1]) : 0;
+
+    std::printf("steps with %.0f counts of Coulomb friction, settled within %.3f deg\n",
+                coulomb, kBand);
+    std::printf("  step   fixed settle  over   left   scheduled settle  over   left\n");
+    for (double size : kSteps) {
+        Step r[2] = { run(false, size, coulomb), run(true, size, coulomb) };
+
+        std::printf("  %4.1f", size);
+        for (const Step &s : r) {
+            if (s.settle < 0)
+                std::printf("   %12s %5.2f %6.3f", "-", s.over, s.left);
+            else
+                std::printf("   %9.0f ms %5.2f %6.3f", s.settle * 1000, s.over, s.left);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ *  trajectory.c
+ *
+ *  Jerk limited motion profiles between consecutive plot points.
+ *
+ *  Every move is a straight line parametrised by its path length s. When a
+ *  segment is built the per axis limits are projected onto the line through
+ *  the direction cosines, and the tightest one limits the path, so the axis
+ *  that has furthest to go sets the pace and the other follows it. A seven
+ *  phase S-curve (jerk up, constant accel, jerk down, cruise and the mirror
+ *  image to stop) is then fitted to the segment length: if the segment is
+ *  too short to reach the velocity limit the peak velocity is found by a
+ *  fixed number of bisection steps, so planning always completes in bounded
+ *  time and can run from the StepNextPoint Swi.
+ *
+ *  Each control tick the profile is evaluated in closed form from the start
+ *  of the current phase, so there is no integration drift, and both axis
+ *  references are produced from the same s, v and a so they arrive together.
+ */
+
+#include "trajectory.h"
+#include "qmath.h"
+
+#define BISECT_STEPS 16
+
+/*
+ * Durations of an S-curve velocity ramp from va to vb under the path
+ * acceleration and jerk limits: *tj is each of the two jerk phases and *ta
+ * the constant acceleration phase between them, Q16 seconds.
+ */
+static void rampTime(int32_t va, int32_t vb, int32_t acc, int32_t jerk,
+                     int32_t *tj, int32_t *ta)
+{
+    int64_t q;
+    int32_t dv = vb > va ? vb - va : va - vb;
+    int32_t tfull = (int32_t)(((int64_t)acc << 16) / jerk);
+
+    if (dv >= QMPY(acc, tfull, 8)) {
+        // reaches the acceleration limit
+        *tj = tfull;
+        *ta = (int32_t)(((int64_t)dv << 8) / acc) - tfull;
+    } else {
+        // triangular acceleration, tj = sqrt(dv / jerk)
+        q = ((int64_t)dv << 24) / jerk;
+        if (q > 0xFFFFFFFFL)
+            q = 0xFFFFFFFFL;
+        *tj = isqrt32((uint32_t)q);
+        *ta = 0;
+    }
+}
+
+// distance covered by a ramp from va to vb, the ramp is symmetric so this is
+// just the mean velocity times its duration
+static int32_t rampDistance(int32_t va, int32_t vb, int32_t acc, int32_t jerk)
+{
+    int32_t tj, ta;
+
+    rampTime(va, vb, acc, jerk, &tj, &ta);
+    return (int32_t)(((int64_t)(va + vb) * (2 * tj + ta)) >> 17);
+}
+
+// tightest of the two axis limits projected onto the path direction
+static int32_t pathLimit(int32_t limX, int32_t dirX, int32_t limY, int32_t dirY,
+                         int32_t lim)
+{
+    int64_t l;
+
+    if (dirX < 0)
+        dirX = -dirX;
+    if (dirY < 0)
+        dirY = -dirY;
+    if (dirX) {
+        l = ((int64_t)limX << 30) / dirX;
+        if (l < lim)
+            lim = (int32_t)l;
+    }
+    if (dirY) {
+        l = ((int64_t)limY << 30) / dirY;
+        if (l < lim)
+            lim = (int32_t)l;
+    }
+    return lim;
+}
+
+/*
+ * Velocity limit of an axis from the DAC drive it has left once the
+ * acceleration share is taken out, for a path acceleration acc along a
+ * direction cosine dir. Holding kv v + ka a within the drive at the end of
+ * the acceleration phase, the worst point, keeps the output out of
+ * saturation over the whole move.
+ */
+static int32_t driveLimit(const TrajAxis *a, int32_t dir, int32_t acc)
+{
+    int32_t left;
+    int64_t v;
+
+    if (dir < 0)
+        dir = -dir;
+    left = a->lim.drive - (int32_t)(((int64_t)QMPY(acc, dir, 30) * a->lim.ka) >> 24);
+    if (left <= 0)
+        return 0;
+    v = ((int64_t)left << 32) / a->lim.kv;
+    return v < a->lim.vel ? (int32_t)v : a->lim.vel;
+}
+
+/*
+ * State tau seconds into phase p. Evaluated in Horner form so every
+ * intermediate stays in the units of the term it feeds, cubing a Q16 time
+ * directly throws away nearly all of its precision on short jerk phases.
+ */
+static void evalPhase(const TrajPhase *p, int32_t tau,
+                      int32_t *s, int32_t *v, int32_t *a)
+{
+    int32_t jt = QMPY(p->j, tau, 16);
+
+    *a = p->a + jt;
+    *v = p->v + QMPY(p->a + (jt >> 1), tau, 8);
+    *s = p->s + QMPY(p->v + QMPY((p->a >> 1) + jt / 6, tau, 8), tau, 16);
+}
+
+static void setPhase(TrajPhase *p, int32_t t, int32_t j)
+{
+    p->t = t > 0 ? t : 0;
+    p->j = j;
+}
+
+/*
+ * Fit the seven phase profile to the segment, entering at seg->vEntry and
+ * leaving at seg->vExit.
+ */
+static void plan(Trajectory *t, const TrajSegment *seg)
+{
+    int32_t v0 = seg->vEntry, v1 = seg->vExit;
+    int32_t acc = seg->acc, jerk = seg->jerk;
+    int32_t vp, lo, hi, mid, d, tj, ta, sgn;
+    uint16_t i;
+
+    // largest peak velocity whose ramps still fit in the segment
+    lo = v0 > v1 ? v0 : v1;
+    hi = seg->vMax > lo ? seg->vMax : lo;
+    d = rampDistance(v0, hi, acc, jerk) + rampDistance(hi, v1, acc, jerk);
+    if (d <= seg->len) {
+        vp = hi;
+    } else {
+        for (i = 0; i < BISECT_STEPS; i++) {
+            mid = lo + ((hi - lo) >> 1);
+            d = rampDistance(v0, mid, acc, jerk) + rampDistance(mid, v1, acc, jerk);
+            if (d <= seg->len)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        vp = lo;
+        d = rampDistance(v0, vp, acc, jerk) + rampDistance(vp, v1, acc, jerk);
+    }
+
+    sgn = vp >= v0 ? 1 : -1;
+    rampTime(v0, vp, acc, jerk, &tj, &ta);
+    setPhase(&t->phase[0], tj, sgn * jerk);
+    setPhase(&t->phase[1], ta, 0);
+    setPhase(&t->phase[2], tj, -sgn * jerk);
+
+    setPhase(&t->phase[3], vp ? (int32_t)(((int64_t)(seg->len - d) << 16) / vp) : 0, 0);
+
+    sgn = v1 >= vp ? 1 : -1;
+    rampTime(vp, v1, acc, jerk, &tj, &ta);
+    setPhase(&t->phase[4], tj, sgn * jerk);
+    setPhase(&t->phase[5], ta, 0);
+    setPhase(&t->phase[6], tj, -sgn * jerk);
+
+    // starting state of each phase, from the end of the one before it
+    t->phase[0].s = 0;
+    t->phase[0].v = v0;
+    t->phase[0].a = 0;
+    for (i = 1; i < TRAJ_PHASES; i++)
+        evalPhase(&t->phase[i - 1], t->phase[i - 1].t,
+                  &t->phase[i].s, &t->phase[i].v, &t->phase[i].a);
+    t->vEnd = v1;
+}
+
+static void axisStart(TrajAxis *a, int32_t target, int32_t dir)
+{
+    a->start = a->pos;
+    a->end = target;
+    a->dir = dir;
+}
+
+static void axisOutput(TrajAxis *a, int32_t s, int32_t v, int32_t acc)
+{
+    a->pos = a->start + QMPY(a->dir, s, 30);
+    a->vel = QMPY(a->dir, v, 30);
+    a->acc = QMPY(a->dir, acc, 30);
+}
+
+static void axisFinish(TrajAxis *a, int32_t v)
+{
+    a->pos = a->end;
+    a->vel = QMPY(a->dir, v, 30);
+    a->acc = 0;
+}
+
+void Traj_init(Trajectory *t, int32_t x, int32_t y)
+{
+    t->x.pos = x;
+    t->x.vel = 0;
+    t->x.acc = 0;
+    t->y.pos = y;
+    t->y.vel = 0;
+    t->y.acc = 0;
+    t->tau = 0;
+    t->frac = 0;
+    t->over = 0;
+    t->busy = 0;
+    Traj_setLimits(&t->x, (int32_t)X_VMAX << 16, (int32_t)X_AMAX << 8, (int32_t)X_JMAX << 8);
+    Traj_setLimits(&t->y, (int32_t)Y_VMAX << 16, (int32_t)Y_AMAX << 8, (int32_t)Y_JMAX << 8);
+    Traj_setDrive(&t->x, X_DRIVE, X_KV_DAC, X_KA_DAC);
+    Traj_setDrive(&t->y, Y_DRIVE, Y_KV_DAC, Y_KA_DAC);
+}
+
+// velocity in Q16 deg/s, acceleration and jerk in Q8 deg/s^2 and deg/s^3
+void Traj_setLimits(TrajAxis *a, int32_t vel, int32_t acc, int32_t jerk)
+{
+    a->lim.vel = vel;
+    a->lim.acc = acc;
+    a->lim.jerk = jerk;
+}
+
+/*
+ * Limit the axis to what the DAC can drive: drive counts, split between
+ * kv counts per deg/s and ka counts per deg/s^2, both Q16. At most half
+ * the drive goes to acceleration, the axis acceleration limit is lowered
+ * to match. Call after Traj_setLimits.
+ */
+void Traj_setDrive(TrajAxis *a, int32_t drive, int32_t kv, int32_t ka)
+{
+    int64_t acc = ((int64_t)drive << 23) / ka;
+
+    a->lim.drive = drive;
+    a->lim.kv = kv;
+    a->lim.ka = ka;
+    if (acc < a->lim.acc)
+        a->lim.acc = (int32_t)acc;
+}
+
+/*
+ * Build the straight segment from (x0, y0) to (x1, y1), all in Q16, with
+ * path limits taken from the axis limits of t and the path velocity capped
+ * at feed, Q16 degrees per second. The velocity limit of each axis is
+ * whichever of its own limit and its DAC drive is tighter. The segment
+ * starts and ends at standstill until the planner says otherwise.
+ */
+void Traj_segment(const Trajectory *t, TrajSegment *seg,
+                  int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t feed)
+{
+    int32_t dx = x1 - x0, dy = y1 - y0;
+
+    seg->x = x1;
+    seg->y = y1;
+    seg->len = isqrt64((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy));
+    seg->dirX = seg->len ? (int32_t)(((int64_t)dx << 30) / seg->len) : 0;
+    seg->dirY = seg->len ? (int32_t)(((int64_t)dy << 30) / seg->len) : 0;
+    seg->acc = pathLimit(t->x.lim.acc, seg->dirX, t->y.lim.acc, seg->dirY,
+                         0x7FFFFFFFL);
+    seg->vMax = pathLimit(driveLimit(&t->x, seg->dirX, seg->acc), seg->dirX,
+                          driveLimit(&t->y, seg->dirY, seg->acc), seg->dirY, feed);
+    seg->jerk = pathLimit(t->x.lim.jerk, seg->dirX, t->y.lim.jerk, seg->dirY,
+                          0x7FFFFFFFL);
+    seg->vEntry = 0;
+    seg->vExit = 0;
+}
+
+/*
+ * Highest velocity, no more than vCap, that can be reached from v within
+ * len under the given limits. The ramp is symmetric so this is also the
+ * highest velocity from which v can still be reached.
+ */
+int32_t Traj_reachable(int32_t v, int32_t vCap, int32_t len, int32_t acc, int32_t jerk)
+{
+    int32_t lo = v, hi = vCap, mid;
+    uint16_t i;
+
+    if (vCap <= v || rampDistance(v, vCap, acc, jerk) <= len)
+        return vCap;
+    for (i = 0; i < BISECT_STEPS; i++) {
+        mid = lo + ((hi - lo) >> 1);
+        if (rampDistance(v, mid, acc, jerk) <= len)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// walk forward to the phase containing tau and produce the references there
+static void evaluate(Trajectory *t)
+{
+    int32_t s, v, a;
+
+    while (t->n < TRAJ_PHASES && t->tau >= t->phase[t->n].t) {
+        t->tau -= t->phase[t->n].t;
+        t->n++;
+    }
+
+    if (t->n == TRAJ_PHASES) {
+        // land exactly on the waypoint and carry the overrun into the next move
+        axisFinish(&t->x, t->vEnd);
+        axisFinish(&t->y, t->vEnd);
+        t->over = t->tau;
+        t->busy = 0;
+    } else {
+        evalPhase(&t->phase[t->n], t->tau, &s, &v, &a);
+        axisOutput(&t->x, s, v, a);
+        axisOutput(&t->y, s, v, a);
+    }
+}
+
+/*
+ * Start executing seg from the current reference. If the previous move
+ * finished part way through this tick the new one picks up the overrun
+ * straight away, so chained moves keep the pen moving evenly.
+ */
+void Traj_start(Trajectory *t, const TrajSegment *seg)
+{
+    t->len = seg->len;
+    axisStart(&t->x, seg->x, seg->dirX);
+    axisStart(&t->y, seg->y, seg->dirY);
+    plan(t, seg);
+
+    t->n = 0;
+    t->tau = t->over;
+    t->over = 0;
+    t->busy = 1;
+    evaluate(t);
+}
+
+/*
+ * Start a new move from the current reference to (x, y), both in Q16, from
+ * and to standstill. Any move still in progress is abandoned from wherever
+ * it currently is.
+ */
+void Traj_moveTo(Trajectory *t, int32_t x, int32_t y)
+{
+    TrajSegment seg;
+
+    Traj_segment(t, &seg, t->x.pos, t->y.pos, x, y, (int32_t)TRAJ_FEEDRATE << 16);
+    Traj_start(t, &seg);
+}
+
+// advance the reference by one control tick, returns 0 once the move is done
+uint16_t Traj_step(Trajectory *t)
+{
+    if (!t->busy) {
+        t->over = 0;
+        return 0;
+    }
+
+    t->tau += TRAJ_DT_Q16;
+    t->frac += TRAJ_DT_REM;
+    if (t->frac >= 1000000L) {
+        t->frac -= 1000000L;
+        t->tau += 1;
+    }
+    evaluate(t);
+    return t->busy;
+}
+
+/*
+ * Time seg takes once planned, Q16 seconds, without executing it. Lets a
+ * job be timed before it is started.
+ */
+int32_t Traj_duration(const TrajSegment *seg)
+{
+    Trajectory t;
+    int32_t total = 0;
+    uint16_t i;
+
+    plan(&t, seg);
+    for (i = 0; i < TRAJ_PHASES; i++)
+        total += t.phase[i].t;
+    return total;
+}
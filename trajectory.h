@@ -0,0 +1,129 @@
+/*
+ *  trajectory.h
+ *
+ *  Reference generator for the Piccollo2AMC project.
+ *
+ *  Rather than stepping xPosRef/yPosRef straight onto the next plot point,
+ *  the reference is walked from one waypoint to the next a little bit every
+ *  control tick. Each move follows a jerk limited (S-curve) velocity
+ *  profile along the straight line between the two points, so both axes
+ *  share one time law and arrive together. Moves are described by a
+ *  TrajSegment so the look ahead planner can hand over moves that start
+ *  and end at speed.
+ *
+ *  Units used throughout:
+ *      position        degrees in Q16, the same format as xPos/yPos
+ *      velocity        degrees/second in Q16
+ *      acceleration    degrees/second^2 in Q8
+ *      jerk            degrees/second^3 in Q8
+ *      time            seconds in Q16
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+
+// rate at which Traj_step is called, matches the triggerADC timer in task.cfg
+#define CONTROL_PERIOD_US 5000
+#define CONTROL_RATE_HZ (1000000L / CONTROL_PERIOD_US)
+
+// one control tick in Q16 seconds, split into a whole part and a remainder
+// over 1e6 so the profile clock does not drift from the timer
+#define TRAJ_DT_Q16 (((int32_t)CONTROL_PERIOD_US << 16) / 1000000L)
+#define TRAJ_DT_REM (((int32_t)CONTROL_PERIOD_US << 16) % 1000000L)
+
+// default drawing speed in degrees per second, caps the path velocity
+#define TRAJ_FEEDRATE 100
+
+// default per axis limits, see Traj_setLimits
+#define X_VMAX 200      // deg/s
+#define X_AMAX 4000     // deg/s^2
+#define X_JMAX 100000   // deg/s^3
+#define Y_VMAX 200
+#define Y_AMAX 4000
+#define Y_JMAX 100000
+
+// DAC drive available for motion, see Traj_setDrive. The rest of the +-2048
+// count swing is left for the feedback to correct errors with
+#define X_DRIVE 1536    // DAC counts
+#define Y_DRIVE 1536
+
+// DAC counts the motor needs per deg/s (back EMF) and per deg/s^2 (inertia)
+// in Q16. Rough SRV02 high gear figures with the amplifier swinging +-10 V
+// over the DAC range, refine them from a step test on the real axes
+#define X_KV_DAC 125829L    // 1.92
+#define X_KA_DAC 3637L      // 0.0555
+#define Y_KV_DAC 125829L
+#define Y_KA_DAC 3637L
+
+// jerk+, accel, jerk-, cruise, jerk-, decel, jerk+
+#define TRAJ_PHASES 7
+
+typedef struct {
+    int32_t vel;    // Q16
+    int32_t acc;    // Q8
+    int32_t jerk;   // Q8
+    int32_t drive;  // DAC counts available for motion
+    int32_t kv;     // DAC counts per deg/s, Q16
+    int32_t ka;     // DAC counts per deg/s^2, Q16
+} TrajLimits;
+
+typedef struct {
+    int32_t x;      // end point, Q16
+    int32_t y;
+    int32_t len;    // length, Q16
+    int32_t dirX;   // direction cosines, Q30
+    int32_t dirY;
+    int32_t vMax;   // path limits projected from the axis limits
+    int32_t acc;
+    int32_t jerk;
+    int32_t vEntry; // path velocity on entry and exit, Q16
+    int32_t vExit;
+} TrajSegment;
+
+typedef struct {
+    int32_t t;      // duration, Q16 seconds
+    int32_t j;      // jerk held over the phase, Q8
+    int32_t s;      // path position at the start of the phase, Q16
+    int32_t v;      // path velocity at the start of the phase, Q16
+    int32_t a;      // path acceleration at the start of the phase, Q8
+} TrajPhase;
+
+typedef struct {
+    int32_t pos;    // position reference, Q16
+    int32_t vel;    // velocity reference, Q16
+    int32_t acc;    // acceleration reference, Q8
+    int32_t start;  // segment start point, Q16
+    int32_t end;    // segment end point, Q16
+    int32_t dir;    // direction cosine of the segment, Q30
+    TrajLimits lim;
+} TrajAxis;
+
+typedef struct {
+    TrajAxis x;
+    TrajAxis y;
+    TrajPhase phase[TRAJ_PHASES];
+    int32_t len;        // segment length, Q16
+    int32_t tau;        // time into the current phase, Q16 seconds
+    int32_t frac;       // TRAJ_DT_REM accumulator
+    int32_t over;       // time overrun past the end of the last segment
+    int32_t vEnd;       // path velocity at the end of the segment, Q16
+    uint16_t n;         // current phase
+    uint16_t busy;
+} Trajectory;
+
+void Traj_init(Trajectory *t, int32_t x, int32_t y);
+void Traj_setLimits(TrajAxis *a, int32_t vel, int32_t acc, int32_t jerk);
+void Traj_setDrive(TrajAxis *a, int32_t drive, int32_t kv, int32_t ka);
+void Traj_segment(const Trajectory *t, TrajSegment *seg,
+                  int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t feed);
+int32_t Traj_reachable(int32_t v, int32_t vCap, int32_t len, int32_t acc, int32_t jerk);
+void Traj_start(Trajectory *t, const TrajSegment *seg);
+void Traj_moveTo(Trajectory *t, int32_t x, int32_t y);
+uint16_t Traj_step(Trajectory *t);
+int32_t Traj_duration(const TrajSegment *seg);
+
+#define Traj_busy(t) ((t)->busy != 0)
+
+#endif